@@ -40,6 +40,11 @@ namespace park {
             code.insert(code.end(), pi, pi + 8);
         }
 
+        void emit32(int32_t i) {
+            auto const *pi = reinterpret_cast<const uint8_t *>(&i);
+            code.insert(code.end(), pi, pi + 4);
+        }
+
         void emit_at(int offset, int64_t i) {
             auto const *pi = reinterpret_cast<const uint8_t *>(&i);
             std::copy(pi, pi + 8, code.begin() + offset);
@@ -117,6 +122,10 @@ namespace park {
             emit_code({0xFF, 0xD0});
         }
 
+        void jmp_rax() {
+            emit_code({0xFF, 0xE0});
+        }
+
         void jz(int label) {
             emit_code([&]() {
                 code.insert(code.end(), {0x0F, 0x84});
@@ -133,6 +142,22 @@ namespace park {
             });
         }
 
+        void jnz(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x0F, 0x85});
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+            });
+        }
+
+        void jo(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x0F, 0x80});
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+            });
+        }
+
         void jmp_rel(int label) {
             emit_code([&]() {
                 code.push_back(0xE9);
@@ -141,6 +166,37 @@ namespace park {
             });
         }
 
+        void lea_rcx_rip(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8D, 0x0D}); //lea rcx, [rip + rel32]
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0x00, 0x00, 0x00, 0x00});
+            });
+        }
+
+        void lea_rdx_rip(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8D, 0x15}); //lea rdx, [rip + rel32]
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0x00, 0x00, 0x00, 0x00});
+            });
+        }
+
+        void cmp_rax_rcx() {
+            emit_code({0x48, 0x39, 0xC8});
+        }
+
+        void cmp_rcx_rdx() {
+            emit_code({0x48, 0x39, 0xD1});
+        }
+
+        void mov_rcx_rax_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8B, 0x88}); //mov rcx, [rax + disp32]
+                emit32(disp);
+            });
+        }
+
         void mov_rdi_imm(int64_t imm) {
             emit_code([&]() {
                 code.insert(code.end(), {0x48, 0xBF});
@@ -204,10 +260,557 @@ namespace park {
             emit_code({0x50});
         }
 
+        void push_rdi() {
+            emit_code({0x57});
+        }
+
+        void push_rsi() {
+            emit_code({0x56});
+        }
+
+        void pop_rdi() {
+            emit_code({0x5F});
+        }
+
+        void pop_rsi() {
+            emit_code({0x5E});
+        }
+
         void test_rax_rax() {
             emit_code({0x48, 0x85, 0xC0});
         }
 
+        //direct value stack access, jit code keeps the stack ptr of the fiber in r14
+        //and the address of the base of the current frame in r15
+
+        void mov_rbx_disp_r14(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x89, 0xB3}); //mov [rbx + disp32], r14
+                emit32(disp);
+            });
+        }
+
+        void mov_r14_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x8B, 0xB3}); //mov r14, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r15_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x8B, 0xBB}); //mov r15, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rcx_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8B, 0x8B}); //mov rcx, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void shl_rcx_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE1, static_cast<uint8_t>(imm)});
+        }
+
+        void add_r15_rcx() {
+            emit_code({0x49, 0x01, 0xCF});
+        }
+
+        void cmp_r14_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x3B, 0xB3}); //cmp r14, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void jae(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x0F, 0x83});
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+            });
+        }
+
+        void ja(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x0F, 0x87});
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+            });
+        }
+
+        void jb(int label) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x0F, 0x82});
+                fixups.push_back({label, offset()});
+                code.insert(code.end(), {0xFF, 0xFF, 0xFF, 0xFF});
+            });
+        }
+
+        void add_r14_imm8(int8_t imm) {
+            emit_code({0x49, 0x83, 0xC6, static_cast<uint8_t>(imm)});
+        }
+
+        void sub_r14_imm8(int8_t imm) {
+            emit_code({0x49, 0x83, 0xEE, static_cast<uint8_t>(imm)});
+        }
+
+        void cmp_r14_disp_imm8(int8_t disp, int8_t imm) {
+            //cmp dword [r14 + disp8], imm8
+            emit_code({0x41, 0x83, 0x7E, static_cast<uint8_t>(disp), static_cast<uint8_t>(imm)});
+        }
+
+        void mov_r14_disp_imm32(int8_t disp, int32_t imm) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x41, 0xC7, 0x46, static_cast<uint8_t>(disp)}); //mov dword [r14 + disp8], imm32
+                emit32(imm);
+            });
+        }
+
+        void mov_rax_r14_disp(int8_t disp) {
+            emit_code({0x49, 0x8B, 0x46, static_cast<uint8_t>(disp)}); //mov rax, [r14 + disp8]
+        }
+
+        void mov_rdx_r14_disp(int8_t disp) {
+            emit_code({0x49, 0x8B, 0x56, static_cast<uint8_t>(disp)}); //mov rdx, [r14 + disp8]
+        }
+
+        void mov_rsi_r14_disp(int8_t disp) {
+            emit_code({0x49, 0x8B, 0x76, static_cast<uint8_t>(disp)}); //mov rsi, [r14 + disp8]
+        }
+
+        void movzx_eax_byte_r14_disp(int8_t disp) {
+            emit_code({0x41, 0x0F, 0xB6, 0x46, static_cast<uint8_t>(disp)}); //movzx eax, byte [r14 + disp8]
+        }
+
+        void mov_r14_disp_rax(int8_t disp) {
+            emit_code({0x49, 0x89, 0x46, static_cast<uint8_t>(disp)}); //mov [r14 + disp8], rax
+        }
+
+        void mov_r14_disp_rdx(int8_t disp) {
+            emit_code({0x49, 0x89, 0x56, static_cast<uint8_t>(disp)}); //mov [r14 + disp8], rdx
+        }
+
+        void mov_rax_r15_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0x8B, 0x87}); //mov rax, [r15 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rdx_r15_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0x8B, 0x97}); //mov rdx, [r15 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r15_disp_rax(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0x89, 0x87}); //mov [r15 + disp32], rax
+                emit32(disp);
+            });
+        }
+
+        void mov_r15_disp_rdx(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0x89, 0x97}); //mov [r15 + disp32], rdx
+                emit32(disp);
+            });
+        }
+
+        //inline cache probe, keys in r8 (callable), r9 and r10 (arguments), cache in rsi
+
+        void mov_r8_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4D, 0x8B, 0x86}); //mov r8, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r9d_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x45, 0x8B, 0x8E}); //mov r9d, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r9_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4D, 0x8B, 0x8E}); //mov r9, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r10d_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x45, 0x8B, 0x96}); //mov r10d, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r10_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4D, 0x8B, 0x96}); //mov r10, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_r9_r9_ptr() {
+            emit_code({0x4D, 0x8B, 0x09}); //mov r9, [r9]
+        }
+
+        void mov_r10_r10_ptr() {
+            emit_code({0x4D, 0x8B, 0x12}); //mov r10, [r10]
+        }
+
+        void cmp_r9d_imm8(int8_t imm) {
+            emit_code({0x41, 0x83, 0xF9, static_cast<uint8_t>(imm)});
+        }
+
+        void cmp_r10d_imm8(int8_t imm) {
+            emit_code({0x41, 0x83, 0xFA, static_cast<uint8_t>(imm)});
+        }
+
+        void xor_r9d_r9d() {
+            emit_code({0x45, 0x31, 0xC9});
+        }
+
+        void xor_r10d_r10d() {
+            emit_code({0x45, 0x31, 0xD2});
+        }
+
+        void cmp_byte_rsi_disp_0(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x80, 0xBE}); //cmp byte [rsi + disp32], 0
+                emit32(disp);
+                code.push_back(0x00);
+            });
+        }
+
+        void cmp_r8_rsi_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x3B, 0x86}); //cmp r8, [rsi + disp32]
+                emit32(disp);
+            });
+        }
+
+        void cmp_r9_rsi_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x3B, 0x8E}); //cmp r9, [rsi + disp32]
+                emit32(disp);
+            });
+        }
+
+        void cmp_r10_rsi_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x4C, 0x3B, 0x96}); //cmp r10, [rsi + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rax_rsi_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8B, 0x86}); //mov rax, [rsi + disp32]
+                emit32(disp);
+            });
+        }
+
+        void inc_rax_ptr() {
+            emit_code({0x48, 0xFF, 0x00}); //inc qword [rax]
+        }
+
+        void mov_rcx_rax_ptr() {
+            emit_code({0x48, 0x8B, 0x08}); //mov rcx, [rax]
+        }
+
+        void cmp_rcx_rax_disp(int8_t disp) {
+            emit_code({0x48, 0x3B, 0x48, static_cast<uint8_t>(disp)}); //cmp rcx, [rax + disp8]
+        }
+
+        void cmp_r8_rax() {
+            emit_code({0x49, 0x39, 0xC0});
+        }
+
+        void cmp_r9_rax() {
+            emit_code({0x49, 0x39, 0xC1});
+        }
+
+        void cmp_r10_rax() {
+            emit_code({0x49, 0x39, 0xC2});
+        }
+
+        //frame push and pop, the frame is addressed by rax and the fiber by rbx
+        void mov_rax_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x8B, 0x83}); //mov rax, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rbx_disp_rax(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x89, 0x83}); //mov [rbx + disp32], rax
+                emit32(disp);
+            });
+        }
+
+        void cmp_rax_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x3B, 0x83}); //cmp rax, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rbx_disp_rcx(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x89, 0x8B}); //mov [rbx + disp32], rcx
+                emit32(disp);
+            });
+        }
+
+        void cmp_rcx_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x3B, 0x8B}); //cmp rcx, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void add_rcx_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x03, 0x8B}); //add rcx, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void sub_rcx_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x2B, 0x8B}); //sub rcx, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void lea_rcx_r14_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0x8D, 0x8E}); //lea rcx, [r14 + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rcx_r14() {
+            emit_code({0x4C, 0x89, 0xF1});
+        }
+
+        void shr_rcx_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE9, static_cast<uint8_t>(imm)});
+        }
+
+        void sub_rcx_imm32(int32_t imm) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0x81, 0xE9}); //sub rcx, imm32
+                emit32(imm);
+            });
+        }
+
+        void xor_ecx_ecx() {
+            emit_code({0x31, 0xC9});
+        }
+
+        void mov_rax_disp_rsi(int8_t disp) {
+            emit_code({0x48, 0x89, 0x70, static_cast<uint8_t>(disp)}); //mov [rax + disp8], rsi
+        }
+
+        void mov_rax_disp_rcx(int8_t disp) {
+            emit_code({0x48, 0x89, 0x48, static_cast<uint8_t>(disp)}); //mov [rax + disp8], rcx
+        }
+
+        void mov_rax_disp_imm32(int8_t disp, int32_t imm) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0xC7, 0x40, static_cast<uint8_t>(disp)}); //mov qword [rax + disp8], imm32
+                emit32(imm);
+            });
+        }
+
+        void mov_rsi_rax_disp(int8_t disp) {
+            emit_code({0x48, 0x8B, 0x70, static_cast<uint8_t>(disp)}); //mov rsi, [rax + disp8]
+        }
+
+        void cmp_rax_disp_imm8(int8_t disp, int8_t imm) {
+            emit_code({0x48, 0x83, 0x78, static_cast<uint8_t>(disp), static_cast<uint8_t>(imm)}); //cmp qword [rax + disp8], imm8
+        }
+
+        void push_rax_disp(int8_t disp) {
+            emit_code({0xFF, 0x70, static_cast<uint8_t>(disp)}); //push qword [rax + disp8]
+        }
+
+        void add_rax_imm8(int8_t imm) {
+            emit_code({0x48, 0x83, 0xC0, static_cast<uint8_t>(imm)});
+        }
+
+        void sub_rax_imm8(int8_t imm) {
+            emit_code({0x48, 0x83, 0xE8, static_cast<uint8_t>(imm)});
+        }
+
+        void mov_rcx_disp_rdx(int8_t disp) {
+            emit_code({0x48, 0x89, 0x51, static_cast<uint8_t>(disp)}); //mov [rcx + disp8], rdx
+        }
+
+        void lea_r14_rcx_disp(int8_t disp) {
+            emit_code({0x4C, 0x8D, 0x71, static_cast<uint8_t>(disp)}); //lea r14, [rcx + disp8]
+        }
+
+        //checkpoint counter of the fiber
+        void mov_eax_rbx_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x8B, 0x83}); //mov eax, [rbx + disp32]
+                emit32(disp);
+            });
+        }
+
+        void mov_rbx_disp_eax(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x89, 0x83}); //mov [rbx + disp32], eax
+                emit32(disp);
+            });
+        }
+
+        void inc_eax() {
+            emit_code({0xFF, 0xC0});
+        }
+
+        void test_al_al() {
+            emit_code({0x84, 0xC0});
+        }
+
+        void inc_rsi_disp(int32_t disp) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x48, 0xFF, 0x86}); //inc qword [rsi + disp32]
+                emit32(disp);
+            });
+        }
+
+        void add_rax_rdx() {
+            emit_code({0x48, 0x01, 0xD0});
+        }
+
+        void sub_rax_rdx() {
+            emit_code({0x48, 0x29, 0xD0});
+        }
+
+        void cmp_rax_rdx() {
+            emit_code({0x48, 0x39, 0xD0});
+        }
+
+        void sete_al() {
+            emit_code({0x0F, 0x94, 0xC0});
+        }
+
+        void setl_al() {
+            emit_code({0x0F, 0x9C, 0xC0});
+        }
+
+        void setg_al() {
+            emit_code({0x0F, 0x9F, 0xC0});
+        }
+
+        void movzx_eax_al() {
+            emit_code({0x0F, 0xB6, 0xC0});
+        }
+
+        void test_rsi_rsi() {
+            emit_code({0x48, 0x85, 0xF6});
+        }
+
+        void cmp_rsi_minus_1() {
+            emit_code({0x48, 0x83, 0xFE, 0xFF});
+        }
+
+        void cqo() {
+            emit_code({0x48, 0x99});
+        }
+
+        void idiv_rsi() {
+            emit_code({0x48, 0xF7, 0xFE});
+        }
+
+        void mov_r11_imm(int64_t imm) {
+            emit_code([&]() {
+                code.insert(code.end(), {0x49, 0xBB});
+                emit(imm);
+            });
+        }
+
+        void mov_rcx_rax() {
+            emit_code({0x48, 0x89, 0xC1});
+        }
+
+        void mov_rsi_rdx() {
+            emit_code({0x48, 0x89, 0xD6});
+        }
+
+        void mov_r9_rax_ptr() {
+            emit_code({0x4C, 0x8B, 0x08}); //mov r9, [rax]
+        }
+
+        void mov_r10_rax_ptr() {
+            emit_code({0x4C, 0x8B, 0x10}); //mov r10, [rax]
+        }
+
+        void mov_r9_rax() {
+            emit_code({0x49, 0x89, 0xC1});
+        }
+
+        void mov_r10_rax() {
+            emit_code({0x49, 0x89, 0xC2});
+        }
+
+        void and_rcx_rdx() {
+            emit_code({0x48, 0x21, 0xD1});
+        }
+
+        void cmp_rcx_r11() {
+            emit_code({0x4C, 0x39, 0xD9});
+        }
+
+        void or_rax_r11() {
+            emit_code({0x4C, 0x09, 0xD8});
+        }
+
+        void or_rdx_r11() {
+            emit_code({0x4C, 0x09, 0xDA});
+        }
+
+        void shl_rax_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE0, static_cast<uint8_t>(imm)});
+        }
+
+        void shl_rdx_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE2, static_cast<uint8_t>(imm)});
+        }
+
+        void shl_rsi_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE6, static_cast<uint8_t>(imm)});
+        }
+
+        void shr_rax_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xE8, static_cast<uint8_t>(imm)});
+        }
+
+        void shr_rdx_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xEA, static_cast<uint8_t>(imm)});
+        }
+
+        void sar_rax_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xF8, static_cast<uint8_t>(imm)});
+        }
+
+        void sar_rsi_imm8(int8_t imm) {
+            emit_code({0x48, 0xC1, 0xFE, static_cast<uint8_t>(imm)});
+        }
+
         void ret() {
             emit_code({0xC3});
         }
@@ -238,15 +841,24 @@ namespace park {
             //also to align the stack properly
 
             //on entry rdi = fbr, rsi = apply node, rdx = start addr
+            //jitted functions keep the native stack flat, so for perf and debuggers all of them run
+            //in the frame of the thunk, which is linked by rbp
             emit_code({
+                              0x55,                         // push   rbp       ; frame pointer
+                              0x48, 0x89, 0xE5,             // mov    rbp,rsp
                               0x53,                         // push   rbx       ; callee save
+                              0x41, 0x56,                   // push   r14       ; callee save, value stack ptr
+                              0x41, 0x57,                   // push   r15       ; callee save, frame base
+                              0x48, 0x83, 0xEC, 0x08,       // sub    rsp,8     ; align
                               0x48, 0x89, 0xFB,             // mov    rbx,rdi   ; keep current fiber in rbx
                               0x48, 0x89, 0xD0,             // mov    rax,rdx   ; start addr
-                              0x48, 0x83, 0xEC, 0x10,       // sub    rsp,0x10  ; align stack
                               0xFF,
                               0xD0,                         // call   rax       ; call into code, with context as 1st arg (already in rdi) and apply & as 2nd arg (already in rsi)
-                              0x48, 0x83, 0xC4, 0x10,       // add    rsp,0x10  ; align stack
+                              0x48, 0x83, 0xC4, 0x08,       // add    rsp,8
+                              0x41, 0x5F,                   // pop    r15       ; restore r15 for caller
+                              0x41, 0x5E,                   // pop    r14       ; restore r14 for caller
                               0x5B,                         // pop    rbx       ; restore rbx for caller
+                              0x5D,                         // pop    rbp
                               0xC3,                         // ret              ; return
                       });
         }
@@ -255,11 +867,15 @@ namespace park {
             //reason for thunk is to put current fiber in rbx
             //also to align the stack properly
             emit_code({
+                              0x55,                         //push   rbp       ; frame pointer, must match entry_thunk
+                              0x48, 0x89, 0xE5,             //mov    rbp,rsp
                               0x53,                         //push   rbx       ; callee save
+                              0x41, 0x56,                   //push   r14       ; callee save, must match entry_thunk
+                              0x41, 0x57,                   //push   r15       ; callee save, must match entry_thunk
+                              0x48, 0x83, 0xEC, 0x08,       //sub    rsp,8     ; must match entry_thunk
                               0x48, 0x89, 0xFB,             //mov    rbx,rdi   ; keep current fiber in rbx
                               0x48, 0x89, 0xD0,             //mov    rax,rdx   ; ret code to be inspected by apply
                               0x48, 0x89, 0xF2,             //mov    rdx,rsi   ; start addr
-                              0x48, 0x83, 0xEC, 0x10,       //sub    rsp,0x10  ; align stack
                               0xFF, 0xE2                    //jmp rdx
                       });
         }
@@ -33,6 +33,7 @@
 #include "fiber.h"
 #include "namespace.h"
 #include "keyword.h"
+#include "compiler.h"
 
 #include <boost/endian/conversion.hpp>
 
@@ -50,7 +51,7 @@ namespace park {
 
         Function::Function(size_t line, std::string name, gc::ref<Module> module, gc::ref<NodeList> freevars, gc::ref<NodeList> locals, 
                     gc::ref<NodeList> parameters, gc::ref<Node> expression)
-                : name_(name), module_(module), code_(nullptr), freevars_(freevars), locals_(locals),
+                : name_(name), module_(module), code_(nullptr), direct_code_(nullptr), calls_(0), tier_up_at_(Compiler::TIER_UP_CALLS), freevars_(freevars), locals_(locals),
                     parameters_(parameters), expression_(expression) {
             assert(gc::is_shared_ref(module));    
             assert(gc::is_shared_ref(freevars));    
@@ -83,6 +84,20 @@ namespace park {
 
         }
 
+        Function::~Function()
+        {
+            if (compiler_ != nullptr) {
+                compiler_->release(*this);
+            }
+        }
+
+        Apply::~Apply()
+        {
+            if (compiler_ != nullptr) {
+                compiler_->release(*this);
+            }
+        }
+
         const Node &Function::exec_defers() const
         {
             return *APPLY_DEFERS;
@@ -98,6 +113,61 @@ namespace park {
             return gc::make_shared_ref_fam<NodeList, gc::ref<Node>>(allocator, size, size);
         }
 
+        InlineCache::InlineCache(MethodImpl miss)
+            : size_(0), megamorphic_(false), hits_(0), misses_(0) {
+            for (auto &entry : entries_) {
+                entry.callable.store(0, std::memory_order_relaxed);
+                entry.lhs.store(0, std::memory_order_relaxed);
+                entry.rhs.store(0, std::memory_order_relaxed);
+                entry.target.store(miss, std::memory_order_relaxed);
+            }
+        }
+
+        bool InlineCache::update(uintptr_t callable, uintptr_t lhs, uintptr_t rhs, MethodImpl target) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            while (!megamorphic_.load(std::memory_order_relaxed)) {
+                auto n = size_.load();
+                for (size_t i = 0; i < n; i++) {
+                    auto &entry = entries_[i];
+                    if (entry.callable.load(std::memory_order_relaxed) == callable &&
+                        entry.lhs.load(std::memory_order_relaxed) == lhs &&
+                        entry.rhs.load(std::memory_order_relaxed) == rhs) {
+                        //same key but target did not accept its arguments (e.g. closure for other function)
+                        entry.target.store(target, std::memory_order_release);
+                        return true;
+                    }
+                }
+                if (n == SIZE) {
+                    megamorphic_.store(true);
+                }
+                else if (size_.compare_exchange_strong(n, n + 1)) {
+                    //target goes in before the key, so that a prober never finds the key with an empty target
+                    auto &entry = entries_[n];
+                    entry.target.store(target, std::memory_order_release);
+                    entry.lhs.store(lhs, std::memory_order_release);
+                    entry.rhs.store(rhs, std::memory_order_release);
+                    entry.callable.store(callable, std::memory_order_release);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void InlineCache::retarget(MethodImpl from, MethodImpl to) {
+            for (auto &entry : entries_) {
+                entry.target.compare_exchange_strong(from, to);
+            }
+        }
+
+        void Apply::record_callee(gc::allocator_t &allocator, const Function &function) {
+            if (!callee_) {
+                gc::ref_write(allocator, callee_, gc::ref<Function>(&function));
+            }
+            else if (callee_.get() != &function) {
+                callee_varies_.store(true, std::memory_order_relaxed);
+            }
+        }
+
         gc::ref<Apply> Apply::create_boot_0(gc::allocator_t &allocator)
         {
             return gc::make_shared_ref<Apply>(allocator,
@@ -119,9 +189,8 @@ namespace park {
         gc::ref<Literal> Literal::create(gc::allocator_t &allocator, const value_t value)
         {
 #ifndef NDEBUG
-            if(value.kind == value_t::kind_t::RVALUE) {
-                assert(value.rvalue);
-                assert(gc::is_shared_ref(value.rvalue));
+            if(value.is_ref()) {
+                assert(gc::is_shared_ref(value.ref()));
             }
 #endif
             return gc::make_shared_ref<Literal>(allocator, value);
@@ -162,7 +231,7 @@ namespace park {
 
             enum class node_type_t {
                 NT_MODULE, NT_CONST, NT_DEFINE, NT_LET, NT_FUNCTION, NT_STRUCT, NT_STRUCT_FIELD, NT_IMPORT, NT_IF_ELSE_STATEMENT, NT_LOCAL, NT_RETURN, NT_RECUR,
-                NT_CALL, NT_BUILTIN, NT_SYMBOL, NT_GLOBAL, NT_VECTOR, NT_DICT, NT_INTEGER, NT_KEYWORD, NT_STRING, NT_BOOLEAN
+                NT_CALL, NT_BUILTIN, NT_SYMBOL, NT_GLOBAL, NT_VECTOR, NT_DICT, NT_INTEGER, NT_FLOAT, NT_KEYWORD, NT_STRING, NT_BOOLEAN
             };
 
             enum class node_key_t {
@@ -494,6 +563,15 @@ namespace park {
                 return Literal::create(fbr.allocator(), value::to_value_t<int64_t>(std::stoi(*keys.value)));
             }
 
+            gc::ref<Node> read_float(Fiber &fbr, std::istream &ins, size_t map_len) {
+                keys_t keys;
+                read_keys(fbr, ins, map_len, keys);
+
+                assert(keys.value);
+
+                return Literal::create(fbr.allocator(), value::to_value_t<double>(std::stod(*keys.value)));
+            }
+
             gc::ref<Node> read_keyword(Fiber &fbr, std::istream &ins, size_t map_len) {
                 keys_t keys;
                 read_keys(fbr, ins, map_len, keys);
@@ -656,6 +734,8 @@ namespace park {
                         return read_dict(fbr, ins, map_len);
                     case node_type_t::NT_INTEGER:
                         return read_integer(fbr, ins, map_len);
+                    case node_type_t::NT_FLOAT:
+                        return read_float(fbr, ins, map_len);
                     case node_type_t::NT_KEYWORD:
                         return read_keyword(fbr, ins, map_len);
                     case node_type_t::NT_STRING:
@@ -688,6 +768,7 @@ namespace park {
                  {"vector",            node_type_t::NT_VECTOR},
                  {"dict",              node_type_t::NT_DICT},
                  {"integer",           node_type_t::NT_INTEGER},
+                 {"float",             node_type_t::NT_FLOAT},
                  {"keyword",           node_type_t::NT_KEYWORD},
                  {"string",            node_type_t::NT_STRING},
                  {"boolean",           node_type_t::NT_BOOLEAN}
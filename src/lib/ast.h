@@ -25,6 +25,7 @@
 #include <atomic>
 #include <iostream>
 #include <optional>
+#include <cstring>
 
 #include "value.h"
 
@@ -42,6 +43,8 @@ namespace park {
 
     class Runtime;
 
+    class Compiler;
+
     namespace AST {
 
         struct Node;
@@ -250,8 +253,8 @@ namespace park {
 
             Literal(const value_t value) : value_(value) {
 #ifndef NDEBUG
-                if(value_.kind == value_t::kind_t::RVALUE) {
-                    assert(gc::is_shared_ref(value_.rvalue));
+                if(value_.is_ref()) {
+                    assert(gc::is_shared_ref(value_.ref()));
                 }                
 #endif
             }
@@ -264,9 +267,8 @@ namespace park {
             create(gc::allocator_t &allocator, const value_t value);
 
             void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {  
-                if(value_.kind == value_t::kind_t::RVALUE) {
-                    assert(value_.rvalue);
-                    accept(value_.rvalue);
+                if(value_.is_ref()) {
+                    accept(value_.ref());
                 }
             }
         };
@@ -317,10 +319,10 @@ namespace park {
             const value_t value_;
             
             Builtin(const value_t value) : value_(value) {
-                assert(value_.kind != value_t::kind_t::UVALUE);
+                assert(!value_.is_undefined());
 #ifndef NDEBUG
-                if(value_.kind == value_t::kind_t::RVALUE) {
-                    assert(gc::is_shared_ref(value_.rvalue));
+                if(value_.is_ref()) {
+                    assert(gc::is_shared_ref(value_.ref()));
                 }
 #endif
             }
@@ -330,9 +332,8 @@ namespace park {
             }
 
             void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {  
-                if(value_.kind == value_t::kind_t::RVALUE) {
-                    assert(value_.rvalue);
-                    accept(value_.rvalue);
+                if(value_.is_ref()) {
+                    accept(value_.ref());
                 }
             }
 
@@ -416,6 +417,12 @@ namespace park {
             gc::ref<Module> module_;
 
             std::atomic<MethodImpl> code_;
+            std::atomic<void *> direct_code_; //entry of code_ for callers that checked the callable is a closure of this function
+            Compiler *compiler_ = nullptr; //set together with code_, so the code can be freed with the function
+
+            //counted by baseline code, which asks for optimized code when calls_ reaches tier_up_at_
+            std::atomic<int64_t> calls_;
+            std::atomic<int64_t> tier_up_at_;
 
             gc::ref<NodeList> freevars_;
             gc::ref<NodeList> locals_;
@@ -430,6 +437,8 @@ namespace park {
                      gc::ref<NodeList> freevars, gc::ref<NodeList> locals, 
                      gc::ref<NodeList> parameters, gc::ref<Node> expression);
 
+            ~Function() override;
+
             void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
                 accept(module_);
                 accept(freevars_);
@@ -549,17 +558,69 @@ namespace park {
         };
 
 
-        struct Apply : public Node {
+        //polymorphic inline cache of an apply site, probed by jitted code before it calls a target.
+        //entries are keyed on the identity of the callable and the class of the first 2 arguments
+        //(the vtable of a boxed value, or the kind of an unboxed one). Targets still check their
+        //arguments themselves, so an entry that is stale or being updated costs a redispatch at worst
+        struct InlineCache {
+            static const size_t SIZE = 4;
+
+            struct entry_t {
+                std::atomic<uintptr_t> callable;
+                std::atomic<uintptr_t> lhs;
+                std::atomic<uintptr_t> rhs;
+                std::atomic<MethodImpl> target;
+            };
+
+            entry_t entries_[SIZE];
+            std::atomic<size_t> size_;
+            std::atomic<bool> megamorphic_; //too many entries, site uses Apply::target_ from now on
+            std::atomic<int64_t> hits_; //incremented by jitted code
+            std::atomic<int64_t> misses_;
+
+            explicit InlineCache(MethodImpl miss);
+
+            static uintptr_t callable_key(const value_t &callable) {
+                return callable.bits;
+            }
+
+            static uintptr_t argument_key(const value_t *argument) {
+                if (argument == nullptr) {
+                    return 0;
+                }
+                else if (argument->is_ref()) {
+                    return *reinterpret_cast<const uintptr_t *>(argument->ref());
+                }
+                else {
+                    return static_cast<uintptr_t>(argument->kind());
+                }
+            }
+
+            //returns false if the site became megamorphic
+            bool update(uintptr_t callable, uintptr_t lhs, uintptr_t rhs, MethodImpl target);
+
+            //replaces target from by to in all entries
+            void retarget(MethodImpl from, MethodImpl to);
+        };
+
+        struct Apply : public SharedNode {
             std::atomic<MethodImpl> target_;
+            InlineCache cache_;
             size_t line_;
             gc::ref<Node> callable_;
             gc::ref<NodeList> arguments_;
             bool bootstrap_apply = false;
             bool throws_ = true;
+            //the function of the closures applied here, for inlining by the optimizing jit
+            gc::ref<Function> callee_;
+            std::atomic<bool> callee_varies_{false};
+            Compiler *compiler_ = nullptr; //set when compiled code probes cache_, so the compiler forgets the apply with it
 
 
             Apply(size_t line, gc::ref<Node> callable, gc::ref<NodeList> arguments);
 
+            ~Apply() override;
+
             static gc::ref<Apply> create_boot_0(gc::allocator_t &allocator);
             static gc::ref<Apply> create_boot_1(gc::allocator_t &allocator);
             static gc::ref<Apply> create_boot_2(gc::allocator_t &allocator);
@@ -584,6 +645,8 @@ namespace park {
                 target_.store(target, std::memory_order_relaxed);
             }
 
+            void record_callee(gc::allocator_t &allocator, const Function &function);
+
             void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
                 if(callable_) {
                     accept(callable_);
@@ -591,6 +654,9 @@ namespace park {
                 if(arguments_) {
                     accept(arguments_);
                 }
+                if(callee_) {
+                    accept(callee_);
+                }
             }
 
         };
@@ -17,34 +17,35 @@
  * along with Park. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+
 #include "atom.h"
 #include "builtin.h"
+#include "boolean.h"
 #include "visitor.h"
 
 namespace park {
 
-std::array<std::mutex, 1024> object_locks;
-
-std::mutex &object_lock(void *ptr) {
-    //TODO how good is the hash wrt high bits always being 00?
-    auto idx = std::hash<void *>{}(ptr) % 1024;
-    return object_locks[idx];
-}
+//number of spin rounds before backoff starts yielding the fiber
+const int64_t BACKOFF_SPIN_LIMIT = 6;
 
-//TODO lock not always needed, e.g. when write barrier is off, we could use atomic
 class AtomImpl : public SharedValueImpl<Atom, AtomImpl>
 {
 private:
-    gc::ref<Value> v_;
+    std::atomic<const Value *> v_;
+
+    std::atomic<int64_t> contended_ = 0; //number of failed compare_and_sets
 
     static gc::ref<Value> DEREF;
     static gc::ref<Value> COMPARE_AND_SET;
     static gc::ref<Value> ATOM;
+    static gc::ref<Value> BACKOFF;
+    static gc::ref<Value> CONTENTION;
 
 public:
 
     AtomImpl(gc::ref<Value> v)
-        : v_(v)
+        : v_(v.get())
     {
         assert(is_shared_ref(v));
     }
@@ -53,24 +54,27 @@ public:
         out << "<atom>";
     }
 
+    //lock-free, when the write barrier is on the overwritten and the new value
+    //are recorded just like gc::ref_write would do for a plain slot
     bool compare_and_set(Fiber &fbr, gc::ref<Value> old_val, gc::ref<Value> new_val) {
         assert(gc::is_shared_ref(old_val));
-        std::lock_guard guard(object_lock(this));
-        if(v_ == old_val) {
-            gc::ref_write<Value>(fbr.allocator(), v_, new_val);
-            return true;
-        }
-        else {
+        auto &allocator = fbr.allocator();
+        allocator.share(new_val);
+        auto expected = old_val.get();
+        if(!v_.compare_exchange_strong(expected, new_val.get())) {
+            contended_.fetch_add(1, std::memory_order_relaxed);
             return false;
         }
+        if(allocator.write_barrier_) {
+            std::lock_guard<std::mutex> lock_guard(allocator.lock_);
+            allocator.ref_list_.push_back(old_val.get());
+            allocator.ref_list_.push_back(new_val.get());
+        }
+        return true;
     }
 
     gc::ref<Value> deref() const {
-        auto &lock = object_lock(static_cast<void *>(const_cast<AtomImpl *>(this)));
-        lock.lock();
-        auto v = v_;
-        lock.unlock();
-        return v;
+        return v_.load(std::memory_order_acquire);
     }
 
     gc::ref<Value> value() const override {
@@ -135,6 +139,50 @@ public:
         });
     }
 
+    //backoff(attempt) is called by swap between failed compare_and_sets. the first rounds
+    //spin for an exponentially growing number of pauses, after that the fiber yields
+    //to the others on its worker
+    static int64_t _backoff(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        int64_t attempt;
+
+        auto check = frame.check().
+            static_dispatch(*BACKOFF).
+            argument_count(1).
+            argument<int64_t>(1, attempt);
+
+        if(check && attempt <= BACKOFF_SPIN_LIMIT) {
+            for(int64_t i = 0; i < (int64_t(1) << std::max<int64_t>(attempt, 0)); i++) {
+                __builtin_ia32_pause();
+            }
+            return check.result<bool>([]() {
+                return true;
+            });
+        }
+
+        return check.cc_resume([](Fiber &fbr) -> bool {
+            fbr.resume_async([](Fiber &fbr) {
+                fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+            }, 0);
+            return false; //yield
+        });
+    }
+
+    static int64_t _contention(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<AtomImpl> self;
+
+        return frame.check().
+            static_dispatch(*CONTENTION).
+            argument_count(1).
+            argument<AtomImpl>(1, self).
+            result<int64_t>([&]() {
+                return self->contended_.load(std::memory_order_relaxed);
+            });
+    }
+
     static void init(Runtime &runtime) {
         TYPE = runtime.create_type("Atom");
 
@@ -146,6 +194,9 @@ public:
         COMPARE_AND_SET = runtime.builtin("compare_and_set");
         runtime.register_method(COMPARE_AND_SET, *TYPE, _compare_and_set);
 
+        BACKOFF = runtime.create_builtin<BuiltinStaticDispatch>("backoff", AtomImpl::_backoff);
+        CONTENTION = runtime.create_builtin<BuiltinStaticDispatch>("contention", AtomImpl::_contention);
+
     }
 
 };
@@ -153,6 +204,8 @@ public:
 gc::ref<Value> AtomImpl::DEREF;
 gc::ref<Value> AtomImpl::COMPARE_AND_SET;
 gc::ref<Value> AtomImpl::ATOM;
+gc::ref<Value> AtomImpl::BACKOFF;
+gc::ref<Value> AtomImpl::CONTENTION;
 
 gc::ref<Atom> Atom::create(gc::allocator_t &allocator, gc::ref<Value> initial)
 {
@@ -41,6 +41,37 @@
 
 namespace park {
 
+    DispatchTable::DispatchTable(bool binary) : binary_(binary) {
+        tables_.push_back(std::unique_ptr<table_t>(new table_t{0, nullptr}));
+        current_.store(tables_.back().get());
+    }
+
+    void DispatchTable::insert(MethodImpl method, size_t lhs, size_t rhs) {
+        auto const &table = *current_.load();
+        if (lhs >= table.size || rhs >= table.size) {
+            //grow to fit, with some room for types created later (e.g. structs)
+            auto const size = std::max(lhs, rhs) + 16;
+            auto const count = binary_ ? size * size : size;
+            auto grown = std::unique_ptr<table_t>(new table_t{size, std::make_unique<std::atomic<MethodImpl>[]>(count)});
+            for (size_t i = 0; i < count; i++) {
+                grown->methods[i].store(nullptr, std::memory_order_relaxed);
+            }
+            for (size_t l = 0; l < table.size; l++) {
+                for (size_t r = 0; r < (binary_ ? table.size : 1); r++) {
+                    grown->methods[index(*grown, l, r)].store(
+                            table.methods[index(table, l, r)].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                }
+            }
+            tables_.push_back(std::move(grown));
+            current_.store(tables_.back().get(), std::memory_order_release);
+        }
+        auto const &current = *current_.load();
+        auto &slot = current.methods[index(current, lhs, rhs)];
+        if (slot.load(std::memory_order_relaxed) == nullptr) {
+            slot.store(method, std::memory_order_relaxed);
+        }
+    }
+
     MethodImpl BuiltinBinaryDispatch::dispatch(Fiber &fbr, const AST::Apply &apply) const {
 
         Frame frame(fbr, apply);
@@ -48,46 +79,29 @@ namespace park {
             throw std::runtime_error("wrong number of arguments");
         }
 
-        //std::cout << "a1" << std::endl;
+        //most specific first: unboxed kinds, then types
+        auto const kind_of_lhs = id(frame.argument_kind(1));
+        auto const kind_of_rhs = id(frame.argument_kind(2));
 
-        {
-            auto found = methods_by_kind_kind_.find({frame.argument_kind(1), frame.argument_kind(2)});
-            if (found != methods_by_kind_kind_.end()) {
-                return found->second;
-            }
+        if (auto method = methods.find(kind_of_lhs, kind_of_rhs)) {
+            return method;
         }
 
-        //std::cout << "a2" << std::endl;
+        auto const typeof_lhs = frame.argument_type(1).id();
 
-        {
-            auto const &typeof_lhs = frame.argument_type(1);
-            auto kind_of_rhs = frame.argument_kind(2);
-            auto found = methods_by_type_kind_.find({&typeof_lhs, kind_of_rhs});
-            if (found != methods_by_type_kind_.end()) {
-                return found->second;
-            }
+        if (auto method = methods.find(typeof_lhs, kind_of_rhs)) {
+            return method;
         }
 
-        {
-            auto kind_of_lhs = frame.argument_kind(1);
-            auto const &typeof_rhs = frame.argument_type(2);
-            auto found = methods_by_kind_type_.find({kind_of_lhs, &typeof_rhs});
-            if (found != methods_by_kind_type_.end()) {
-                return found->second;
-            }
-        }
+        auto const typeof_rhs = frame.argument_type(2).id();
 
-        {
-            auto const &typeof_lhs = frame.argument_type(1);
-            auto const &typeof_rhs = frame.argument_type(2);
-            auto found = methods_by_type_type_.find({&typeof_lhs, &typeof_rhs});
-            if (found != methods_by_type_type_.end()) {
-                return found->second;
-            }
+        if (auto method = methods.find(kind_of_lhs, typeof_rhs)) {
+            return method;
         }
 
-
-        //std::cout << "a3" << std::endl;
+        if (auto method = methods.find(typeof_lhs, typeof_rhs)) {
+            return method;
+        }
 
         throw Error::operator_not_defined_for_argument_types(fbr, *this, frame.argument_type(1),
                                                              frame.argument_type(2));
@@ -99,9 +113,8 @@ namespace park {
         if (apply.argument_count() < 1) {
             throw std::runtime_error("wrong number of arguments");
         }
-        auto found = methods.find(&frame.argument_type(1));
-        if (found != methods.end()) {
-            return found->second;
+        if (auto method = methods.find(frame.argument_type(1).id())) {
+            return method;
         } else {
             throw Error::function_not_defined_for_argument_type(fbr, apply.line_, *this, frame.argument_type(1));//todo actually pass value not type
         }
@@ -114,6 +127,7 @@ namespace park {
     gc::ref<BuiltinStaticDispatch> Builtin::CHR;
     gc::ref<BuiltinStaticDispatch> Builtin::SLURP;
     gc::ref<BuiltinStaticDispatch> Builtin::SPIT;
+    gc::ref<BuiltinStaticDispatch> Builtin::CHUNKED;
 
     gc::ref<BuiltinSingleDispatch> Builtin::CONTAINS;
     gc::ref<BuiltinSingleDispatch> Builtin::NOT;
@@ -132,6 +146,10 @@ namespace park {
     gc::ref<BuiltinSingleDispatch> Builtin::HASH;
     gc::ref<BuiltinSingleDispatch> Builtin::DEREF;
     gc::ref<BuiltinSingleDispatch> Builtin::COMPARE_AND_SET;
+    gc::ref<BuiltinSingleDispatch> Builtin::ACQUIRE;
+    gc::ref<BuiltinSingleDispatch> Builtin::RELEASE;
+    gc::ref<BuiltinSingleDispatch> Builtin::WAIT;
+    gc::ref<BuiltinSingleDispatch> Builtin::CHUNKS;
 
     gc::ref<BuiltinBinaryDispatch> Builtin::EQUALS;
     gc::ref<BuiltinBinaryDispatch> Builtin::NOT_EQUALS;
@@ -141,6 +159,7 @@ namespace park {
     gc::ref<BuiltinBinaryDispatch> Builtin::LESSTHAN;
     gc::ref<BuiltinBinaryDispatch> Builtin::GREATERTHAN;
     gc::ref<BuiltinBinaryDispatch> Builtin::MODULO;
+    gc::ref<BuiltinBinaryDispatch> Builtin::DIVIDE;
 
 
     void BuiltinImpl::init(Runtime &runtime) {
@@ -160,8 +179,10 @@ namespace park {
         Builtin::LESSTHAN = runtime.create_builtin<BuiltinBinaryDispatch>("lt");
         Builtin::GREATERTHAN = runtime.create_builtin<BuiltinBinaryDispatch>("gt");
         Builtin::MODULO = runtime.create_builtin<BuiltinBinaryDispatch>("mod");
+        Builtin::DIVIDE = runtime.create_builtin<BuiltinBinaryDispatch>("divide");
 
         runtime.create_builtin<BuiltinSingleDispatch>("int");
+        runtime.create_builtin<BuiltinSingleDispatch>("float");
 
         Builtin::LENGTH = runtime.create_builtin<BuiltinSingleDispatch>("length");
         Builtin::HASH = runtime.create_builtin<BuiltinSingleDispatch>("hash");
@@ -173,6 +194,40 @@ namespace park {
         Builtin::CONJ = runtime.create_builtin<BuiltinSingleDispatch>("conj");
         Builtin::NOT = runtime.create_builtin<BuiltinSingleDispatch>("not");
 
+        runtime.create_builtin<BuiltinSingleDispatch>("transient");
+        runtime.create_builtin<BuiltinSingleDispatch>("persistent");
+        runtime.create_builtin<BuiltinSingleDispatch>("subvec");
+        runtime.create_builtin<BuiltinSingleDispatch>("split_at");
+        runtime.create_builtin<BuiltinSingleDispatch>("partition");
+
+        runtime.create_builtin<BuiltinSingleDispatch>("sum");
+        runtime.create_builtin<BuiltinSingleDispatch>("min");
+        runtime.create_builtin<BuiltinSingleDispatch>("max");
+        runtime.create_builtin<BuiltinSingleDispatch>("where");
+
+        runtime.create_builtin<BuiltinSingleDispatch>("union");
+        runtime.create_builtin<BuiltinSingleDispatch>("intersection");
+        runtime.create_builtin<BuiltinSingleDispatch>("difference");
+
+        //chunked iteration for the sequence functions in the prelude: chunks(coll) gives a sequence that
+        //chunk_first splits into a chunk (indexable by get and length) and chunk_next into the rest
+        Builtin::CHUNKS = runtime.create_builtin<BuiltinSingleDispatch>("chunks");
+        runtime.create_builtin<BuiltinSingleDispatch>("chunk_first");
+        runtime.create_builtin<BuiltinSingleDispatch>("chunk_next");
+
+        Builtin::CHUNKED = runtime.create_builtin<BuiltinStaticDispatch>("chunked",
+            [](Fiber &fbr, const AST::Apply &apply) -> int64_t {
+
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*Builtin::CHUNKED).
+                argument_count(1).
+                result<bool>([&]() {
+                    return Builtin::CHUNKS->has_method(frame.argument_type(1));
+                });
+        });
+
         Builtin::FIRST = runtime.create_builtin<BuiltinSingleDispatch>("first");
         Builtin::NEXT = runtime.create_builtin<BuiltinSingleDispatch>("next");
 
@@ -186,6 +241,10 @@ namespace park {
         Builtin::DEREF = runtime.create_builtin<BuiltinSingleDispatch>("deref");
         Builtin::COMPARE_AND_SET = runtime.create_builtin<BuiltinSingleDispatch>("compare_and_set");
 
+        Builtin::ACQUIRE = runtime.create_builtin<BuiltinSingleDispatch>("acquire");
+        Builtin::RELEASE = runtime.create_builtin<BuiltinSingleDispatch>("release");
+        Builtin::WAIT = runtime.create_builtin<BuiltinSingleDispatch>("wait");
+
 
 
         Builtin::PRINT = runtime.create_builtin<BuiltinStaticDispatch>("print", 
@@ -260,32 +319,6 @@ namespace park {
         builtins.insert({{runtime.intern("typeof"), Builtin::TYPEOF}});
 
 
-        //TODO move into range.cc init
-        Builtin::RANGE = std::make_shared<BuiltinStaticDispatch>("range", 
-            [](Fiber &fbr, const AST::Apply &apply) -> int64_t {
-
-                Frame frame(fbr, apply);
-
-                int64_t res = 0;
-
-                if(!frame.check_static_dispatch(*Builtin::RANGE, res)) {
-                    return res;
-                }
-
-                if(!frame.check_argument_count(1, res)) {
-                    return res;
-                }
-               
-                frame.pop_arguments_and_push_result<const Value &>(
-                    Range::from_range(fbr, 0, frame.argument<const Value &>(1).to_index(fbr))
-                );
-
-                return res;
-            });
-
-        builtins.insert({{runtime.intern("range"), Builtin::RANGE}});
-
-
         Builtin::ORD = std::make_shared<BuiltinStaticDispatch>("ord", 
             [](Fiber &fbr, const AST::Apply &apply) -> int64_t {
 
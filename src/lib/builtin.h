@@ -21,9 +21,15 @@
 #define __BUILTIN_H
 
 #include <map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #include "value.h"
 #include "frame.h"
+#include "type.h"
 
 namespace park {
 
@@ -42,6 +48,7 @@ namespace park {
         static gc::ref<BuiltinStaticDispatch> CHR;
         static gc::ref<BuiltinStaticDispatch> SLURP;
         static gc::ref<BuiltinStaticDispatch> SPIT;
+        static gc::ref<BuiltinStaticDispatch> CHUNKED;
 
         static gc::ref<BuiltinSingleDispatch> CONTAINS;
         static gc::ref<BuiltinSingleDispatch> NOT;
@@ -61,6 +68,10 @@ namespace park {
         static gc::ref<BuiltinSingleDispatch> HASH;
         static gc::ref<BuiltinSingleDispatch> DEREF;
         static gc::ref<BuiltinSingleDispatch> COMPARE_AND_SET;
+        static gc::ref<BuiltinSingleDispatch> ACQUIRE;
+        static gc::ref<BuiltinSingleDispatch> RELEASE;
+        static gc::ref<BuiltinSingleDispatch> WAIT;
+        static gc::ref<BuiltinSingleDispatch> CHUNKS;
 
         static gc::ref<BuiltinBinaryDispatch> EQUALS;
         static gc::ref<BuiltinBinaryDispatch> NOT_EQUALS;
@@ -70,6 +81,7 @@ namespace park {
         static gc::ref<BuiltinBinaryDispatch> LESSTHAN;
         static gc::ref<BuiltinBinaryDispatch> GREATERTHAN;
         static gc::ref<BuiltinBinaryDispatch> MODULO;
+        static gc::ref<BuiltinBinaryDispatch> DIVIDE;
 
 
     };
@@ -109,21 +121,81 @@ namespace park {
 
     
 
+    //methods indexed by dispatch id (the id of a type, or the kind of an unboxed value),
+    //a 2-D table of ids x ids for binary dispatch. Registering a method for an id that does not fit
+    //copies into a bigger table, old tables are kept so that dispatch can read without a lock
+    class DispatchTable {
+    private:
+        struct table_t {
+            const size_t size; //ids per dimension
+            std::unique_ptr<std::atomic<MethodImpl>[]> methods;
+        };
+
+        const bool binary_;
+        std::vector<std::unique_ptr<table_t>> tables_; //the last one is current
+        std::atomic<const table_t *> current_;
+
+        size_t index(const table_t &table, size_t lhs, size_t rhs) const {
+            return binary_ ? lhs * table.size + rhs : lhs;
+        }
+
+    public:
+        explicit DispatchTable(bool binary);
+
+        MethodImpl find(size_t lhs, size_t rhs = 0) const {
+            auto const table = current_.load(std::memory_order_acquire);
+            if (lhs >= table->size || rhs >= table->size) {
+                return nullptr;
+            }
+            return table->methods[index(*table, lhs, rhs)].load(std::memory_order_relaxed);
+        }
+
+        //call with runtime lock (or during init), first registration wins
+        void insert(MethodImpl method, size_t lhs, size_t rhs = 0);
+    };
+
     class BuiltinSingleDispatch : public BuiltinImpl {
     protected:
-        std::map<const Type *, MethodImpl> methods;
+        DispatchTable methods;
+
+        std::mutex implementations_lock_;
+        std::unordered_map<size_t, gc::ref<Value>> implementations_; //closures whose code is in methods, by type id
 
     public:
         explicit BuiltinSingleDispatch(const std::string &name) :
-                BuiltinImpl(name) {}
+                BuiltinImpl(name), methods(false) {}
 
         MethodImpl dispatch(Fiber &fbr, const AST::Apply &apply) const override;
 
         void register_method(const Type &self, MethodImpl method) {
-            methods.insert(std::pair<const Type *, MethodImpl>({&self, method}));
+            methods.insert(method, self.id());
         }
 
-        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}  
+        //registers the code of a closure, the closure is kept alive for as long as the table refers to its code
+        void register_method(gc::allocator_t &allocator, const Type &self, MethodImpl method, gc::ref<Value> closure) {
+            if (has_method(self)) {
+                return; //first registration wins, the closure is not needed
+            }
+            std::lock_guard<std::mutex> guard(implementations_lock_);
+            gc::ref_write(allocator, implementations_[self.id()], closure);
+            methods.insert(method, self.id());
+        }
+
+        bool has_method(const Type &self) const {
+            return methods.find(self.id()) != nullptr;
+        }
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+            std::vector<gc::ref<Value>> implementations;
+            implementations_lock_.lock();
+            for (auto &item : implementations_) {
+                implementations.push_back(item.second);
+            }
+            implementations_lock_.unlock();
+            for (auto &item : implementations) {
+                accept(item);
+            }
+        }
 
     };
 
@@ -131,31 +203,32 @@ namespace park {
     class BuiltinBinaryDispatch : public BuiltinImpl {
 
     protected:
-        std::map<std::pair<const Type *, const Type *>, MethodImpl> methods_by_type_type_;
-        std::map<std::pair<value_t::kind_t, value_t::kind_t>, MethodImpl> methods_by_kind_kind_;
-        std::map<std::pair<value_t::kind_t, const Type *>, MethodImpl> methods_by_kind_type_;
-        std::map<std::pair<const Type *, value_t::kind_t>, MethodImpl> methods_by_type_kind_;
+        DispatchTable methods;
+
+        static size_t id(value_t::kind_t kind) {
+            return static_cast<size_t>(kind);
+        }
 
     public:
         explicit BuiltinBinaryDispatch(const std::string &name) :
-                BuiltinImpl(name) {}
+                BuiltinImpl(name), methods(true) {}
 
         MethodImpl dispatch(Fiber &fbr, const AST::Apply &apply) const override;
 
         void register_method(const Type &lhs, const Type &rhs, MethodImpl method) {
-            methods_by_type_type_.insert({{&lhs, &rhs}, method});
+            methods.insert(method, lhs.id(), rhs.id());
         }
 
         void register_method(value_t::kind_t lhs, value_t::kind_t rhs, MethodImpl method) {
-            methods_by_kind_kind_.insert({{lhs, rhs}, method});
+            methods.insert(method, id(lhs), id(rhs));
         }
 
         void register_method(value_t::kind_t lhs, const Type &rhs, MethodImpl method) {
-            methods_by_kind_type_.insert({{lhs, &rhs}, method});
+            methods.insert(method, id(lhs), rhs.id());
         }
 
         void register_method(const Type &lhs, value_t::kind_t rhs, MethodImpl method) {
-            methods_by_type_kind_.insert({{&lhs, rhs}, method});
+            methods.insert(method, lhs.id(), id(rhs));
         }
 
         void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}  
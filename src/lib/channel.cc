@@ -19,29 +19,169 @@
 
 #include <deque>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
+
+#include <boost/asio.hpp>
 
 #include "runtime.h"
 #include "channel.h"
 #include "fiber.h"
 #include "type.h"
 #include "boolean.h"
+#include "integer.h"
+#include "vector.h"
 #include "frame.h"
 #include "builtin.h"
 
 namespace park {
 
+    class ChannelImpl;
+
+    //shared between all the registrations of a single blocked select,
+    //the first party to claim it gets to resume the selecting fiber
+    struct selection_t {
+        std::atomic<bool> fired_ = false;
+        std::vector<gc::ref<ChannelImpl>> channels_;
+
+        std::mutex timer_lock_;
+        std::unique_ptr<boost::asio::deadline_timer> timer_; //the timeout, disarmed by cancel
+
+        bool claim() {
+            return !fired_.exchange(true);
+        }
+
+        void cancel();
+    };
+
+    using selection_ptr_t = std::shared_ptr<selection_t>;
+
     class ChannelImpl : public SharedValueImpl<Channel, ChannelImpl> {
     private:
+        struct receiver_t {
+            gc::ref<Fiber> fiber;
+            selection_ptr_t selection; //null for a plain recv
+            int64_t index;
+            int64_t max = 0; //recv_many, resumed with a vector of up to max values
+        };
+
+        struct sender_t {
+            gc::ref<Fiber> fiber;
+            gc::ref<Value> value; //for send_all the vector of pending values
+            selection_ptr_t selection; //null for a plain send
+            int64_t index;
+            size_t offset = 0; //send_all, next pending value to hand out
+            bool batch = false;
+        };
+
+        using woken_t = std::vector<std::pair<receiver_t, gc::ref<Value>>>;
+
         std::mutex lock_; //TODO use object locks array instead
 
         //use intrusive list on fibers for these:
         //TODO interactions of these with gc?, yes they would need write barrier
-        std::deque<gc::ref<Fiber>> receivers_;
-        std::deque<std::pair<gc::ref<Fiber>, gc::ref<Value>>> senders_;
+        std::deque<receiver_t> receivers_;
+        std::deque<sender_t> senders_;
 
         static gc::ref<Value> RECV;
         static gc::ref<Value> SEND;
         static gc::ref<Value> CHANNEL;
+        static gc::ref<Value> SELECT;
+        static gc::ref<Value> SEND_ALL;
+        static gc::ref<Value> RECV_MANY;
+
+        static std::atomic<size_t> select_start_; //where the next select starts looking for a ready case
+
+        friend struct selection_t;
+
+        //pops the first waiting fiber that can still be resumed,
+        //registrations of selects that already fired elsewhere are dropped
+        //requires lock_
+        template<typename T>
+        static bool pop_waiting(std::deque<T> &waiting, T &out) {
+            while (!waiting.empty()) {
+                out = waiting.front();
+                waiting.pop_front();
+                if (!out.selection || out.selection->claim()) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        //takes up to max values from the waiting senders in order, a send_all hands out
+        //as many of its pending values as fit. senders that have nothing left are moved
+        //to done, to be woken once the lock is released
+        //requires lock_
+        void take(size_t max, std::vector<gc::ref<Value>> &values, std::vector<sender_t> &done) {
+            while (values.size() < max && !senders_.empty()) {
+                auto &sending = senders_.front();
+                if (sending.batch) {
+                    auto pending = gc::ref_cast<Vector>(sending.value);
+                    while (values.size() < max && sending.offset < pending->size()) {
+                        values.push_back(pending->nth(sending.offset++));
+                    }
+                    if (sending.offset < pending->size()) {
+                        return;
+                    }
+                    done.push_back(sending);
+                }
+                else if (!sending.selection || sending.selection->claim()) {
+                    values.push_back(sending.value);
+                    done.push_back(sending);
+                }
+                senders_.pop_front();
+            }
+        }
+
+        //hands out values [offset, count) to the waiting receivers in order, a recv_many
+        //receiver gets up to its max in one go. returns the offset of the first value
+        //that could not be handed out
+        //requires lock_
+        template<typename F>
+        size_t give(Fiber &fbr, size_t offset, size_t count, F nth, woken_t &woken) {
+            receiver_t receiving;
+            while (offset < count && pop_waiting(receivers_, receiving)) {
+                if (receiving.max > 0) {
+                    auto values = TransientVector::create(fbr, Vector::create(fbr));
+                    for (int64_t i = 0; i < receiving.max && offset < count; i++) {
+                        values.mutate()->conj(fbr, nth(offset++));
+                    }
+                    woken.emplace_back(receiving, values.mutate()->persistent(fbr));
+                }
+                else {
+                    woken.emplace_back(receiving, nth(offset++));
+                }
+            }
+            return offset;
+        }
+
+        //requires lock_
+        void remove(const selection_t *selection) {
+            auto pred = [&](auto &item) { return item.selection.get() == selection; };
+            receivers_.erase(std::remove_if(receivers_.begin(), receivers_.end(), pred), receivers_.end());
+            senders_.erase(std::remove_if(senders_.begin(), senders_.end(), pred), senders_.end());
+        }
+
+        //the result of a select is the vector [index, value]
+        static gc::ref<Value> selected(Fiber &fbr, int64_t index, gc::ref<Value> value) {
+            return Vector::create(fbr)->
+                conj(fbr, Integer::create(fbr, index))->
+                conj(fbr, value);
+        }
+
+        //resumes a fiber that was waiting on a channel, call without any channel lock held
+        template<typename T>
+        static void wake(Fiber &fbr, const T &waiting, gc::ref<Value> value) {
+            if (waiting.selection) {
+                waiting.selection->cancel();
+                value = selected(fbr, waiting.index, value);
+            }
+            gc::make_shared(fbr.allocator(), value);
+            waiting.fiber.mutate()->resume_async([value](Fiber &fbr) {
+                fbr.stack.push<gc::ref<Value>>(value);
+            }, 0);
+        }
 
     public:
         static void init(Runtime &runtime);
@@ -52,11 +192,11 @@ namespace park {
             auto receivers = receivers_;
             lock_.unlock();
             for(auto &item : receivers) {
-                accept(item);
+                accept(item.fiber);
             }
             for(auto &item : senders) {
-                accept(item.first);
-                accept(item.second);
+                accept(item.fiber);
+                accept(item.value);
             }
         }
 
@@ -70,23 +210,24 @@ namespace park {
                 argument_count(1).
                 argument<ChannelImpl>(1, channel).
                 cc_resume([channel](Fiber &fbr) {
-                    std::lock_guard<std::mutex> lock_guard(channel.mutate()->lock_);
+                    std::unique_lock<std::mutex> lock(channel.mutate()->lock_);
 
                     auto &receiver = fbr;
 
-                    if (!channel->senders_.empty()) {
-                        auto sending = channel->senders_.front(); 
-                        channel.mutate()->senders_.pop_front();
-                        auto &sender = sending.first;
-                        receiver.stack.push<gc::ref<Value>>(sending.second);
-                        sender.mutate()->resume_async([result=sending.second](Fiber &fbr) {
-                            fbr.stack.push<gc::ref<Value>>(result);
-                        }, 0);
+                    std::vector<gc::ref<Value>> values;
+                    std::vector<sender_t> done;
+                    channel.mutate()->take(1, values, done);
+                    if (!values.empty()) {
+                        lock.unlock();
+                        receiver.stack.push<gc::ref<Value>>(values[0]);
+                        for (auto &sending : done) {
+                            wake(receiver, sending, sending.value);
+                        }
                         return true; // no block, resume with result
                     }
                     else {
                         //no sender
-                        channel.mutate()->receivers_.emplace_back(&receiver);
+                        channel.mutate()->receivers_.push_back({&receiver, nullptr, 0});
                         return false; // block
                     }
                 });                
@@ -105,30 +246,267 @@ namespace park {
                 argument<ChannelImpl>(1, channel).
                 argument<Value>(2, value).
                 cc_resume([channel, value](Fiber &fbr) -> bool {
-                    std::lock_guard<std::mutex> lock_guard(channel.mutate()->lock_);
+                    std::unique_lock<std::mutex> lock(channel.mutate()->lock_);
 
                     auto &sender = fbr;
 
                     gc::make_shared(fbr.allocator(), value);
 
-                    if (!channel->receivers_.empty()) {
+                    woken_t woken;
+                    if (channel.mutate()->give(sender, 0, 1, [&](size_t) { return value; }, woken) == 1) {
                         // a receiver is present
-                        auto receiver = channel->receivers_.front(); 
-                        channel.mutate()->receivers_.pop_front();
-                        receiver.mutate()->resume_async([value](Fiber &fbr) {
-                            fbr.stack.push<gc::ref<Value>>(value);
-                        }, 0);
+                        lock.unlock();
+                        wake(sender, woken[0].first, woken[0].second);
                         sender.stack.push<gc::ref<Value>>(value);
                         return true; //continue
                     }
                     else {
                         // no receiver
-                        channel.mutate()->senders_.emplace_back(&sender, value);
+                        channel.mutate()->senders_.push_back({&sender, value, nullptr, 0});
                         return false; //block
                     }
                 });
         }
 
+        //send_all(channel, values) sends all values of the vector in order. values are handed
+        //to the waiting receivers under a single lock, whatever remains is left pending on the
+        //channel and the sender blocks once until receivers have drained it
+        static int64_t _send_all(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<ChannelImpl> channel;
+            gc::ref<Vector> values;
+
+            auto check = frame.check().
+                static_dispatch(*SEND_ALL).
+                argument_count(2).
+                argument<ChannelImpl>(1, channel).
+                argument<Vector>(2, values);
+
+            if (!check) {
+                return check.result();
+            }
+
+            if (&channel->get_type() != TYPE.get() || &values->get_type() != &Vector::type()) {
+                throw std::runtime_error("send_all expects a channel and a vector");
+            }
+
+            return check.cc_resume([channel, values](Fiber &fbr) -> bool {
+                std::unique_lock<std::mutex> lock(channel.mutate()->lock_);
+
+                auto &sender = fbr;
+
+                gc::make_shared(fbr.allocator(), values);
+
+                woken_t woken;
+                auto count = values->size();
+                auto offset = channel.mutate()->give(sender, 0, count, [&](size_t i) { return values->nth(i); }, woken);
+
+                auto block = offset < count;
+                if (block) {
+                    channel.mutate()->senders_.push_back({&sender, values, nullptr, 0, offset, true});
+                }
+                lock.unlock();
+
+                for (auto &item : woken) {
+                    wake(sender, item.first, item.second);
+                }
+
+                if (block) {
+                    return false; //block
+                }
+                sender.stack.push<gc::ref<Value>>(values);
+                return true; //continue
+            });
+        }
+
+        //recv_many(channel, max) receives between 1 and max values in one go and returns them as a vector,
+        //it only blocks when there is no sender at all
+        static int64_t _recv_many(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<ChannelImpl> channel;
+            int64_t max;
+
+            auto check = frame.check().
+                static_dispatch(*RECV_MANY).
+                argument_count(2).
+                argument<ChannelImpl>(1, channel).
+                argument<int64_t>(2, max);
+
+            if (!check) {
+                return check.result();
+            }
+
+            if (&channel->get_type() != TYPE.get() || max < 1) {
+                throw std::runtime_error("recv_many expects a channel and a max of at least 1");
+            }
+
+            return check.cc_resume([channel, max](Fiber &fbr) -> bool {
+                std::unique_lock<std::mutex> lock(channel.mutate()->lock_);
+
+                auto &receiver = fbr;
+
+                std::vector<gc::ref<Value>> values;
+                std::vector<sender_t> done;
+                channel.mutate()->take(max, values, done);
+                if (!values.empty()) {
+                    lock.unlock();
+                    auto result = TransientVector::create(receiver, Vector::create(receiver));
+                    for (auto &value : values) {
+                        result.mutate()->conj(receiver, value);
+                    }
+                    receiver.stack.push<gc::ref<Value>>(result.mutate()->persistent(receiver));
+                    for (auto &sending : done) {
+                        wake(receiver, sending, sending.value);
+                    }
+                    return true; // no block, resume with result
+                }
+                else {
+                    //no sender
+                    channel.mutate()->receivers_.push_back({&receiver, nullptr, 0, max});
+                    return false; // block
+                }
+            });
+        }
+
+        struct select_case_t {
+            gc::ref<ChannelImpl> channel;
+            gc::ref<Value> value; //null for a recv case
+        };
+
+        //select(cases, timeout_ms?) where each case is [channel] to receive or [channel, value] to send.
+        //blocks until one case can proceed and returns [index, value] for it,
+        //returns [-1, false] when the timeout expires first, a timeout of 0 only polls.
+        static int64_t _select(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<Vector> cases;
+            int64_t timeout = -1;
+
+            auto check = frame.check().
+                static_dispatch(*SELECT).
+                argument_count(1, 2).
+                argument<Vector>(1, cases).
+                optional_argument<int64_t>(2, timeout);
+
+            if (!check) {
+                return check.result();
+            }
+
+            if (&cases->get_type() != &Vector::type()) {
+                throw std::runtime_error("select expects a vector of cases");
+            }
+
+            std::vector<select_case_t> select_cases;
+            for (size_t i = 0; i < cases->size(); i++) {
+                auto item = cases->nth(i);
+                if (&item->get_type() != &Vector::type()) {
+                    throw std::runtime_error("select case must be a vector [channel] or [channel, value]");
+                }
+                auto select_case = gc::ref_cast<Vector>(item);
+                if (select_case->size() < 1 || select_case->size() > 2 ||
+                    &select_case->nth(0)->get_type() != TYPE.get()) {
+                    throw std::runtime_error("select case must be a vector [channel] or [channel, value]");
+                }
+                select_cases.push_back({gc::ref_cast<ChannelImpl>(select_case->nth(0)),
+                                        select_case->size() == 2 ? select_case->nth(1) : gc::ref<Value>()});
+            }
+
+            if (select_cases.empty() && timeout < 0) {
+                throw std::runtime_error("select without cases would block forever");
+            }
+
+            return check.cc_resume([select_cases = std::move(select_cases), timeout](Fiber &fbr) -> bool {
+                //lock every distinct channel involved in address order, so that
+                //concurrent selects over overlapping channels cannot deadlock
+                std::vector<gc::ref<ChannelImpl>> channels;
+                for (auto &select_case : select_cases) {
+                    channels.push_back(select_case.channel);
+                    if (select_case.value) {
+                        gc::make_shared(fbr.allocator(), select_case.value);
+                    }
+                }
+                std::sort(channels.begin(), channels.end(), [](auto &a, auto &b) { return a.get() < b.get(); });
+                channels.erase(std::unique(channels.begin(), channels.end()), channels.end());
+
+                std::vector<std::unique_lock<std::mutex>> locks;
+                for (auto &channel : channels) {
+                    locks.emplace_back(channel.mutate()->lock_);
+                }
+
+                //a ready case wins, the scan starts at a rotating case so that later cases are not starved
+                auto start = select_start_.fetch_add(1, std::memory_order_relaxed);
+                for (size_t j = 0; j < select_cases.size(); j++) {
+                    auto i = (start + j) % select_cases.size();
+                    auto &select_case = select_cases[i];
+                    auto channel = select_case.channel.mutate();
+                    if (select_case.value) {
+                        woken_t woken;
+                        if (channel->give(fbr, 0, 1, [&](size_t) { return select_case.value; }, woken) == 1) {
+                            locks.clear();
+                            wake(fbr, woken[0].first, woken[0].second);
+                            fbr.stack.push<gc::ref<Value>>(selected(fbr, i, select_case.value));
+                            return true;
+                        }
+                    }
+                    else {
+                        std::vector<gc::ref<Value>> values;
+                        std::vector<sender_t> done;
+                        channel->take(1, values, done);
+                        if (!values.empty()) {
+                            locks.clear();
+                            for (auto &sending : done) {
+                                wake(fbr, sending, sending.value);
+                            }
+                            fbr.stack.push<gc::ref<Value>>(selected(fbr, i, values[0]));
+                            return true;
+                        }
+                    }
+                }
+
+                if (timeout == 0) {
+                    fbr.stack.push<gc::ref<Value>>(selected(fbr, -1, Boolean::create(false)));
+                    return true;
+                }
+
+                //nothing ready, register on all the channels at once
+                auto selection = std::make_shared<selection_t>();
+                selection->channels_ = channels;
+                for (size_t i = 0; i < select_cases.size(); i++) {
+                    auto &select_case = select_cases[i];
+                    auto channel = select_case.channel.mutate();
+                    if (select_case.value) {
+                        channel->senders_.push_back({&fbr, select_case.value, selection, (int64_t) i});
+                    }
+                    else {
+                        channel->receivers_.push_back({&fbr, selection, (int64_t) i});
+                    }
+                }
+                locks.clear();
+
+                if (timeout > 0) {
+                    //a case may already have won after we let go of the channel locks
+                    std::lock_guard<std::mutex> guard(selection->timer_lock_);
+                    if (!selection->fired_) {
+                        selection->timer_ = std::make_unique<boost::asio::deadline_timer>(Runtime::from_fbr(fbr).io_service);
+                        selection->timer_->expires_from_now(boost::posix_time::milliseconds(timeout));
+                        selection->timer_->async_wait([fiber = gc::ref<Fiber>(&fbr), selection](const boost::system::error_code &ec) {
+                            if (ec == boost::asio::error::operation_aborted || !selection->claim()) {
+                                return; //some case won
+                            }
+                            selection->cancel();
+                            fiber.mutate()->resume_sync([&](Fiber &fbr) {
+                                fbr.stack.push<gc::ref<Value>>(selected(fbr, -1, Boolean::create(false)));
+                            }, 0);
+                        });
+                    }
+                }
+
+                return false; //block
+            });
+        }
+
         static int64_t _channel(Fiber &fbr, const AST::Apply &apply) {
             Frame frame(fbr, apply);
 
@@ -145,6 +523,21 @@ namespace park {
         }
     };
 
+    //drop the losing registrations of a fired select,
+    //channels are locked one at a time so this can be called from any channel operation
+    void selection_t::cancel() {
+        {
+            std::lock_guard<std::mutex> guard(timer_lock_);
+            if (timer_) {
+                timer_->cancel();
+            }
+        }
+        for (auto &channel : channels_) {
+            std::lock_guard<std::mutex> lock_guard(channel.mutate()->lock_);
+            channel.mutate()->remove(this);
+        }
+    }
+
     gc::ref<Channel> Channel::create(Fiber &fbr) {
         return gc::make_shared_ref<ChannelImpl>(fbr.allocator());
     }
@@ -152,6 +545,11 @@ namespace park {
     gc::ref<Value> ChannelImpl::RECV;
     gc::ref<Value> ChannelImpl::SEND;
     gc::ref<Value> ChannelImpl::CHANNEL;
+    gc::ref<Value> ChannelImpl::SELECT;
+    gc::ref<Value> ChannelImpl::SEND_ALL;
+    gc::ref<Value> ChannelImpl::RECV_MANY;
+
+    std::atomic<size_t> ChannelImpl::select_start_{0};
 
     void ChannelImpl::init(Runtime &runtime) {
         TYPE = runtime.create_type("Channel");
@@ -163,6 +561,9 @@ namespace park {
         runtime.register_method(SEND, *TYPE, _send);
 
         CHANNEL = runtime.create_builtin<BuiltinStaticDispatch>("channel", _channel);
+        SELECT = runtime.create_builtin<BuiltinStaticDispatch>("select", _select);
+        SEND_ALL = runtime.create_builtin<BuiltinStaticDispatch>("send_all", _send_all);
+        RECV_MANY = runtime.create_builtin<BuiltinStaticDispatch>("recv_many", _recv_many);
     }
 
     void Channel::init(Runtime &runtime) {
@@ -46,6 +46,13 @@ namespace park {
             TYPE = runtime.create_type("Closure");
         }
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+        static size_t function_offset() {
+            return offsetof(ClosureImpl, function_);
+        }
+#pragma GCC diagnostic pop
+
         const AST::Function &function() const override {
             return *function_;
         }
@@ -86,8 +93,22 @@ namespace park {
 
     };
 
+    static std::atomic<uintptr_t> VTABLE_KEY{0};
+
     gc::ref<Closure> Closure::create(Fiber &fbr, gc::ref<AST::Function> function, size_t size) {
-        return gc::make_ref_fam<ClosureImpl, gc::ref<Value>>(fbr.allocator(), size, function, size);
+        auto closure = gc::make_ref_fam<ClosureImpl, gc::ref<Value>>(fbr.allocator(), size, function, size);
+        if (VTABLE_KEY.load(std::memory_order_relaxed) == 0) {
+            VTABLE_KEY.store(*reinterpret_cast<const uintptr_t *>(closure.get()), std::memory_order_relaxed);
+        }
+        return closure;
+    }
+
+    size_t Closure::function_offset() {
+        return ClosureImpl::function_offset();
+    }
+
+    uintptr_t Closure::vtable_key() {
+        return VTABLE_KEY.load(std::memory_order_relaxed);
     }
 
     void Closure::init(Runtime &runtime) {
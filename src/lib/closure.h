@@ -45,6 +45,12 @@ namespace park {
         
         static bool isinstance(const Value &value);
 
+        //for jit code that checks the function of a closure
+        static size_t function_offset();
+
+        //the word that identifies a closure in inline caches, see AST::InlineCache::argument_key
+        static uintptr_t vtable_key();
+
     };
 
 }
@@ -0,0 +1,327 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+
+#include "cmap.h"
+#include "builtin.h"
+#include "type.h"
+#include "visitor.h"
+
+namespace park {
+
+//concurrent map shared between fibers, keys are spread over shards that each have
+//their own lock and their own lru list for size bounded eviction
+class CMapImpl : public SharedValueImpl<CMap, CMapImpl>
+{
+private:
+    static const size_t NUM_SHARDS = 16;
+
+    struct entry_t {
+        size_t hash;
+        gc::ref<Value> key;
+        gc::ref<Value> value;
+    };
+
+    using lru_t = std::list<entry_t>;
+
+    struct shard_t {
+        std::mutex lock_;
+        lru_t lru_; //most recently used at front
+        std::unordered_multimap<size_t, lru_t::iterator> index_;
+    };
+
+    const size_t capacity_; //0 for unbounded
+    const size_t shard_capacity_;
+    std::unique_ptr<shard_t[]> shards_;
+
+    static gc::ref<Value> CMAP;
+    static gc::ref<Value> CMAP_GET;
+    static gc::ref<Value> CMAP_PUT;
+    static gc::ref<Value> CMAP_REPLACE;
+    static gc::ref<Value> LENGTH;
+
+    shard_t &shard(size_t hash) const {
+        return shards_[(hash ^ (hash >> 16)) % NUM_SHARDS];
+    }
+
+    //requires shard lock
+    static lru_t::iterator find(Fiber &fbr, shard_t &shard, size_t hash, const Value &key) {
+        auto range = shard.index_.equal_range(hash);
+        for(auto i = range.first; i != range.second; ++i) {
+            if(i->second->key->map_key_equals(fbr, key)) {
+                return i->second;
+            }
+        }
+        return shard.lru_.end();
+    }
+
+    //the write barrier, refs that get dropped from the map or stored into it need
+    //to be recorded while the collector is marking, see gc::ref_write
+    static void record(gc::allocator_t &allocator, std::initializer_list<gc::ref<Value>> refs) {
+        if(allocator.write_barrier_) {
+            std::lock_guard<std::mutex> lock_guard(allocator.lock_);
+            for(auto &ref : refs) {
+                if(ref) {
+                    allocator.ref_list_.push_back(ref.get());
+                }
+            }
+        }
+    }
+
+    //requires shard lock
+    void insert(Fiber &fbr, shard_t &shard, size_t hash, gc::ref<Value> key, gc::ref<Value> value) {
+        shard.lru_.push_front({hash, key, value});
+        shard.index_.emplace(hash, shard.lru_.begin());
+        record(fbr.allocator(), {key, value});
+        if(capacity_ > 0 && shard.lru_.size() > shard_capacity_) {
+            //evict least recently used
+            auto &evicted = shard.lru_.back();
+            auto range = shard.index_.equal_range(evicted.hash);
+            for(auto i = range.first; i != range.second; ++i) {
+                if(i->second == std::prev(shard.lru_.end())) {
+                    shard.index_.erase(i);
+                    break;
+                }
+            }
+            record(fbr.allocator(), {evicted.key, evicted.value});
+            shard.lru_.pop_back();
+        }
+    }
+
+public:
+    explicit CMapImpl(size_t capacity)
+        : capacity_(capacity),
+          shard_capacity_((capacity + NUM_SHARDS - 1) / NUM_SHARDS),
+          shards_(new shard_t[NUM_SHARDS]) {}
+
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        out << "<cmap " << this << ">";
+    }
+
+    size_t capacity() const override {
+        return capacity_;
+    }
+
+    const Value &accept(Fiber &fbr, Visitor &visitor) const override {
+        return visitor.visit(fbr, *this);
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            auto &shard = shards_[i];
+            std::lock_guard<std::mutex> lock_guard(shard.lock_);
+            for(auto &entry : shard.lru_) {
+                accept(entry.key);
+                accept(entry.value);
+            }
+        }
+    }
+
+    gc::ref<Value> get(Fiber &fbr, const Value &key) const {
+        auto hash = key.map_key_hash(fbr);
+        auto &shard = this->shard(hash);
+        std::lock_guard<std::mutex> lock_guard(shard.lock_);
+        auto found = find(fbr, shard, hash, key);
+        if(found == shard.lru_.end()) {
+            return nullptr;
+        }
+        shard.lru_.splice(shard.lru_.begin(), shard.lru_, found);
+        return found->value;
+    }
+
+    void put(Fiber &fbr, gc::ref<Value> key, gc::ref<Value> value) {
+        gc::make_shared(fbr.allocator(), key);
+        gc::make_shared(fbr.allocator(), value);
+        auto hash = key->map_key_hash(fbr);
+        auto &shard = this->shard(hash);
+        std::lock_guard<std::mutex> lock_guard(shard.lock_);
+        auto found = find(fbr, shard, hash, *key);
+        if(found != shard.lru_.end()) {
+            record(fbr.allocator(), {found->value, value});
+            found->value = value;
+            shard.lru_.splice(shard.lru_.begin(), shard.lru_, found);
+        }
+        else {
+            insert(fbr, shard, hash, key, value);
+        }
+    }
+
+    //stores value only if the current value is identical to expected, an absent key
+    //always matches so that a compute only races with writers of the same key
+    bool replace(Fiber &fbr, gc::ref<Value> key, gc::ref<Value> expected, gc::ref<Value> value) {
+        gc::make_shared(fbr.allocator(), key);
+        gc::make_shared(fbr.allocator(), value);
+        auto hash = key->map_key_hash(fbr);
+        auto &shard = this->shard(hash);
+        std::lock_guard<std::mutex> lock_guard(shard.lock_);
+        auto found = find(fbr, shard, hash, *key);
+        if(found != shard.lru_.end()) {
+            if(!(found->value == expected)) {
+                return false;
+            }
+            record(fbr.allocator(), {found->value, value});
+            found->value = value;
+            shard.lru_.splice(shard.lru_.begin(), shard.lru_, found);
+        }
+        else {
+            insert(fbr, shard, hash, key, value);
+        }
+        return true;
+    }
+
+    size_t size() const {
+        size_t size = 0;
+        for(size_t i = 0; i < NUM_SHARDS; i++) {
+            std::lock_guard<std::mutex> lock_guard(shards_[i].lock_);
+            size += shards_[i].lru_.size();
+        }
+        return size;
+    }
+
+    static int64_t _cmap(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        int64_t capacity = 0;
+
+        return frame.check().
+            static_dispatch(*CMAP).
+            argument_count(0, 1).
+            optional_argument<int64_t>(1, capacity).
+            result<Value>([&]() {
+                if(capacity < 0) {
+                    throw std::runtime_error("cmap needs a non negative capacity");
+                }
+                return CMap::create(fbr.allocator(), capacity);
+            });
+    }
+
+    static int64_t _cmap_get(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<CMapImpl> self;
+        gc::ref<Value> key;
+        gc::ref<Value> default_value;
+
+        auto checked = frame.check().
+            static_dispatch(*CMAP_GET).
+            argument_count(2, 3).
+            argument<CMapImpl>(1, self).
+            argument<Value>(2, key).
+            optional_argument<Value>(3, default_value);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        if (auto found = self->get(fbr, *key)) {
+            return frame.result<Value>(found);
+        }
+        else if(default_value) {
+            return frame.result<Value>(default_value);
+        }
+
+        throw Error::key_not_found(fbr, *key);
+    }
+
+    static int64_t _cmap_put(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<CMapImpl> self;
+        gc::ref<Value> key;
+        gc::ref<Value> value;
+
+        return frame.check().
+            static_dispatch(*CMAP_PUT).
+            argument_count(3).
+            argument<CMapImpl>(1, self).
+            argument<Value>(2, key).
+            argument<Value>(3, value).
+            result<Value>([&]() {
+                self.mutate()->put(fbr, key, value);
+                return value;
+            });
+    }
+
+    static int64_t _cmap_replace(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<CMapImpl> self;
+        gc::ref<Value> key;
+        gc::ref<Value> expected;
+        gc::ref<Value> value;
+
+        return frame.check().
+            static_dispatch(*CMAP_REPLACE).
+            argument_count(4).
+            argument<CMapImpl>(1, self).
+            argument<Value>(2, key).
+            argument<Value>(3, expected).
+            argument<Value>(4, value).
+            result<bool>([&]() {
+                return self.mutate()->replace(fbr, key, expected, value);
+            });
+    }
+
+    static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<CMapImpl> self;
+
+        return frame.check().
+            single_dispatch(*LENGTH, *TYPE).
+            argument_count(1).
+            argument<CMapImpl>(1, self).
+            result<int64_t>([&]() {
+                return self->size();
+            });
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("CMap");
+
+        LENGTH = runtime.builtin("length");
+        runtime.register_method(LENGTH, *TYPE, _length);
+
+        CMAP = runtime.create_builtin<BuiltinStaticDispatch>("cmap", _cmap);
+        CMAP_GET = runtime.create_builtin<BuiltinStaticDispatch>("cmap_get", _cmap_get);
+        CMAP_PUT = runtime.create_builtin<BuiltinStaticDispatch>("cmap_put", _cmap_put);
+        CMAP_REPLACE = runtime.create_builtin<BuiltinStaticDispatch>("cmap_replace", _cmap_replace);
+    }
+};
+
+gc::ref<Value> CMapImpl::CMAP;
+gc::ref<Value> CMapImpl::CMAP_GET;
+gc::ref<Value> CMapImpl::CMAP_PUT;
+gc::ref<Value> CMapImpl::CMAP_REPLACE;
+gc::ref<Value> CMapImpl::LENGTH;
+
+gc::ref<CMap> CMap::create(gc::allocator_t &allocator, size_t capacity)
+{
+    return gc::make_shared_ref<CMapImpl>(allocator, capacity);
+}
+
+void CMap::init(Runtime &runtime) {
+    CMapImpl::init(runtime);
+}
+
+}
@@ -18,10 +18,21 @@
  */
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <elf.h>
 
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <limits>
 #include <string>
 #include <cassert>
+#include <cstring>
+#include <functional>
+#include <fstream>
+#include <ctime>
 
 #include <unordered_set>
 
@@ -30,37 +41,290 @@
 #include "ast.h"
 #include "exec.h"
 #include "align.h"
+#include "builtin.h"
+#include "fiber.h"
+#include "closure.h"
+#include "namespace.h"
 
 namespace park {
 
     extern "C" typedef uint64_t (*entry_thunk_t)(Fiber *fbr, const AST::Apply *apply, MethodImpl code);
     extern "C" typedef uint64_t (*reentry_thunk_t)(Fiber *fbr, void *ip, int64_t ret_code);
 
+    //finds out if the callable of an apply is a builtin node
+    class BuiltinCallable : public AST::Visitor {
+    public:
+        const AST::Builtin *builtin_ = nullptr;
+
+        void visit_builtin(const AST::Builtin &builtin) override {
+            builtin_ = &builtin;
+        }
+    };
+
+    //checks that a function body can be inlined into a caller. it must be small, and must not depend
+    //on having a frame of its own (freevars and self references, recur, defers, nested functions)
+    class InlineCheck : public AST::Visitor {
+        const AST::Function &caller_;
+        const AST::Function &function_;
+        size_t nodes_ = 0;
+        size_t apply_depth_ = 0; //in callable or arguments of an apply, where a return would leave values behind
+
+        void count() {
+            if (++nodes_ > MAX_NODES) {
+                ok_ = false;
+            }
+        }
+
+    public:
+        static const size_t MAX_NODES = 32;
+
+        bool ok_ = true;
+
+        InlineCheck(const AST::Function &caller, const AST::Function &function) : caller_(caller), function_(function) {}
+
+        void visit_define(const AST::Define &define) override { ok_ = false; }
+        void visit_recur(const AST::Recur &recur) override { ok_ = false; }
+        void visit_function(const AST::Function &function) override { ok_ = false; }
+        void visit_module(const AST::Module &module) override { ok_ = false; }
+        void visit_import(const AST::Import &import) override { ok_ = false; }
+        void visit_struct(const AST::Struct &struct_) override { ok_ = false; }
+
+        void visit_builtin(const AST::Builtin &builtin) override { count(); }
+        void visit_literal(const AST::Literal &literal) override { count(); }
+        void visit_global(const AST::Global &global) override { count(); }
+        void visit_local(const AST::Local &local) override { count(); }
+
+        //symbols are looked up through the current frame, which is the caller's once inlined.
+        //only those that resolve the same from both frames (e.g. builtins) are allowed
+        void visit_symbol(const AST::Symbol &symbol) override {
+            count();
+            auto const namei = symbol.namei_;
+            if (function_.local_index(namei) || function_.freevar_index(namei) ||
+                caller_.local_index(namei) || caller_.freevar_index(namei) ||
+                symbol.name_.rfind("__", 0) == 0) {
+                ok_ = false;
+            }
+        }
+
+        void visit_let(const AST::Let &let) override {
+            count();
+            if (!function_.local_index(let.symbol_->namei_)) {
+                ok_ = false;
+            }
+            let.expression_->accept(*this);
+        }
+
+        void visit_branch(const AST::Branch &branch) override {
+            count();
+            branch.condition_->accept(*this);
+            branch.trueBranch_->accept(*this);
+            branch.falseBranch_->accept(*this);
+        }
+
+        void visit_return(const AST::Return &return_) override {
+            count();
+            if (apply_depth_ > 0) {
+                ok_ = false;
+            }
+            return_.expression_->accept(*this);
+        }
+
+        void visit_do(const AST::Do &do_) override {
+            count();
+            for (auto const &statement : *do_.statements_) {
+                statement->accept(*this);
+            }
+        }
+
+        void visit_apply(const AST::Apply &apply) override {
+            count();
+            apply_depth_++;
+            apply.callable_->accept(*this);
+            for (auto const &argument : *apply.arguments_) {
+                argument->accept(*this);
+            }
+            apply_depth_--;
+        }
+
+        static bool inlinable(const AST::Function &caller, const AST::Function &function) {
+            if (function.has_defers()) {
+                return false;
+            }
+            InlineCheck check(caller, function);
+            function.expression_->accept(check);
+            return check.ok_;
+        }
+    };
+
+    //finds the applies of a function whose callee gets inlined, using the callee recorded at the apply.
+    //each inlined callee gets its own frame in extra locals of the function
+    class InlinePlanner : public AST::Visitor {
+        const AST::Function &function_;
+
+    public:
+        static const size_t MAX_ARGUMENTS = 6; //keeps the callable within a disp8 from the stack ptr
+
+        struct inline_t {
+            const AST::Function *callee;
+            size_t base; //local index of the callee frame
+        };
+
+        std::unordered_map<const AST::Apply *, inline_t> inlines_;
+        size_t extra_locals_ = 0;
+
+        explicit InlinePlanner(const AST::Function &function) : function_(function) {}
+
+        void visit_apply(const AST::Apply &apply) override {
+            auto const callee = apply.callee_;
+            if (callee && !apply.callee_varies_ && Closure::vtable_key() != 0 &&
+                callee.get() != &function_ &&
+                apply.argument_count() <= MAX_ARGUMENTS &&
+                apply.argument_count() == callee->parameters_->size() &&
+                InlineCheck::inlinable(function_, *callee)) {
+                auto const base = 1 + function_.parameters_->size() + function_.local_count() + extra_locals_;
+                inlines_[&apply] = {callee.get(), base};
+                extra_locals_ += 1 + callee->parameters_->size() + callee->local_count();
+            }
+            apply.callable_->accept(*this);
+            for (auto const &argument : *apply.arguments_) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit_let(const AST::Let &let) override {
+            let.expression_->accept(*this);
+        }
+
+        void visit_branch(const AST::Branch &branch) override {
+            branch.condition_->accept(*this);
+            branch.trueBranch_->accept(*this);
+            branch.falseBranch_->accept(*this);
+        }
+
+        void visit_return(const AST::Return &return_) override {
+            return_.expression_->accept(*this);
+        }
+
+        void visit_recur(const AST::Recur &recur) override {
+            for (auto const &argument : *recur.arguments_) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit_do(const AST::Do &do_) override {
+            for (auto const &statement : *do_.statements_) {
+                statement->accept(*this);
+            }
+        }
+    };
+
     class X64Backend : public AST::Visitor {
     private:
+        enum class inline_op_t {
+            NONE, ADD, SUBTRACT, EQUALS, LESSTHAN, GREATERTHAN, MODULO
+        };
+
+        //layout of the value_t's on top of the stack, relative to stack.end_ (in r14)
+        static const int8_t LHS = -16;
+        static const int8_t RHS = -8;
+        static const int8_t TOP = -8;
+        static const int8_t VALUE_SHIFT = 3; //log2 of sizeof(value_t)
+        //shift that moves the payload of an int64 value_t into the upper 48 bits
+        static const int8_t INT_SHIFT = 16;
+
         X64Assembler x64;
         int return_label; //return label of the currently compiling function
         int recur_label;  //recur label of the currently compiling function
         void *exit_thunk;
         const AST::Function *current_function_; //current function being compiled
+        //offsets in fiber (which is in rbx)
+        const int32_t stack_begin_offset_;
+        const int32_t stack_end_offset_;
+        const int32_t stack_cap_offset_;
+        const int32_t frame_base_offset_;
+        const int32_t frames_begin_offset_;
+        const int32_t frames_end_offset_;
+        const int32_t frames_cap_offset_;
+        const int32_t checkpoint_offset_;
+        //uncommon paths, emitted after the function body to keep the common path straight
+        std::vector<std::function<void()>> slow_paths_;
+        std::vector<const AST::Apply *> sites_; //applies that got an inline cache
+        //optimizing tier, specializes on the type feedback gathered by the baseline code
+        const bool optimize_;
+        int entry_label_; //start of the function code
+        size_t direct_offset_ = 0; //offset of the entry for direct calls
+        size_t direct_ = 0; //applies that call their callee directly
+        //applies whose callee is inlined, and the callee currently being inlined
+        std::unordered_map<const AST::Apply *, InlinePlanner::inline_t> inlines_;
+        const AST::Function *inline_function_ = nullptr;
+        size_t inline_base_ = 0;
+        int inline_return_label_ = 0;
+        size_t inlined_ = 0;
     public:
 
 
-        explicit X64Backend(void *exit_thunk) : x64(), return_label(0), recur_label(0), exit_thunk(exit_thunk), current_function_(nullptr) {
+        explicit X64Backend(void *exit_thunk, bool optimize = false) : x64(), return_label(0), recur_label(0), exit_thunk(exit_thunk), current_function_(nullptr),
+            stack_begin_offset_(static_cast<int32_t>(Fiber::stack_offset() + Stack::begin_offset())),
+            stack_end_offset_(static_cast<int32_t>(Fiber::stack_offset() + Stack::end_offset())),
+            stack_cap_offset_(static_cast<int32_t>(Fiber::stack_offset() + Stack::cap_offset())),
+            frame_base_offset_(static_cast<int32_t>(Fiber::frame_base_offset())),
+            frames_begin_offset_(static_cast<int32_t>(Fiber::frame_stack_offset() + FrameStack::begin_offset())),
+            frames_end_offset_(static_cast<int32_t>(Fiber::frame_stack_offset() + FrameStack::end_offset())),
+            frames_cap_offset_(static_cast<int32_t>(Fiber::frame_stack_offset() + FrameStack::cap_offset())),
+            checkpoint_offset_(static_cast<int32_t>(Fiber::checkpoint_offset())), optimize_(optimize), entry_label_(0) {
         }
 
         X64Backend() : X64Backend(nullptr) {
         }
 
+        //while in jitted code the stack ptr is kept in r14 and the address of the current frame in r15.
+        //the fiber is only updated before calls that can observe the stack, and both are reloaded
+        //after such a call, as it might have changed the stack or the frame, or reallocated the stack.
+        void sync_stack() {
+            x64.mov_rbx_disp_r14(stack_end_offset_);
+        }
+
+        void load_stack() {
+            static_assert(sizeof(value_t) == 1 << VALUE_SHIFT);
+            x64.mov_r14_rbx_disp(stack_end_offset_);
+            x64.mov_rcx_rbx_disp(frame_base_offset_);
+            x64.shl_rcx_imm8(VALUE_SHIFT);
+            x64.mov_r15_rbx_disp(stack_begin_offset_);
+            x64.add_r15_rcx();
+        }
+
         void emit_call(const AST::Node &node, const void *exec_fn) {
+            sync_stack();
             x64.mov_rdi_rbx(); //1st arg Fiber
             x64.mov_rsi_imm(reinterpret_cast<int64_t>(&node)); //2nd arg AST node
             x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_fn));
             x64.call_rax(); //call exec_fn
+            load_stack();
+        }
+
+        void slow_path(std::function<void()> emit) {
+            slow_paths_.push_back(std::move(emit));
+        }
+
+        //pushes a value that is known at compile time, exec_fn is called if the stack needs to grow
+        void emit_push_value(const AST::Node &node, const value_t &value, const void *exec_fn) {
+            auto slow_label = x64.new_label();
+            auto done_label = x64.new_label();
+            x64.cmp_r14_rbx_disp(stack_cap_offset_);
+            x64.jae(slow_label);
+            x64.mov_rax_imm(static_cast<int64_t>(value.bits));
+            x64.mov_r14_disp_rax(0);
+            x64.add_r14_imm8(sizeof(value_t));
+            x64.bind(done_label);
+            slow_path([=, &node]() {
+                x64.bind(slow_label);
+                emit_call(node, exec_fn);
+                x64.jmp_rel(done_label);
+            });
         }
 
         void visit_literal(const AST::Literal &literal) override {
-            emit_call(literal, (void *) exec_literal);
+            emit_push_value(literal, literal.value_, (void *) exec_literal);
         }
 
         void visit_symbol(const AST::Symbol &symbol) override {
@@ -68,16 +332,55 @@ namespace park {
         }
 
         void visit_builtin(const AST::Builtin &builtin) override {
-            emit_call(builtin, (void *) exec_builtin);
+            emit_push_value(builtin, builtin.value_, (void *) exec_builtin);
+        }
+
+        //offset of a local from the frame in r15, locals of an inlined function are in its own frame after the locals
+        int32_t local_offset(size_t local_index) const {
+            return static_cast<int32_t>((inline_base_ + local_index) * sizeof(value_t));
         }
 
         void visit_let(const AST::Let &let) override {
+            assert(current_function_ != nullptr);
             let.expression_->accept(*this);
-            emit_call(let, (void *) exec_let);
+            auto const &function = inline_function_ != nullptr ? *inline_function_ : *current_function_;
+            if (auto local_index = function.local_index(let.symbol_->namei_)) {
+                //copy top of stack into local
+                auto const offset = local_offset(*local_index);
+                x64.mov_rax_r14_disp(TOP);
+                x64.mov_r15_disp_rax(offset);
+            }
+            else {
+                emit_call(let, (void *) exec_let); //will report the missing symbol
+            }
         }
 
         void visit_local(const AST::Local &local) override {
-            emit_call(local, (void *) exec_local);
+            auto retry_label = x64.new_label();
+            auto slow_label = x64.new_label();
+            auto done_label = x64.new_label();
+            auto const offset = local_offset(local.index_);
+            x64.bind(retry_label);
+            x64.cmp_r14_rbx_disp(stack_cap_offset_);
+            x64.jae(slow_label);
+            x64.mov_rax_r15_disp(offset);
+            x64.mov_r14_disp_rax(0);
+            x64.add_r14_imm8(sizeof(value_t));
+            x64.bind(done_label);
+            if (inline_function_ != nullptr) {
+                //exec_local would use the frame of the caller
+                slow_path([=, &local]() {
+                    x64.bind(slow_label);
+                    emit_call(local, (void *) exec_reserve);
+                    x64.jmp_rel(retry_label);
+                });
+                return;
+            }
+            slow_path([=, &local]() {
+                x64.bind(slow_label);
+                emit_call(local, (void *) exec_local);
+                x64.jmp_rel(done_label);
+            });
         }
 
         void visit_global(const AST::Global &global) override {
@@ -91,7 +394,7 @@ namespace park {
                 //ignore output of expression, but not last, which is the value of the
                 //do expression
                 if (it != last) {
-                    emit_call(_do, (void *) exec_pop);
+                    x64.sub_r14_imm8(sizeof(value_t));
                 }
             }
         }
@@ -99,8 +402,22 @@ namespace park {
         void visit_branch(const AST::Branch &branch) override {
             auto false_branch_label = x64.new_label();
             auto end_label = x64.new_label();
+            auto slow_label = x64.new_label();
+            auto test_label = x64.new_label();
             branch.condition_->accept(*this);
-            emit_call(branch, (void *) exec_bool);
+            //pop condition, inline if it is a bool, otherwise let exec_bool convert it
+            static_assert(value_t::BOOL_TRUE == value_t::BOOL_FALSE + 1);
+            x64.mov_rax_r14_disp(TOP);
+            x64.sub_rax_imm8(value_t::BOOL_FALSE);
+            x64.cmp_rax_1();
+            x64.ja(slow_label);
+            x64.sub_r14_imm8(sizeof(value_t));
+            x64.bind(test_label);
+            slow_path([=, &branch]() {
+                x64.bind(slow_label);
+                emit_call(branch, (void *) exec_bool);
+                x64.jmp_rel(test_label);
+            });
             //rax is now 0 or 1
             x64.test_rax_rax();
             x64.jz(false_branch_label);
@@ -114,6 +431,10 @@ namespace park {
         void visit_return(const AST::Return &return_) override {
             assert(return_label != 0);
             return_.expression_->accept(*this);
+            if (inline_function_ != nullptr) {
+                x64.jmp_rel(inline_return_label_);
+                return;
+            }
             x64.jmp_rel(return_label);
             //defers are handled just after return_label
         }
@@ -139,34 +460,523 @@ namespace park {
             x64.jmp_rel(recur_label);
         }
 
+        //counts calls of baseline code. once hot, the compiler is asked for optimized code,
+        //which we jump to with the original return address and arguments.
+        //this also forwards callers that still hold on to the baseline code
+        void emit_tier_up_check(const AST::Function &function) {
+            auto const disp = reinterpret_cast<const char *>(&function.tier_up_at_) -
+                              reinterpret_cast<const char *>(&function.calls_);
+            static_assert(sizeof(function.calls_) == 8);
+            assert(disp == 8);
+
+            auto tier_up_label = x64.new_label();
+            auto baseline_label = x64.new_label();
+
+            x64.mov_rax_imm(reinterpret_cast<int64_t>(&function.calls_));
+            x64.inc_rax_ptr(); //not locked, an approximate count will do
+            x64.mov_rcx_rax_ptr();
+            x64.cmp_rcx_rax_disp(static_cast<int8_t>(disp));
+            x64.jae(tier_up_label);
+            x64.bind(baseline_label);
+
+            slow_path([=, &function]() {
+                x64.bind(tier_up_label);
+                x64.push_rdi();
+                x64.push_rsi();
+                x64.push_rsi(); //align stack before call
+                x64.mov_rdx_imm(reinterpret_cast<int64_t>(&function));
+                x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_tier_up));
+                x64.call_rax();
+                x64.pop_rsi();
+                x64.pop_rsi();
+                x64.pop_rdi();
+                x64.test_rax_rax();
+                x64.jz(baseline_label); //not (yet) optimized
+                x64.jmp_rax();
+            });
+        }
+
+        //optimized code that was replaced (deoptimized or optimized again) can still be called
+        //through inline caches of callers, these go to the current code of the function instead
+        void emit_stale_check(const AST::Function &function) {
+            auto stale_label = x64.new_label();
+
+            x64.mov_rax_mem(reinterpret_cast<uintptr_t>(&function.code_));
+            x64.lea_rcx_rip(entry_label_);
+            x64.cmp_rax_rcx();
+            x64.jnz(stale_label);
+
+            slow_path([=]() {
+                x64.bind(stale_label);
+                x64.jmp_rax();
+            });
+        }
+
         void visit_function(const AST::Function &function) override {
             emit_call(function, (void *) exec_function);
         }
 
+        //returns the int64 operation that can be inlined for this apply, if any
+        inline_op_t inline_op(const AST::Apply &apply, const AST::Builtin *&builtin) {
+            if(apply.argument_count() != 2) {
+                return inline_op_t::NONE;
+            }
+            BuiltinCallable callable;
+            apply.callable_->accept(callable);
+            builtin = callable.builtin_;
+            if(builtin == nullptr || !builtin->value_.is_ref()) {
+                return inline_op_t::NONE;
+            }
+            auto const value = builtin->value_.ref();
+            if(value == Builtin::ADD.get()) {
+                return inline_op_t::ADD;
+            }
+            else if(value == Builtin::SUBTRACT.get()) {
+                return inline_op_t::SUBTRACT;
+            }
+            else if(value == Builtin::EQUALS.get()) {
+                return inline_op_t::EQUALS;
+            }
+            else if(value == Builtin::LESSTHAN.get()) {
+                return inline_op_t::LESSTHAN;
+            }
+            else if(value == Builtin::GREATERTHAN.get()) {
+                return inline_op_t::GREATERTHAN;
+            }
+            else if(value == Builtin::MODULO.get()) {
+                return inline_op_t::MODULO;
+            }
+            return inline_op_t::NONE;
+        }
+
+        //int64 op on the 2 values on top of the stack, replacing them by the result.
+        //jumps to slow_label (with the stack untouched) if both are not int64 or the result does not fit.
+        //the payloads are shifted into the upper bits, so that the cpu flags overflow of the 48 bit result
+        void emit_inline_int64(inline_op_t op, int slow_label) {
+            x64.mov_rax_r14_disp(LHS);
+            x64.mov_rdx_r14_disp(RHS);
+            x64.mov_r11_imm(static_cast<int64_t>(value_t::INT_TAG));
+            x64.mov_rcx_rax();
+            x64.and_rcx_rdx();
+            x64.cmp_rcx_r11();
+            x64.jb(slow_label);
+
+            switch(op) {
+                case inline_op_t::ADD:
+                case inline_op_t::SUBTRACT: {
+                    x64.shl_rax_imm8(INT_SHIFT);
+                    x64.shl_rdx_imm8(INT_SHIFT);
+                    if(op == inline_op_t::ADD) {
+                        x64.add_rax_rdx();
+                    }
+                    else {
+                        x64.sub_rax_rdx();
+                    }
+                    x64.jo(slow_label);
+                    x64.shr_rax_imm8(INT_SHIFT);
+                    x64.or_rax_r11();
+                    x64.mov_r14_disp_rax(LHS);
+                    break;
+                }
+                case inline_op_t::EQUALS:
+                case inline_op_t::LESSTHAN:
+                case inline_op_t::GREATERTHAN: {
+                    x64.shl_rax_imm8(INT_SHIFT);
+                    x64.shl_rdx_imm8(INT_SHIFT);
+                    x64.cmp_rax_rdx();
+                    if(op == inline_op_t::EQUALS) {
+                        x64.sete_al();
+                    }
+                    else if(op == inline_op_t::LESSTHAN) {
+                        x64.setl_al();
+                    }
+                    else {
+                        x64.setg_al();
+                    }
+                    x64.movzx_eax_al();
+                    x64.add_rax_imm8(value_t::BOOL_FALSE);
+                    x64.mov_r14_disp_rax(LHS);
+                    break;
+                }
+                case inline_op_t::MODULO: {
+                    //division by 0 is left to the generic method, 48 bit operands cannot overflow idiv
+                    x64.mov_rsi_rdx();
+                    x64.shl_rsi_imm8(INT_SHIFT);
+                    x64.sar_rsi_imm8(INT_SHIFT);
+                    x64.test_rsi_rsi();
+                    x64.jz(slow_label);
+                    x64.shl_rax_imm8(INT_SHIFT);
+                    x64.sar_rax_imm8(INT_SHIFT);
+                    x64.cqo();
+                    x64.idiv_rsi();
+                    x64.shl_rdx_imm8(INT_SHIFT);
+                    x64.shr_rdx_imm8(INT_SHIFT);
+                    x64.or_rdx_r11();
+                    x64.mov_r14_disp_rdx(LHS);
+                    break;
+                }
+                case inline_op_t::NONE: {
+                    assert(false);
+                }
+            }
+
+            x64.sub_r14_imm8(sizeof(value_t)); //pop rhs, lhs now holds result
+        }
+
+        //compares the value_t in rax with the range of refs, below (jb) when it is a ref. clobbers rcx and rdx
+        void emit_ref_test() {
+            x64.mov_rcx_rax();
+            x64.sub_rcx_imm32(value_t::MAX_CONSTANT + 1);
+            x64.mov_rdx_imm(static_cast<int64_t>(value_t::DOUBLE_OFFSET - (value_t::MAX_CONSTANT + 1)));
+            x64.cmp_rcx_rdx();
+        }
+
+        //replaces the value_t in rax, which is not a ref, by its kind. clobbers rdx
+        void emit_kind(int done_label) {
+            auto int_label = x64.new_label();
+            auto double_label = x64.new_label();
+            auto constant_label = x64.new_label();
+            x64.mov_rdx_imm(static_cast<int64_t>(value_t::INT_TAG));
+            x64.cmp_rax_rdx();
+            x64.jae(int_label);
+            x64.mov_rdx_imm(static_cast<int64_t>(value_t::DOUBLE_OFFSET));
+            x64.cmp_rax_rdx();
+            x64.jae(double_label);
+            x64.test_rax_rax();
+            x64.jnz(constant_label);
+            x64.mov_rax_imm(static_cast<int64_t>(value_t::kind_t::UVALUE));
+            x64.jmp_rel(done_label);
+            x64.bind(constant_label);
+            x64.mov_rax_imm(static_cast<int64_t>(value_t::kind_t::BVALUE));
+            x64.jmp_rel(done_label);
+            x64.bind(int_label);
+            x64.mov_rax_imm(static_cast<int64_t>(value_t::kind_t::IVALUE));
+            x64.jmp_rel(done_label);
+            x64.bind(double_label);
+            x64.mov_rax_imm(static_cast<int64_t>(value_t::kind_t::DVALUE));
+            x64.jmp_rel(done_label);
+        }
+
         //The first six integer or pointer arguments are passed in registers RDI, RSI, RDX, RCX, R8, and R9
         void visit_apply(const AST::Apply &apply) override {
             assert(exit_thunk != nullptr);
             assert(current_function_ != nullptr ? return_label != 0 : true);
 
-            auto apply_label = x64.new_label();
-            auto check_return_label = x64.new_label();
-            auto end_label = x64.new_label();
-            auto exit_label = x64.new_label();
+            if (inline_function_ == nullptr) {
+                auto found = inlines_.find(&apply);
+                if (found != inlines_.end()) {
+                    emit_inlined_apply(apply, found->second);
+                    return;
+                }
+            }
+
+            const AST::Builtin *builtin = nullptr;
+            auto op = inline_op(apply, builtin);
+            if(op == inline_op_t::NONE) {
+                //function application
+                //evaluate function expression, which evaluates to a callable
+                apply.callable_->accept(*this);
+                //and its arguments
+                for (auto const &argument : *apply.arguments_) {
+                    argument->accept(*this);
+                }
+                if (auto callee = direct_callee(apply)) {
+                    emit_direct_apply(apply, *callee);
+                }
+                else {
+                    emit_apply(apply);
+                }
+            }
+            else {
+                //arithmetic on int64's is done inline, without pushing the builtin
+                auto slow_label = x64.new_label();
+                auto done_label = x64.new_label();
+                for (auto const &argument : *apply.arguments_) {
+                    argument->accept(*this);
+                }
+                emit_inline_int64(op, slow_label);
+                x64.bind(done_label);
+                slow_path([=, &apply]() {
+                    //guard failed, push the builtin below its arguments and do a generic apply
+                    x64.bind(slow_label);
+                    sync_stack();
+                    x64.mov_rdi_rbx();
+                    x64.mov_rsi_imm(reinterpret_cast<int64_t>(builtin));
+                    x64.mov_rdx_imm(apply.argument_count());
+                    x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_builtin_under));
+                    x64.call_rax();
+                    load_stack();
+                    emit_apply(apply);
+                    x64.jmp_rel(done_label);
+                });
+            }
+        }
+
+        //runs the body of the callee in place of the call, as long as the callable is a closure of it
+        void emit_inlined_apply(const AST::Apply &apply, const InlinePlanner::inline_t &inline_) {
+            auto const &callee = *inline_.callee;
+            auto const argument_count = apply.argument_count();
+            auto const callable_disp = -static_cast<int8_t>((argument_count + 1) * sizeof(value_t));
+            auto call_label = x64.new_label();
+            auto result_label = x64.new_label();
+            auto done_label = x64.new_label();
 
-            //function application
-            //evaluate function expression, which evaluates to a callable
             apply.callable_->accept(*this);
-            //and its arguments
             for (auto const &argument : *apply.arguments_) {
                 argument->accept(*this);
             }
 
-            //call the target method impl first
+            emit_closure_guard(apply, callee, call_label);
+
+            //move callable and arguments into the frame of the callee, and clear its locals
+            auto const saved_base = inline_base_;
+            inline_base_ = inline_.base;
+            for (size_t i = 0; i <= argument_count; i++) {
+                auto const disp = static_cast<int8_t>(callable_disp + i * sizeof(value_t));
+                x64.mov_rax_r14_disp(disp);
+                x64.mov_r15_disp_rax(local_offset(i));
+            }
+            x64.sub_r14_imm8(static_cast<int8_t>((argument_count + 1) * sizeof(value_t)));
+            if (callee.local_count() > 0) {
+                x64.mov_rax_imm(0);
+                for (size_t i = 1 + argument_count; i <= argument_count + callee.local_count(); i++) {
+                    x64.mov_r15_disp_rax(local_offset(i));
+                }
+            }
+
+            auto const saved_return_label = inline_return_label_;
+            inline_function_ = &callee;
+            inline_return_label_ = x64.new_label();
+            callee.expression_->accept(*this);
+            x64.bind(inline_return_label_);
+            inline_function_ = nullptr;
+            inline_return_label_ = saved_return_label;
+            inline_base_ = saved_base;
+            inlined_++;
+
+            //an error result is thrown on, like the epilog does for a call
+            x64.mov_rax_r14_disp(TOP);
+            emit_ref_test();
+            x64.jb(result_label);
+            x64.bind(done_label);
+
+            slow_path([=, &apply]() {
+                x64.bind(result_label);
+                emit_call(apply, (void *) exec_return_throws);
+                x64.test_rax_rax();
+                x64.jnz(return_label);
+                x64.jmp_rel(done_label);
+            });
+
+            slow_path([=, &apply]() {
+                //not a closure of the callee, deoptimize like a failed cache guard and do the call
+                x64.bind(call_label);
+                emit_deopt();
+                emit_apply(apply);
+                x64.jmp_rel(done_label);
+            });
+        }
+
+        //jumps to fail_label unless the callable of the apply is a closure of callee
+        void emit_closure_guard(const AST::Apply &apply, const AST::Function &callee, int fail_label) {
+            auto const callable_disp = -static_cast<int8_t>((apply.argument_count() + 1) * sizeof(value_t));
+
+            x64.mov_rax_r14_disp(callable_disp);
+            emit_ref_test();
+            x64.jae(fail_label);
+            x64.mov_rcx_rax_ptr();
+            x64.mov_rdx_imm(static_cast<int64_t>(Closure::vtable_key()));
+            x64.cmp_rcx_rdx();
+            x64.jnz(fail_label);
+            x64.mov_rcx_rax_disp(static_cast<int32_t>(Closure::function_offset()));
+            x64.mov_rdx_imm(reinterpret_cast<int64_t>(&callee));
+            x64.cmp_rcx_rdx();
+            x64.jnz(fail_label);
+        }
+
+        //the function a closure call site can call directly, it only ever called closures of this function
+        //with the right number of arguments
+        const AST::Function *direct_callee(const AST::Apply &apply) {
+            if (!optimize_ || current_function_ == nullptr || !apply.callee_ ||
+                apply.callee_varies_.load(std::memory_order_relaxed) || Closure::vtable_key() == 0 ||
+                apply.argument_count() > InlinePlanner::MAX_ARGUMENTS) {
+                return nullptr;
+            }
+            auto const &callee = *apply.callee_;
+            if (callee.parameters_->size() != apply.argument_count() || callee.direct_code_ == nullptr) {
+                return nullptr;
+            }
+            return &callee;
+        }
+
+        //calls the direct entry of callee, which skips the dispatch check and pushes its frame inline
+        void emit_direct_apply(const AST::Apply &apply, const AST::Function &callee) {
+            auto call_label = x64.new_label();
+            auto done_label = x64.new_label();
+
+            emit_closure_guard(apply, callee, call_label);
+            emit_apply(apply, &callee);
+            x64.bind(done_label);
+            direct_++;
+
+            slow_path([=, &apply]() {
+                //not a closure of the callee, deoptimize like a failed cache guard and do the call
+                x64.bind(call_label);
+                emit_deopt();
+                emit_apply(apply);
+                x64.jmp_rel(done_label);
+            });
+        }
+
+        //loads the key of an argument into r9 or r10, see AST::InlineCache::argument_key
+        void emit_argument_key(const AST::Apply &apply, size_t argument_index, bool r9) {
+            auto const argument_count = apply.argument_count();
+            if (argument_index > argument_count) {
+                r9 ? x64.xor_r9d_r9d() : x64.xor_r10d_r10d();
+                return;
+            }
+            auto const disp = -static_cast<int32_t>((argument_count + 1 - argument_index) * sizeof(value_t));
+            auto kind_label = x64.new_label();
+            auto done_label = x64.new_label();
+            x64.mov_rax_r14_disp(disp);
+            emit_ref_test();
+            x64.jae(kind_label);
+            r9 ? x64.mov_r9_rax_ptr() : x64.mov_r10_rax_ptr();
+            x64.bind(done_label);
+
+            slow_path([=]() {
+                auto key_label = x64.new_label();
+                x64.bind(kind_label);
+                emit_kind(key_label);
+                x64.bind(key_label);
+                r9 ? x64.mov_r9_rax() : x64.mov_r10_rax();
+                x64.jmp_rel(done_label);
+            });
+        }
+
+        //leaves the target to call in rax. On a miss this is exec_dispatch, which adds the
+        //missing entry, after which the apply probes again. Once the site is megamorphic the
+        //single target_ of the apply is used
+        void emit_cache_lookup(const AST::Apply &apply) {
+            auto const &cache = apply.cache_;
+            auto const disp = [&](const void *field) {
+                return static_cast<int32_t>(reinterpret_cast<const char *>(field) - reinterpret_cast<const char *>(&cache));
+            };
+            auto call_label = x64.new_label();
+            auto megamorphic_label = x64.new_label();
+
+            x64.mov_r8_r14_disp(-static_cast<int32_t>((apply.argument_count() + 1) * sizeof(value_t)));
+            emit_argument_key(apply, 1, true);
+            emit_argument_key(apply, 2, false);
+
+            x64.mov_rsi_imm(reinterpret_cast<int64_t>(&cache));
+            x64.cmp_byte_rsi_disp_0(disp(&cache.megamorphic_));
+            x64.jnz(megamorphic_label);
+            for (auto const &entry : cache.entries_) {
+                auto next_label = x64.new_label();
+                x64.cmp_r8_rsi_disp(disp(&entry.callable));
+                x64.jnz(next_label);
+                x64.cmp_r9_rsi_disp(disp(&entry.lhs));
+                x64.jnz(next_label);
+                x64.cmp_r10_rsi_disp(disp(&entry.rhs));
+                x64.jnz(next_label);
+                x64.mov_rax_rsi_disp(disp(&entry.target));
+                x64.inc_rsi_disp(disp(&cache.hits_));
+                x64.jmp_rel(call_label);
+                x64.bind(next_label);
+            }
+            x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_dispatch));
+            x64.bind(call_label);
+
+            slow_path([=, &apply]() {
+                x64.bind(megamorphic_label);
+                x64.mov_rax_mem(reinterpret_cast<uintptr_t>(&apply.target_));
+                x64.jmp_rel(call_label);
+            });
+        }
+
+        void emit_deopt() {
+            x64.mov_rdi_rbx();
+            x64.mov_rsi_imm(reinterpret_cast<int64_t>(current_function_));
+            x64.lea_rdx_rip(entry_label_);
+            x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_deopt));
+            x64.call_rax();
+        }
+
+        void emit_inline_cache_probe(const AST::Apply &apply) {
+            sites_.push_back(&apply);
+
+            auto const &cache = apply.cache_;
+            if (!optimize_ || current_function_ == nullptr ||
+                cache.megamorphic_ || cache.size_ != 1) {
+                emit_cache_lookup(apply);
+                return;
+            }
+
+            //the site only ever saw one kind of callable and arguments, guard on exactly those keys.
+            //the target is still loaded from the cache entry, so that a redispatch for the same keys
+            //(e.g. after the target was freed) is picked up
+            auto const &entry = cache.entries_[0];
+            auto const argument_count = apply.argument_count();
+            auto call_label = x64.new_label();
+            auto deopt_label = x64.new_label();
+
+            //a builtin callable is a constant, no need to check it
+            BuiltinCallable builtin;
+            apply.callable_->accept(builtin);
+            if (builtin.builtin_ == nullptr ||
+                AST::InlineCache::callable_key(builtin.builtin_->value_) != entry.callable) {
+                x64.mov_r8_r14_disp(-static_cast<int32_t>((argument_count + 1) * sizeof(value_t)));
+                x64.mov_rax_imm(static_cast<int64_t>(entry.callable.load()));
+                x64.cmp_r8_rax();
+                x64.jnz(deopt_label);
+            }
+            if (argument_count >= 1) {
+                emit_argument_key(apply, 1, true);
+                x64.mov_rax_imm(static_cast<int64_t>(entry.lhs.load()));
+                x64.cmp_r9_rax();
+                x64.jnz(deopt_label);
+            }
+            if (argument_count >= 2) {
+                emit_argument_key(apply, 2, false);
+                x64.mov_rax_imm(static_cast<int64_t>(entry.rhs.load()));
+                x64.cmp_r10_rax();
+                x64.jnz(deopt_label);
+            }
+            x64.mov_rax_mem(reinterpret_cast<uintptr_t>(&entry.target));
+            x64.bind(call_label);
+
+            //guard failed, the feedback was wrong. fall back to baseline code for later calls,
+            //this call continues with a normal lookup
+            slow_path([=, &apply]() {
+                x64.bind(deopt_label);
+                emit_deopt();
+                emit_cache_lookup(apply);
+                x64.jmp_rel(call_label);
+            });
+        }
+
+        //calls target of apply, callable and arguments are on the stack.
+        //with a callee the direct entry of its code is called instead of the target
+        void emit_apply(const AST::Apply &apply, const AST::Function *callee = nullptr) {
+            auto apply_label = x64.new_label();
+            auto check_return_label = x64.new_label();
+            auto end_label = x64.new_label();
+            auto exit_label = x64.new_label();
+
+            //call the target method impl first, the target is found in the inline cache of the apply
+            sync_stack();
             x64.bind(apply_label);
+            if (callee != nullptr) {
+                x64.mov_rax_mem(reinterpret_cast<uintptr_t>(&callee->direct_code_));
+            }
+            else {
+                emit_inline_cache_probe(apply);
+            }
             x64.mov_rdi_rbx(); //fibre 1st arg
             x64.mov_rsi_imm(reinterpret_cast<int64_t>(&apply));
-            x64.mov_rax_mem(reinterpret_cast<uintptr_t >(&apply.target_)); 
             x64.call_rax();
+            load_stack(); //leaves rax alone
 
             //actual target returned int in rax, normally 0, in which case
             //we continue. note that this jump is really predictable, because
@@ -182,6 +992,7 @@ namespace park {
             x64.mov_rax_imm(reinterpret_cast<int64_t>(exit_thunk));
             x64.call_rax(); //exit_thunk will save this code address so that later code can resume hereafter:
             x64.bind(check_return_label);
+            load_stack(); //we might have been resumed on a fresh native stack
             //we continue here after normal call, or when we are resumed from exit
             //rax = 0, normal return
             //rax = 1, backout of current function (but not current module)
@@ -201,6 +1012,143 @@ namespace park {
             x64.bind(end_label);
         }
 
+        //pushes the frame like exec_function_prolog does, but without checking the callable.
+        //the caller synced the stack and passes the fiber and apply as for a normal call.
+        //when there is no room for the frame or the locals the normal entry is taken instead
+        void emit_direct_prolog(const AST::Function &function) {
+            static_assert(sizeof(frame_t) == 48);
+            auto const argument_count = static_cast<int32_t>(function.parameters_->size());
+            auto const local_count = static_cast<int32_t>(function.local_count());
+
+            if (!optimize_) {
+                //count the call, the normal entry asks for optimized code
+                auto const disp = reinterpret_cast<const char *>(&function.tier_up_at_) -
+                                  reinterpret_cast<const char *>(&function.calls_);
+                x64.mov_rax_imm(reinterpret_cast<int64_t>(&function.calls_));
+                x64.inc_rax_ptr();
+                x64.mov_rcx_rax_ptr();
+                x64.cmp_rcx_rax_disp(static_cast<int8_t>(disp));
+                x64.jae(entry_label_);
+            }
+
+            x64.mov_rax_rbx_disp(frames_end_offset_);
+            x64.cmp_rax_rbx_disp(frames_cap_offset_);
+            x64.jae(entry_label_);
+            x64.lea_rcx_r14_disp(local_count * static_cast<int32_t>(sizeof(value_t)));
+            x64.cmp_rcx_rbx_disp(stack_cap_offset_);
+            x64.ja(entry_label_);
+
+            //base of the frame is the index of the callable in the value stack
+            x64.mov_rcx_r14();
+            x64.sub_rcx_rbx_disp(stack_begin_offset_);
+            x64.shr_rcx_imm8(VALUE_SHIFT);
+            x64.sub_rcx_imm32(argument_count + 1);
+
+            x64.mov_rax_disp_rsi(offsetof(frame_t, apply));
+            x64.mov_rax_disp_rcx(offsetof(frame_t, base));
+            x64.mov_rbx_disp_rcx(frame_base_offset_);
+            x64.mov_rax_disp_imm32(offsetof(frame_t, argument_count), argument_count);
+            x64.mov_rax_disp_imm32(offsetof(frame_t, local_count), local_count);
+            x64.mov_rax_disp_imm32(offsetof(frame_t, defers), 0);
+            x64.mov_rcx_rsp_ptr();
+            x64.mov_rax_disp_rcx(offsetof(frame_t, link));
+            x64.add_rax_imm8(sizeof(frame_t));
+            x64.mov_rbx_disp_rax(frames_end_offset_);
+
+            //uninitialized locals
+            if (local_count > 0) {
+                x64.mov_rax_imm(0);
+                for (int32_t i = 0; i < local_count; i++) {
+                    x64.mov_r14_disp_rax(0);
+                    x64.add_r14_imm8(sizeof(value_t));
+                }
+                sync_stack();
+            }
+
+            x64.add_rsp_8(); //pop return address so stack stays flat
+        }
+
+        //every 256 entries the fiber checks in with the gc, see exec_function_checkpoint
+        void emit_checkpoint(const AST::Function &function) {
+            auto checkpoint_label = x64.new_label();
+            auto done_label = x64.new_label();
+
+            x64.mov_eax_rbx_disp(checkpoint_offset_);
+            x64.inc_eax();
+            x64.test_al_al();
+            x64.jz(checkpoint_label);
+            x64.mov_rbx_disp_eax(checkpoint_offset_);
+            x64.bind(done_label);
+
+            slow_path([=, &function]() {
+                x64.bind(checkpoint_label);
+                emit_call(function, (void *) exec_function_checkpoint); //counts itself
+                x64.jmp_rel(done_label);
+            });
+        }
+
+        //runs the defers, pops the frame like FiberImpl::pop_frame and moves the result in place of the callable.
+        //the link is pushed so that a ret returns to the caller
+        void emit_epilog(const AST::Function &function) {
+            auto const frame_disp = -static_cast<int8_t>(sizeof(frame_t));
+            auto defers_label = x64.new_label();
+            auto epilog_label = x64.new_label();
+            auto base_label = x64.new_label();
+            auto throws_label = x64.new_label();
+
+            x64.mov_rax_rbx_disp(frames_end_offset_);
+            x64.cmp_rax_disp_imm8(static_cast<int8_t>(frame_disp + offsetof(frame_t, defers)), 0);
+            x64.jnz(defers_label);
+
+            x64.bind(epilog_label);
+            x64.mov_rax_rbx_disp(frames_end_offset_);
+            x64.sub_rax_imm8(sizeof(frame_t));
+            x64.mov_rbx_disp_rax(frames_end_offset_);
+
+            x64.mov_rcx_rax_disp(offsetof(frame_t, base));
+            x64.shl_rcx_imm8(VALUE_SHIFT);
+            x64.add_rcx_rbx_disp(stack_begin_offset_);
+            x64.mov_rdx_r14_disp(TOP);
+            x64.mov_rcx_disp_rdx(0);
+            x64.lea_r14_rcx_disp(sizeof(value_t));
+            sync_stack();
+
+            x64.mov_rsi_rax_disp(offsetof(frame_t, apply));
+            x64.push_rax_disp(offsetof(frame_t, link));
+
+            //back to the frame of the caller
+            x64.xor_ecx_ecx();
+            x64.cmp_rax_rbx_disp(frames_begin_offset_);
+            x64.jz(base_label);
+            x64.mov_rcx_rax_disp(static_cast<int8_t>(frame_disp + offsetof(frame_t, base)));
+            x64.bind(base_label);
+            x64.mov_rbx_disp_rcx(frame_base_offset_);
+
+            x64.mov_rax_r14_disp(TOP);
+            emit_ref_test();
+            x64.jb(throws_label);
+            x64.mov_rax_imm(0);
+            x64.ret();
+
+            slow_path([=, &function]() {
+                x64.bind(defers_label);
+                function.exec_defers().accept(*this);
+                emit_call(function, (void *) exec_pop);
+                x64.jmp_rel(epilog_label);
+            });
+
+            slow_path([=]() {
+                //the result might be an error, apply in rsi
+                x64.bind(throws_label);
+                x64.mov_rdi_rbx();
+                x64.sub_rsp_8(); //align
+                x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_return_throws));
+                x64.call_rax();
+                x64.add_rsp_8();
+                x64.ret();
+            });
+        }
+
         //The first six integer or pointer arguments are passed in registers RDI, RSI, RDX, RCX, R8, and R9
         void compile(const AST::Function &function) {
             assert(return_label == 0);
@@ -209,7 +1157,7 @@ namespace park {
             current_function_ = &function;
 
             auto exit_label = x64.new_label();
-            auto epilog_label = x64.new_label();
+            auto frame_label = x64.new_label();
             return_label = x64.new_label();
             recur_label = x64.new_label();
 
@@ -217,6 +1165,14 @@ namespace park {
             //rdi is pointing to fiber (as is rbx)
             //rsi is pointing to apply
             //on entry, so they are already correct for calling exec_function_prolog
+            entry_label_ = x64.new_label();
+            x64.bind(entry_label_);
+            if (!optimize_) {
+                emit_tier_up_check(function);
+            }
+            else {
+                emit_stale_check(function);
+            }
             x64.mov_rdx_imm(reinterpret_cast<int64_t>(&function)); //&function as 3d arg
             x64.mov_rcx_rsp_ptr(); //pass return address as 4th arg
             x64.sub_rsp_8(); //align stack before call
@@ -226,37 +1182,46 @@ namespace park {
             x64.test_rax_rax(); //test for bad dispatch
             x64.js(exit_label); //rax < 0, bad dispatch detected, return immediately
             x64.add_rsp_8(); //pop return address so stack stays flat
+            x64.jmp_rel(frame_label);
+
+            //callers that already checked the callable come in here
+            direct_offset_ = x64.bind(x64.new_label());
+            emit_direct_prolog(function);
+            x64.bind(frame_label);
+
+            if (optimize_) {
+                InlinePlanner planner(function);
+                function.expression_->accept(planner);
+                inlines_ = std::move(planner.inlines_);
+                if (planner.extra_locals_ > 0) {
+                    x64.mov_rdi_rbx();
+                    x64.mov_rsi_imm(reinterpret_cast<int64_t>(&function));
+                    x64.mov_rdx_imm(static_cast<int64_t>(planner.extra_locals_));
+                    x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_inline_locals));
+                    x64.call_rax();
+                }
+            }
 
             x64.bind(recur_label); //if we recur, function prolog is skipped and we return here
+            load_stack();
 
-            emit_call(function, (void *) exec_function_checkpoint); //checks for gc etc
+            emit_checkpoint(function); //checks for gc etc
 
             function.expression_->accept(*this); //the body of the function
 
             x64.bind(return_label);
 
-            emit_call(function, (void *) exec_check_defers);
-            x64.test_rax_rax(); //test if defers processing needed
-            x64.jz(epilog_label);
-
-            //defers processing
-            function.exec_defers().accept(*this);
-            emit_call(function, (void *) exec_pop);
-
-            x64.bind(epilog_label);            
-            //call function epilog
-            x64.sub_rsp_8(); //make room to return link directly in stack
-            x64.mov_rdx_rsp(); //3d arg, pass stackpointer so we can return link direcly on stack
-            x64.mov_rdi_rbx(); //1st arg, pass current fiber 
-            x64.mov_rsi_imm(reinterpret_cast<int64_t>(&function)); //2nd arg, ptr to function
-            x64.mov_rax_imm(reinterpret_cast<int64_t>(exec_function_epilog));
-            x64.sub_rsp_8(); //align
-            x64.call_rax();
-            x64.add_rsp_8(); //align
-            //link was put on stack by exec_function_epilog, retval in rax also by exec_function_epilog
+            emit_epilog(function); //leaves the link on the stack and the return code in rax
             x64.bind(exit_label);
             x64.ret();
 
+            //slow paths can add more slow paths
+            for (size_t i = 0; i < slow_paths_.size(); i++) {
+                auto emit = slow_paths_[i];
+                emit();
+            }
+            slow_paths_.clear();
+
             return_label = 0;
             recur_label = 0;
             current_function_ = nullptr;
@@ -266,6 +1231,22 @@ namespace park {
             return x64.make();
         }
 
+        const std::vector<const AST::Apply *> &sites() const {
+            return sites_;
+        }
+
+        size_t inlined() const {
+            return inlined_;
+        }
+
+        size_t direct_offset() const {
+            return direct_offset_;
+        }
+
+        size_t direct() const {
+            return direct_;
+        }
+
         void dump() {
             return x64.dump();
         }
@@ -273,45 +1254,342 @@ namespace park {
     };
 
 
+    //machine code lives in chunks that are mapped twice, once writable for copying code in
+    //and once executable for running it, so no page is ever writable and executable at the same time
+    class CodeHeap {
+        static constexpr size_t CHUNK_SIZE = 1024 * 1024;
+
+        //freed function code keeps a small stub at its entry, see free
+        static const size_t TOMBSTONE_SIZE = 16;
+
+        struct chunk_t {
+            size_t size;
+            uint8_t *rw;
+            uint8_t *rx;
+        };
+
+        std::vector<chunk_t> chunks_;
+        std::map<uint8_t *, size_t> free_; //free blocks by executable address
+
+        size_t reserved_ = 0;
+        size_t used_ = 0;
+        size_t freed_ = 0;
+        bool reuse_ = true; //whether freed code may be overwritten by new code
+
+        const chunk_t &chunk(const uint8_t *rx) const {
+            for (auto const &chunk : chunks_) {
+                if (rx >= chunk.rx && rx < chunk.rx + chunk.size) {
+                    return chunk;
+                }
+            }
+            throw std::runtime_error("address not in code heap");
+        }
+
+        uint8_t *writable(uint8_t *rx) const {
+            auto const &c = chunk(rx);
+            return c.rw + (rx - c.rx);
+        }
+
+        void map_chunk(size_t size) {
+            auto fd = memfd_create("park-code", MFD_CLOEXEC);
+            if (fd == -1) {
+                throw std::runtime_error("could not create code memory");
+            }
+            if (ftruncate(fd, size)) {
+                close(fd);
+                throw std::runtime_error("could not allocate code memory");
+            }
+            auto rw = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            auto rx = mmap(nullptr, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+            close(fd);
+            if (rw == MAP_FAILED || rx == MAP_FAILED) {
+                throw std::runtime_error("could not map code memory");
+            }
+            chunks_.push_back({size, static_cast<uint8_t *>(rw), static_cast<uint8_t *>(rx)});
+            reserved_ += size;
+            insert_free(static_cast<uint8_t *>(rx), size);
+        }
+
+        void insert_free(uint8_t *rx, size_t size) {
+            auto const &c = chunk(rx);
+            //coalesce with neighbours, but never across chunks, their mappings are unrelated
+            auto next = free_.lower_bound(rx);
+            if (next != free_.end() && rx + size == next->first && &chunk(next->first) == &c) {
+                size += next->second;
+                next = free_.erase(next);
+            }
+            if (next != free_.begin()) {
+                auto prev = std::prev(next);
+                if (prev->first + prev->second == rx && &chunk(prev->first) == &c) {
+                    prev->second += size;
+                    return;
+                }
+            }
+            free_[rx] = size;
+        }
+
+    public:
+        ~CodeHeap() {
+            for (auto const &chunk : chunks_) {
+                munmap(chunk.rw, chunk.size);
+                munmap(chunk.rx, chunk.size);
+            }
+        }
+
+        //copies code into the heap, returns executable address
+        uint8_t *allocate(const std::vector<uint8_t> &code) {
+            auto const size = align<16>(code.size());
+            auto fits = [&]() {
+                return std::find_if(free_.begin(), free_.end(), [&](auto const &block) {
+                    return block.second >= size;
+                });
+            };
+            auto block = fits();
+            if (block == free_.end()) {
+                map_chunk(std::max(CHUNK_SIZE, align<4096>(size)));
+                block = fits();
+            }
+            auto const rx = block->first;
+            auto const remaining = block->second - size;
+            free_.erase(block);
+            if (remaining > 0) {
+                free_[rx + size] = remaining;
+            }
+            std::copy(code.begin(), code.end(), writable(rx));
+            used_ += size;
+            return rx;
+        }
+
+        //frees code of a collected function. inline caches elsewhere may still hold its entry point,
+        //keyed by closures that are now dead too. a new value could be allocated at such an address,
+        //so the entry keeps a stub that redispatches, which makes the cache replace the stale target
+        void free(uint8_t *rx, size_t size, const std::vector<uint8_t> &tombstone) {
+            size = align<16>(size);
+            assert(tombstone.size() <= TOMBSTONE_SIZE && size >= TOMBSTONE_SIZE);
+            auto const rw = writable(rx);
+            std::fill(rw, rw + size, 0xCC); //int3
+            std::copy(tombstone.begin(), tombstone.end(), rw);
+            used_ -= size;
+            freed_ += size - TOMBSTONE_SIZE;
+            if (reuse_ && size > TOMBSTONE_SIZE) {
+                insert_free(rx + TOMBSTONE_SIZE, size - TOMBSTONE_SIZE);
+            }
+        }
+
+        //freed code stays where it is, for tools that can not tell apart code loaded at the same address
+        void keep_freed() {
+            reuse_ = false;
+        }
+
+        size_t reserved() const {
+            return reserved_;
+        }
+
+        size_t used() const {
+            return used_;
+        }
+
+        size_t freed() const {
+            return freed_;
+        }
+    };
+
+    //names machine code for perf, which otherwise only sees anonymous memory. Enabled by the PARK_PERF
+    //environment variable: 'map' writes /tmp/perf-<pid>.map, 'jitdump' writes /tmp/jit-<pid>.dump
+    //for perf inject --jit (record with -k mono), both can be given separated by a comma.
+    //a perf map has no notion of time, so while it is written freed code is not reused, otherwise entries
+    //would overlap. jitdump does not need that, a load record at a reused address has a newer timestamp
+    class PerfMap {
+        static const uint32_t JITDUMP_MAGIC = 0x4A695444;
+        static const uint32_t JITDUMP_VERSION = 1;
+        static const uint32_t JIT_CODE_LOAD = 0;
+
+        struct jitdump_header_t {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t total_size;
+            uint32_t elf_mach;
+            uint32_t pad1;
+            uint32_t pid;
+            uint64_t timestamp;
+            uint64_t flags;
+        };
+
+        struct jitdump_code_load_t {
+            uint32_t id;
+            uint32_t total_size;
+            uint64_t timestamp;
+            uint32_t pid;
+            uint32_t tid;
+            uint64_t vma;
+            uint64_t code_addr;
+            uint64_t code_size;
+            uint64_t code_index;
+            //followed by the 0 terminated name and the code
+        };
+
+        std::ofstream map_;
+        std::ofstream dump_;
+        void *marker_ = nullptr; //perf record finds the dump by this mapping of it
+        size_t marker_size_ = 0;
+        uint64_t code_index_ = 0;
+
+        static uint64_t timestamp() {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+        }
+
+        void open_dump(const std::string &path) {
+            dump_.open(path, std::ios::binary | std::ios::trunc);
+            if (!dump_) {
+                return;
+            }
+            jitdump_header_t header{JITDUMP_MAGIC, JITDUMP_VERSION, sizeof(jitdump_header_t), EM_X86_64, 0,
+                                    static_cast<uint32_t>(getpid()), timestamp(), 0};
+            dump_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            dump_.flush();
+
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if (fd != -1) {
+                marker_size_ = sysconf(_SC_PAGESIZE);
+                marker_ = mmap(nullptr, marker_size_, PROT_READ | PROT_EXEC, MAP_PRIVATE, fd, 0);
+                if (marker_ == MAP_FAILED) {
+                    marker_ = nullptr;
+                }
+                ::close(fd);
+            }
+        }
+
+    public:
+        PerfMap() {
+            auto const mode = getenv("PARK_PERF");
+            if (mode == nullptr) {
+                return;
+            }
+            auto const modes = std::string(mode);
+            auto const pid = std::to_string(getpid());
+            if (modes.find("map") != std::string::npos) {
+                map_.open("/tmp/perf-" + pid + ".map", std::ios::trunc);
+            }
+            if (modes.find("jitdump") != std::string::npos) {
+                open_dump("/tmp/jit-" + pid + ".dump");
+            }
+        }
+
+        ~PerfMap() {
+            if (marker_ != nullptr) {
+                munmap(marker_, marker_size_);
+            }
+        }
+
+        bool enabled() const {
+            return map_.is_open() || dump_.is_open();
+        }
+
+        bool maps() const {
+            return map_.is_open();
+        }
+
+        //call with lock
+        void code_load(const uint8_t *code, size_t size, const std::string &name) {
+            if (map_.is_open()) {
+                map_ << std::hex << reinterpret_cast<uintptr_t>(code) << " " << size << std::dec << " " << name << std::endl;
+            }
+            if (dump_.is_open()) {
+                jitdump_code_load_t record{JIT_CODE_LOAD,
+                                           static_cast<uint32_t>(sizeof(jitdump_code_load_t) + name.size() + 1 + size),
+                                           timestamp(),
+                                           static_cast<uint32_t>(getpid()),
+                                           static_cast<uint32_t>(syscall(SYS_gettid)),
+                                           reinterpret_cast<uint64_t>(code),
+                                           reinterpret_cast<uint64_t>(code),
+                                           size,
+                                           code_index_++};
+                dump_.write(reinterpret_cast<const char *>(&record), sizeof(record));
+                dump_.write(name.c_str(), name.size() + 1);
+                dump_.write(reinterpret_cast<const char *>(code), size);
+                dump_.flush();
+            }
+        }
+
+        //e.g. park:main.fib:12, optimized code gets a * suffix
+        static std::string name(const AST::Function &function, bool optimized) {
+            std::string module = "?";
+            if (function.module_ && function.module_->ns_) {
+                module = function.module_->ns_->name();
+            }
+            return "park:" + module + "." + function.name_ + ":" + std::to_string(function.line_) + (optimized ? "*" : "");
+        }
+    };
+
     class Compiler::Impl {
         std::mutex lock_;
 
-        //executable memory for jit compiler
-        size_t code_mem_size_;
-        uint8_t *code_mem_;
-        uint8_t *code_mem_ptr_;
+        Compiler &compiler_;
+
+        CodeHeap code_heap_;
+
+        PerfMap perf_map_;
 
         std::unordered_set<const AST::Function *> compiling_;
         std::condition_variable compiling_cond_;
 
         void *exit_thunk_;
 
-        //need lock
-        uint8_t *make_executable(const std::vector<uint8_t> &code) {
-            //copy machine code into executable memory
-            //TODO handle out of memory (e.g. allocate new chunks)
-            assert((code_mem_size_ - ((code_mem_ptr_ - code_mem_))) >= code.size());
-
-            std::copy(code.begin(),
-                      code.end(),
-                      code_mem_ptr_);
-
-            auto const executable_code = code_mem_ptr_;
-
-            code_mem_ptr_ += align<8>(code.size());
-
-            return executable_code;
+        std::vector<uint8_t> tombstone_;
+
+        //a function is optimized at most this many times, after that it stays on baseline code
+        static const int MAX_TIER_UPS = 4;
+
+        struct compiled_t {
+            uint8_t *code; //baseline code
+            size_t size;
+            size_t direct; //offset of the entry for direct calls
+            uint8_t *optimized = nullptr;
+            size_t optimized_size = 0;
+            //optimized code that was deoptimized, stale callers might still run it
+            std::vector<std::pair<uint8_t *, size_t>> retired;
+            size_t inlined = 0; //applies inlined in the optimized code
+            size_t direct_calls = 0; //applies in the optimized code that call their callee directly
+            bool tiering = false;
+            int tier_ups = 0;
+            int64_t deopts = 0;
+        };
+
+        std::unordered_map<const AST::Function *, compiled_t> compiled_;
+
+        //applies that got an inline cache in compiled code, for stats. an apply is released by its own
+        //finalizer, as the finalizer of its function may run after the apply was already swept
+        std::unordered_set<const AST::Apply *> sites_;
+
+        //call with lock
+        void add_sites(const std::vector<const AST::Apply *> &sites) {
+            for (auto apply : sites) {
+                if (sites_.insert(apply).second) {
+                    const_cast<AST::Apply *>(apply)->compiler_ = &compiler_;
+                }
+            }
         }
 
-        std::vector<uint8_t> compile(const AST::Function &function) {
+        std::vector<uint8_t> compile(const AST::Function &function, std::vector<const AST::Apply *> &sites, size_t &direct,
+                                     size_t *inlined = nullptr, size_t *direct_calls = nullptr) {
             //std::cerr << "compile func" << std::endl;
             assert(exit_thunk_);
 
-            X64Backend c(exit_thunk_);
+            X64Backend c(exit_thunk_, inlined != nullptr);
 
             c.compile(function);
 
             auto result = c.make();
+            sites = c.sites();
+            direct = c.direct_offset();
+            if (inlined != nullptr) {
+                *inlined = c.inlined();
+            }
+            if (direct_calls != nullptr) {
+                *direct_calls = c.direct();
+            }
 
             //std::cerr << "compiled func:" << function.name_ << std::endl;
             //c.dump();
@@ -319,46 +1597,51 @@ namespace park {
             return result;
         }
 
+        //call with lock
+        template<typename F>
+        uint8_t *allocate(const std::vector<uint8_t> &code, F &&name) {
+            auto const result = code_heap_.allocate(code);
+            if (perf_map_.enabled()) {
+                perf_map_.code_load(result, code.size(), name());
+            }
+            return result;
+        }
+
     public:
         entry_thunk_t entry_thunk_;
         reentry_thunk_t reentry_thunk_;
 
-        explicit Impl() : code_mem_size_(1024 * 4096) {
-
-            if (posix_memalign(reinterpret_cast<void **>(&code_mem_), 4096, code_mem_size_)) {
-                throw std::runtime_error("could not allocate code memory");
-            }
-
-            if (mprotect(code_mem_, code_mem_size_, PROT_READ | PROT_WRITE | PROT_EXEC)) {
-                throw std::runtime_error("could not make code memory executable");
+        explicit Impl(Compiler &compiler) : compiler_(compiler) {
+            if (perf_map_.maps()) {
+                code_heap_.keep_freed();
             }
 
-            code_mem_ptr_ = reinterpret_cast<uint8_t *>(code_mem_);
-
             {
                 X64Assembler x64;
                 x64.entry_thunk();
-                entry_thunk_ = reinterpret_cast<entry_thunk_t>(make_executable(x64.make()));
+                entry_thunk_ = reinterpret_cast<entry_thunk_t>(allocate(x64.make(), []() { return "park:entry_thunk"; }));
             }
 
             {
                 X64Assembler x64;
                 x64.reentry_thunk();
-                reentry_thunk_ = reinterpret_cast<reentry_thunk_t>(make_executable(x64.make()));
+                reentry_thunk_ = reinterpret_cast<reentry_thunk_t>(allocate(x64.make(), []() { return "park:reentry_thunk"; }));
             }
 
             {
                 X64Assembler x64;
                 x64.exit_thunk(reinterpret_cast<int64_t>(&exec_exit));
-                exit_thunk_ = reinterpret_cast<void *>(make_executable(x64.make()));
+                exit_thunk_ = reinterpret_cast<void *>(allocate(x64.make(), []() { return "park:exit_thunk"; }));
             }
 
-        }
-
-        ~Impl() {
-            if (code_mem_ != nullptr) {
-                free(code_mem_);
+            {
+                MethodImpl redispatch = exec_dispatch;
+                X64Assembler x64;
+                x64.mov_rax_imm(reinterpret_cast<int64_t>(redispatch));
+                x64.jmp_rax();
+                tombstone_ = x64.make();
             }
+
         }
 
         //call without lock
@@ -375,10 +1658,17 @@ namespace park {
                     //compile it myself
                     compiling_.insert(&function);
                     unique_lock.unlock(); //todo use unlock guard
-                    auto compiled_code = compile(function);
+                    std::vector<const AST::Apply *> sites;
+                    size_t direct = 0;
+                    auto compiled_code = compile(function, sites, direct);
                     unique_lock.lock();
-                    const_cast<AST::Function &>(function).code_ =
-                            reinterpret_cast<MethodImpl>(make_executable(compiled_code));
+                    auto const code = allocate(compiled_code, [&]() { return PerfMap::name(function, false); });
+                    compiled_[&function] = {code, compiled_code.size(), direct};
+                    add_sites(sites);
+                    auto &mutable_function = const_cast<AST::Function &>(function);
+                    mutable_function.compiler_ = &compiler_;
+                    mutable_function.direct_code_ = code + direct;
+                    mutable_function.code_ = reinterpret_cast<MethodImpl>(code);
                     compiling_.erase(&function);
                     //notify others who might be waiting for this compile
                     compiling_cond_.notify_all();
@@ -387,10 +1677,126 @@ namespace park {
             return function.code_;
         }
 
+        //called by the gc when it finalizes a function, its apply nodes may already be swept
+        void release(const AST::Function &function) {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto found = compiled_.find(&function);
+            if (found != compiled_.end()) {
+                auto &compiled = found->second;
+                code_heap_.free(compiled.code, compiled.size, tombstone_);
+                if (compiled.optimized != nullptr) {
+                    code_heap_.free(compiled.optimized, compiled.optimized_size, tombstone_);
+                }
+                for (auto const &[code, size] : compiled.retired) {
+                    code_heap_.free(code, size, tombstone_);
+                }
+                compiled_.erase(found);
+            }
+        }
+
+        void release(const AST::Apply &apply) {
+            std::lock_guard<std::mutex> guard(lock_);
+            sites_.erase(&apply);
+        }
+
+        //call without lock
+        MethodImpl tier_up(const AST::Apply &apply, const AST::Function &function) {
+            std::unique_lock<std::mutex> unique_lock(lock_);
+            auto found = compiled_.find(&function);
+            assert(found != compiled_.end());
+            auto &mutable_function = const_cast<AST::Function &>(function);
+            if (found->second.optimized == nullptr) {
+                if (found->second.tiering) {
+                    return nullptr; //somebody else is optimizing it, keep running baseline meanwhile
+                }
+                if (found->second.tier_ups == MAX_TIER_UPS) {
+                    mutable_function.tier_up_at_ = std::numeric_limits<int64_t>::max();
+                    return nullptr;
+                }
+                found->second.tiering = true;
+                unique_lock.unlock();
+                std::vector<const AST::Apply *> sites;
+                size_t direct = 0;
+                size_t inlined = 0;
+                size_t direct_calls = 0;
+                auto compiled_code = compile(function, sites, direct, &inlined, &direct_calls);
+                unique_lock.lock();
+                found = compiled_.find(&function);
+                found->second.tiering = false;
+                found->second.inlined = inlined;
+                found->second.direct_calls = direct_calls;
+                found->second.tier_ups++;
+                found->second.optimized = allocate(compiled_code, [&]() { return PerfMap::name(function, true); });
+                found->second.optimized_size = compiled_code.size();
+                add_sites(sites);
+                mutable_function.direct_code_ = found->second.optimized + direct;
+                mutable_function.code_ = reinterpret_cast<MethodImpl>(found->second.optimized);
+            }
+            //the caller might have come in through its inline cache, point that at the optimized code
+            auto const baseline = reinterpret_cast<MethodImpl>(found->second.code);
+            auto const optimized = reinterpret_cast<MethodImpl>(found->second.optimized);
+            auto &mutable_apply = const_cast<AST::Apply &>(apply);
+            mutable_apply.cache_.retarget(baseline, optimized);
+            if (apply.target_ == baseline) {
+                mutable_apply.set_target(optimized);
+            }
+            return optimized;
+        }
+
+        void deoptimize(const AST::Function &function, void *code) {
+            std::lock_guard<std::mutex> guard(lock_);
+            auto found = compiled_.find(&function);
+            assert(found != compiled_.end());
+            auto &compiled = found->second;
+            compiled.deopts++;
+            if (compiled.optimized == code) {
+                auto &mutable_function = const_cast<AST::Function &>(function);
+                mutable_function.direct_code_ = compiled.code + compiled.direct;
+                mutable_function.code_ = reinterpret_cast<MethodImpl>(compiled.code);
+                compiled.retired.emplace_back(compiled.optimized, compiled.optimized_size);
+                compiled.optimized = nullptr;
+                //gather new feedback for a while before trying again
+                mutable_function.tier_up_at_ = function.calls_ + (Compiler::TIER_UP_CALLS << compiled.tier_ups);
+            }
+        }
+
+        Compiler::stats_t stats() {
+            std::lock_guard<std::mutex> guard(lock_);
+            Compiler::stats_t stats;
+            for (auto apply : sites_) {
+                auto const &cache = apply->cache_;
+                stats.sites++;
+                if (cache.megamorphic_) {
+                    stats.megamorphic++;
+                }
+                else if (cache.size_ > 1) {
+                    stats.polymorphic++;
+                }
+                else if (cache.size_ == 1) {
+                    stats.monomorphic++;
+                }
+                stats.hits += cache.hits_.load(std::memory_order_relaxed);
+                stats.misses += cache.misses_.load(std::memory_order_relaxed);
+            }
+            for (auto const &[function, compiled] : compiled_) {
+                if (compiled.optimized != nullptr) {
+                    stats.optimized++;
+                    stats.inlined += compiled.inlined;
+                    stats.direct += compiled.direct_calls;
+                }
+                stats.deopts += compiled.deopts;
+            }
+            stats.functions = compiled_.size();
+            stats.code_reserved = code_heap_.reserved();
+            stats.code_used = code_heap_.used();
+            stats.code_freed = code_heap_.freed();
+            return stats;
+        }
+
     };
 
     Compiler::Compiler()
-        : impl_(std::make_unique<Compiler::Impl>()) {
+        : impl_(std::make_unique<Compiler::Impl>(*this)) {
 
         {
         }
@@ -406,6 +1812,26 @@ namespace park {
         return impl_->code(function);
     }
 
+    void Compiler::release(const AST::Function &function)
+    {
+        impl_->release(function);
+    }
+
+    void Compiler::release(const AST::Apply &apply)
+    {
+        impl_->release(apply);
+    }
+
+    MethodImpl Compiler::tier_up(const AST::Apply &apply, const AST::Function &function)
+    {
+        return impl_->tier_up(apply, function);
+    }
+
+    void Compiler::deoptimize(const AST::Function &function, void *code)
+    {
+        impl_->deoptimize(function, code);
+    }
+
     uint64_t Compiler::enter(Fiber *fbr, const AST::Apply *apply, MethodImpl code)
     {
        return impl_->entry_thunk_(fbr, apply, code);
@@ -416,4 +1842,9 @@ namespace park {
        return impl_->reentry_thunk_(fbr, ip, ret_code);
     }
 
-}
\ No newline at end of file
+    Compiler::stats_t Compiler::stats()
+    {
+       return impl_->stats();
+    }
+
+}
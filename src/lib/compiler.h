@@ -32,8 +32,42 @@ namespace park {
 
         MethodImpl code(const AST::Function &function);
 
+        //frees the machine code of a function that is being collected
+        void release(const AST::Function &function);
+
+        //forgets an apply with an inline cache in compiled code that is being collected
+        void release(const AST::Apply &apply);
+
+        //number of calls after which a function is recompiled using the feedback in its inline caches
+        static const int64_t TIER_UP_CALLS = 1000;
+
+        //returns optimized code for a hot function, or nullptr to keep running baseline code
+        MethodImpl tier_up(const AST::Apply &apply, const AST::Function &function);
+
+        //a guard in the given optimized code failed, go back to baseline code
+        void deoptimize(const AST::Function &function, void *code);
+
         uint64_t enter(Fiber *fbr, const AST::Apply *apply, MethodImpl code);
         uint64_t reenter(Fiber *fbr, void *ip, int64_t ret_code);
+
+        struct stats_t {
+            int64_t sites = 0; //apply sites in compiled code
+            int64_t monomorphic = 0;
+            int64_t polymorphic = 0;
+            int64_t megamorphic = 0;
+            int64_t hits = 0; //inline cache hits and misses over all sites
+            int64_t misses = 0;
+            int64_t functions = 0; //functions with machine code
+            int64_t optimized = 0; //functions currently running optimized code
+            int64_t deopts = 0; //failed guards in optimized code
+            int64_t inlined = 0; //applies inlined in optimized code
+            int64_t direct = 0; //applies calling their callee directly in optimized code
+            int64_t code_reserved = 0; //bytes mapped for machine code
+            int64_t code_used = 0;
+            int64_t code_freed = 0; //bytes given back by collected functions
+        };
+
+        stats_t stats();
          
 
     private:
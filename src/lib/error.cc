@@ -77,4 +77,12 @@ const Error Error::key_not_found(Fiber &fbr, const Value &key) {
     });
 }
 
+const Error Error::transient_not_editable(Fiber &fbr, const Value &transient) {
+    return Error::format([&](std::ostream &os) {
+        os << "transient ";
+        transient.get_type().repr(fbr, os);
+        os << " used after persistent or outside of its fiber";
+    });
+}
+
 }
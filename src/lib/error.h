@@ -48,6 +48,8 @@ namespace park {
         function_not_defined_for_argument_type(Fiber &fbr, size_t line, const Value &callable, const Value &self);
 
         static const Error key_not_found(Fiber &fbr, const Value &key);
+
+        static const Error transient_not_editable(Fiber &fbr, const Value &transient);
     };
 
 }
@@ -32,6 +32,14 @@ namespace park {
 
     extern void exec_builtin(Fiber &fbr, const AST::Builtin &builtin);
 
+    extern void exec_builtin_under(Fiber &fbr, const AST::Builtin &builtin, int64_t argument_count);
+
+    extern void exec_reserve(Fiber &fbr, const AST::Node &node);
+
+    extern void exec_inline_locals(Fiber &fbr, const AST::Function &function, int64_t count);
+
+    extern int64_t exec_return_throws(Fiber &fbr, const AST::Apply &apply);
+
     extern void exec_let(Fiber &fbr, const AST::Let &let);
 
     extern void exec_local(Fiber &fbr, const AST::Local &local);
@@ -53,12 +61,15 @@ namespace park {
 
     extern void exec_function_checkpoint(Fiber &fbr, const AST::Function &function);
 
-    extern int64_t
-    exec_function_epilog(Fiber &fbr, const AST::Function &function, void **link);
-
     extern void *exec_exit(Fiber &fbr, const AST::Apply &apply, void *link);
 
+    extern MethodImpl exec_tier_up(Fiber &fbr, const AST::Apply &apply, const AST::Function &function);
+
+    extern void exec_deopt(Fiber &fbr, const AST::Function &function, void *code);
+
     } // extern "C"
 
+    int64_t exec_dispatch(Fiber &fbr, const AST::Apply &apply);
+
 }
 #endif
\ No newline at end of file
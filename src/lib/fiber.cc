@@ -27,6 +27,10 @@
 #include "list.h"
 #include "error2.h"
 #include "compiler.h"
+#include "map.h"
+#include "keyword.h"
+#include "string.h"
+#include "profiler.h"
 
 #include <unordered_set>
 
@@ -36,6 +40,9 @@ namespace park {
     gc::ref<Value> EXIT;
     gc::ref<Value> SPAWN;
     gc::ref<Value> DEFER;
+    gc::ref<Value> JIT_STATS;
+    gc::ref<Value> PROFILE_START;
+    gc::ref<Value> PROFILE_STOP;
 
     class FiberImpl : public SharedValueImpl<Fiber, FiberImpl> {
 
@@ -47,20 +54,8 @@ namespace park {
 
         const bool is_main; //can live in runtime?
 
-        struct frame_stack_t {
-            const AST::Apply *apply; //callsite
-            size_t base; //position of current callable in value stack
-            size_t argument_count; //argument count to current callable
-            size_t local_count;
-            gc::ref<List> defers; //list of defers we need to apply on function exit
-        };
-
-        std::vector<frame_stack_t> frame_stack;
-        std::vector<void *> link_stack; //return address from current function, TODO put back in framestack
         std::unique_ptr<gc::private_heap_t> private_heap_;
 
-        int checkpoint_ = 0;
-
         FiberImpl(Runtime &runtime, bool is_main) :
                 runtime(runtime),
                 is_main(is_main),
@@ -86,11 +81,10 @@ namespace park {
 
         void dump_stack() {
             stack.each([&](auto &item) {
-                std::cerr << "kind: " << (int) item.kind << " val: "; 
-                switch(item.kind) {
+                std::cerr << "kind: " << (int) item.kind() << " val: "; 
+                switch(item.kind()) {
                     case value_t::kind_t::RVALUE: {
-                        assert(item.rvalue);
-                        item.rvalue->repr(*this, std::cerr);
+                        item.ref()->repr(*this, std::cerr);
                     }
                     default: {
                         
@@ -146,6 +140,61 @@ namespace park {
                });
         }
 
+        static int64_t _jit_stats(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*JIT_STATS).
+                argument_count(0).
+                result<Value>([&]() {
+                    auto const stats = from_fbr(fbr).runtime.compiler().stats();
+                    auto m = Map::create(fbr);
+                    for (auto const &[name, value] : {std::make_pair("sites", stats.sites),
+                                                      std::make_pair("monomorphic", stats.monomorphic),
+                                                      std::make_pair("polymorphic", stats.polymorphic),
+                                                      std::make_pair("megamorphic", stats.megamorphic),
+                                                      std::make_pair("hits", stats.hits),
+                                                      std::make_pair("misses", stats.misses),
+                                                      std::make_pair("functions", stats.functions),
+                                                      std::make_pair("optimized", stats.optimized),
+                                                      std::make_pair("deopts", stats.deopts),
+                                                      std::make_pair("inlined", stats.inlined),
+                                                      std::make_pair("direct", stats.direct),
+                                                      std::make_pair("code_reserved", stats.code_reserved),
+                                                      std::make_pair("code_used", stats.code_used),
+                                                      std::make_pair("code_freed", stats.code_freed)}) {
+                        m = m->assoc(fbr, Keyword::create(fbr, name), Integer::create(fbr, value));
+                    }
+                    return m;
+               });
+        }
+
+        static int64_t _profile_start(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*PROFILE_START).
+                argument_count(0).
+                result<Value>([&]() {
+                    from_fbr(fbr).runtime.profiler().start();
+                    return Boolean::create(true);
+                });
+        }
+
+        //stops sampling and returns the samples as collapsed stacks, the input format of flamegraph.pl
+        static int64_t _profile_stop(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*PROFILE_STOP).
+                argument_count(0).
+                result<Value>([&]() {
+                    auto &profiler = from_fbr(fbr).runtime.profiler();
+                    profiler.stop();
+                    return String::create(fbr, profiler.folded());
+                });
+        }
+
         void __defer(gc::ref<Closure> closure)
         {
             frame_stack.back().defers = defers()->conj(*this, closure);
@@ -202,10 +251,12 @@ namespace park {
         {
             allocator_ = &allocator;
             std::swap(private_heap_, allocator_->private_heap_);
+            Profiler::set_current(this);
         }
 
         void detach(gc::allocator_t &allocator) override
         {
+            Profiler::set_current(nullptr);
             std::swap(allocator_->private_heap_, private_heap_);
             allocator_ = nullptr;
         } 
@@ -284,6 +335,27 @@ namespace park {
             stack.push_back(builtin.value_);
         }
 
+        void exec_reserve() {
+            stack.ensure_capacity(1);
+        }
+
+        //room for the frames of functions that the jit inlined into the current function
+        void exec_inline_locals(int64_t count) {
+            stack.init_locals(count);
+            frame_stack.back().local_count += count;
+        }
+
+        //a function returned its result on top of the stack, an error result is thrown on if the apply throws
+        int64_t exec_return_throws(const AST::Apply &apply) {
+            auto const &result = stack.back();
+            return Error2::is_error(*result.ref()) && apply.throws_;
+        }
+
+        //callable was not pushed because the apply was inlined, put it back below its arguments
+        void exec_builtin_under(const AST::Builtin &builtin, int64_t argument_count) {
+            stack.insert_back(argument_count, builtin.value_);
+        }
+
         void exec_global(const AST::Global &global) {
             if (!global.initialized_.load()) {
                 const_cast<AST::Global &>(global).initialize();
@@ -312,9 +384,21 @@ namespace park {
         }
 
         int64_t exec_dispatch(const AST::Apply &apply) {
-            auto const callable = value::cast<gc::ref<Value>>(
-                *this, stack.callable(stack.base(apply.argument_count())));
-            const_cast<AST::Apply &>(apply).set_target(callable->dispatch(*this, apply));
+            auto const argument_count = apply.argument_count();
+            auto const base = stack.base(argument_count);
+            auto const callable = value::cast<gc::ref<Value>>(*this, stack.callable(base));
+            auto const target = callable->dispatch(*this, apply);
+            if (Closure::isinstance(*callable)) {
+                auto const &closure = static_cast<const Closure &>(*callable);
+                const_cast<AST::Apply &>(apply).record_callee(allocator(), closure.function());
+            }
+            auto &cache = const_cast<AST::Apply &>(apply).cache_;
+            if (!cache.update(AST::InlineCache::callable_key(stack.callable(base)),
+                              AST::InlineCache::argument_key(argument_count >= 1 ? &stack.argument(base, 1) : nullptr),
+                              AST::InlineCache::argument_key(argument_count >= 2 ? &stack.argument(base, 2) : nullptr),
+                              target)) {
+                const_cast<AST::Apply &>(apply).set_target(target);
+            }
             return -1;
         }
 
@@ -356,13 +440,13 @@ namespace park {
 
             auto &callable = stack.callable(base);
 
-            assert(callable.kind == value_t::kind_t::RVALUE);
+            assert(callable.is_ref());
 
-            if (!Closure::isinstance(*callable.rvalue)) {
+            if (!Closure::isinstance(*callable.ref())) {
                 return exec_dispatch(apply); //bad dispatch, might be some other type of callable
             }
 
-            auto const &closure = static_cast<const Closure &>(*callable.rvalue);
+            auto const &closure = static_cast<const Closure &>(*callable.ref());
             if (&closure.function() != &function) {
                 return exec_dispatch(apply); //its a closure, but for a different function, bad dispatch
             }
@@ -372,8 +456,9 @@ namespace park {
                                           argument_count,
                                           local_count,
                                           nullptr,
+                                          link,
                                   });
-            link_stack.push_back(link);
+            frame_base_ = base;
 
             //push uninitialized locals
             stack.init_locals(local_count);
@@ -383,8 +468,6 @@ namespace park {
 
         void exec_function_checkpoint(const AST::Function &function);
 
-        int64_t exec_function_epilog(const AST::Function &function, void **link);
-
         void *exec_exit(const AST::Apply &apply, void *link);
 
         template<typename F>
@@ -392,9 +475,9 @@ namespace park {
             auto const frame = frame_stack.back();
             stack.pop_frame(frame.base);
             f(); //f pushes result
-            auto link = link_stack.back();
+            auto link = frame.link;
             frame_stack.pop_back();
-            link_stack.pop_back();
+            frame_base_ = frame_stack.empty() ? 0 : frame_stack.back().base;
             return link;
         }
 
@@ -417,9 +500,9 @@ namespace park {
         assert(!frame_stack.empty());
         auto const &current_frame = frame_stack.back();
         auto &callable = stack.callable(current_frame.base);
-        assert(callable.kind == value_t::kind_t::RVALUE);
-        assert(Closure::isinstance(*callable.rvalue));
-        return static_cast<const Closure &>(*callable.rvalue);
+        assert(callable.is_ref());
+        assert(Closure::isinstance(*callable.ref()));
+        return static_cast<const Closure &>(*callable.ref());
     }
 
 
@@ -437,8 +520,8 @@ namespace park {
             if(exit_code == 1) {
                 std::cerr << "exit with unhandled error!: ";
                 auto &error = stack.back();
-                assert(error.kind == value_t::kind_t::RVALUE);
-                error.rvalue->repr(*this, std::cerr);
+                assert(error.is_ref());
+                error.ref()->repr(*this, std::cerr);
                 std::cerr << std::endl;
             }
 
@@ -556,10 +639,10 @@ namespace park {
     void FiberImpl::roots(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept)
     {
         stack.each([&](auto &item) {
-            if(item.kind == value_t::kind_t::RVALUE) {
-                gc::ref<Value> ref(item.rvalue);
+            if(item.is_ref()) {
+                gc::ref<Value> ref(item.ref());
                 accept(ref);
-                item.rvalue = ref.mutate();
+                item = value::to_value_t<gc::ref<Value>>(ref);
             }
         });
         for(auto &item : frame_stack) {
@@ -572,6 +655,10 @@ namespace park {
     void FiberImpl::exec_function_checkpoint(const AST::Function &function) {
         assert(allocator_ != nullptr);
         if(++checkpoint_ % 256 == 0) {
+            if(sample_pending_) {
+                sample_pending_ = 0;
+                runtime.profiler().sample(*this);
+            }
             auto &collector = runtime.collector();
             if(collector.stw_mutators_wait.load()) 
             {
@@ -584,24 +671,6 @@ namespace park {
         }
     }
 
-    int64_t FiberImpl::exec_function_epilog(const AST::Function &function, void **link) {
-        assert(frame_stack.back().apply != nullptr);
-        auto &apply = *frame_stack.back().apply;
-        auto result = stack.back();
-        stack.pop_back();
-        stack.pop(function.local_count());
-        *link = pop_frame([&]() {
-            stack.push_back(result);
-        }); 
-        //might be Error, TODO have actual throw stmt and flag in other way, removeing the call to is_error
-        if(result.kind == value_t::kind_t::RVALUE && Error2::is_error(*result.rvalue) && apply.throws_) {
-            return 1;
-        }
-        else {
-            return 0;
-        }
-    }
-
     void FiberImpl::exec_recur(const AST::Recur &recur) {
 
         assert(!frame_stack.empty());
@@ -623,10 +692,10 @@ namespace park {
 
         auto argument_count = apply.arguments_->size();
 
-        frame_stack.push_back({&apply, stack.base(argument_count), argument_count, 0, nullptr});
-        link_stack.push_back(link);
+        frame_stack.push_back({&apply, stack.base(argument_count), argument_count, 0, nullptr, link});
+        frame_base_ = frame_stack.back().base;
 
-        return link_stack[0]; //return the address to jump to to perform the exit, which is the link of the top-most frame
+        return frame_stack[0].link; //return the address to jump to to perform the exit, which is the link of the top-most frame
     }
 
     //called under lock
@@ -645,7 +714,10 @@ namespace park {
     }
 
     //not forget to call fiber_created on runtime
+    static std::atomic<uint64_t> next_edit(1);
+
     Fiber::Fiber() 
+        : edit_(next_edit++)
     {
     }
 
@@ -663,6 +735,25 @@ namespace park {
         FiberImpl::init(runtime);
     }
 
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+    size_t Fiber::stack_offset() {
+        return offsetof(Fiber, stack);
+    }
+
+    size_t Fiber::frame_base_offset() {
+        return offsetof(Fiber, frame_base_);
+    }
+
+    size_t Fiber::frame_stack_offset() {
+        return offsetof(Fiber, frame_stack);
+    }
+
+    size_t Fiber::checkpoint_offset() {
+        return offsetof(Fiber, checkpoint_);
+    }
+#pragma GCC diagnostic pop
+
     int64_t Frame::cc_resume(std::function<bool(Fiber &fbr)> f) {
         auto &fiber = FiberImpl::from_fbr(fbr_);
         fiber.post_exit_callback_cc_resume = std::move(f);
@@ -716,6 +807,22 @@ namespace park {
         FiberImpl::from_fbr(fbr).exec_builtin(builtin);
     }
 
+    void exec_builtin_under(Fiber &fbr, const AST::Builtin &builtin, int64_t argument_count) {
+        FiberImpl::from_fbr(fbr).exec_builtin_under(builtin, argument_count);
+    }
+
+    void exec_reserve(Fiber &fbr, const AST::Node &node) {
+        FiberImpl::from_fbr(fbr).exec_reserve();
+    }
+
+    void exec_inline_locals(Fiber &fbr, const AST::Function &function, int64_t count) {
+        FiberImpl::from_fbr(fbr).exec_inline_locals(count);
+    }
+
+    int64_t exec_return_throws(Fiber &fbr, const AST::Apply &apply) {
+        return FiberImpl::from_fbr(fbr).exec_return_throws(apply);
+    }
+
     void exec_pop(Fiber &fbr, const AST::Node &node) {
         FiberImpl::from_fbr(fbr).exec_pop(node);
     }
@@ -740,10 +847,6 @@ namespace park {
         FiberImpl::from_fbr(fbr).exec_function_checkpoint(function);
     }
 
-    int64_t exec_function_epilog(Fiber &fbr, const AST::Function &function, void **link) {
-        return FiberImpl::from_fbr(fbr).exec_function_epilog(function, link);
-    }
-
     void *exec_exit(Fiber &fbr, const AST::Apply &apply, void *link) {
         return FiberImpl::from_fbr(fbr).exec_exit(apply, link);
     }
@@ -756,8 +859,69 @@ namespace park {
         return FiberImpl::from_fbr(fbr).exec_dispatch(apply);
     }
 
+    MethodImpl exec_tier_up(Fiber &fbr, const AST::Apply &apply, const AST::Function &function) {
+        return FiberImpl::from_fbr(fbr).runtime.compiler().tier_up(apply, function);
+    }
+
+    void exec_deopt(Fiber &fbr, const AST::Function &function, void *code) {
+        FiberImpl::from_fbr(fbr).runtime.compiler().deoptimize(function, code);
+    }
+
     AST::Apply::Apply(size_t line, gc::ref<Node> callable, gc::ref<NodeList> arguments)
-        : target_(exec_dispatch), line_(line), callable_(callable), arguments_(arguments) {}
+        : target_(exec_dispatch), cache_(exec_dispatch), line_(line), callable_(callable), arguments_(arguments) {}
+
+    //looks for applications of defer in a function body, not counting nested functions
+    class DeferVisitor : public AST::Visitor {
+    public:
+        bool found_ = false;
+
+        void visit_builtin(const AST::Builtin &builtin) override {
+            found_ = found_ || (builtin.value_.is_ref() && builtin.value_.ref() == DEFER.get());
+        }
+
+        void visit_symbol(const AST::Symbol &symbol) override {
+            found_ = found_ || symbol.name_ == "defer";
+        }
+
+        void visit_apply(const AST::Apply &apply) override {
+            apply.callable_->accept(*this);
+            for (auto const &argument : *apply.arguments_) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit_let(const AST::Let &let) override {
+            let.expression_->accept(*this);
+        }
+
+        void visit_branch(const AST::Branch &branch) override {
+            branch.condition_->accept(*this);
+            branch.trueBranch_->accept(*this);
+            branch.falseBranch_->accept(*this);
+        }
+
+        void visit_return(const AST::Return &return_) override {
+            return_.expression_->accept(*this);
+        }
+
+        void visit_recur(const AST::Recur &recur) override {
+            for (auto const &argument : *recur.arguments_) {
+                argument->accept(*this);
+            }
+        }
+
+        void visit_do(const AST::Do &do_) override {
+            for (auto const &statement : *do_.statements_) {
+                statement->accept(*this);
+            }
+        }
+    };
+
+    bool AST::Function::has_defers() const {
+        DeferVisitor visitor;
+        expression_->accept(visitor);
+        return visitor.found_;
+    }
 
 
     void FiberImpl::init(Runtime &runtime) {
@@ -768,7 +932,7 @@ namespace park {
         std::cerr << "sz Stack: " << sizeof(Fiber::stack_t) << std::endl;
         std::cerr << "sz private_heap_t: " << sizeof(gc::private_heap_t) << std::endl;
         std::cerr << "sz value_t: " << sizeof(value_t) << std::endl;
-        std::cerr << "sz frame_stack_t: " << sizeof(frame_stack_t) << std::endl;
+        std::cerr << "sz frame_stack_t: " << sizeof(frame_t) << std::endl;
         std::cerr << "sz block_t: " << sizeof(gc::block_t) << std::endl;
         std::cerr << "sz post_exit_callback_cc_resume_t: " << sizeof(post_exit_callback_cc_resume_t) << std::endl;
         */
@@ -777,6 +941,9 @@ namespace park {
         EXIT = runtime.create_builtin<BuiltinStaticDispatch>("exit", _exit);
         SPAWN = runtime.create_builtin<BuiltinStaticDispatch>("spawn", _spawn);
         DEFER = runtime.create_builtin<BuiltinStaticDispatch>("defer", _defer);
+        JIT_STATS = runtime.create_builtin<BuiltinStaticDispatch>("jit_stats", _jit_stats);
+        PROFILE_START = runtime.create_builtin<BuiltinStaticDispatch>("profile_start", _profile_start);
+        PROFILE_STOP = runtime.create_builtin<BuiltinStaticDispatch>("profile_stop", _profile_stop);
 
     }
 
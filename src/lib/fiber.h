@@ -47,6 +47,16 @@ namespace park {
 
         stack_t stack;
 
+        size_t frame_base_ = 0; //base of the current frame in stack, kept here for the jit
+
+        FrameStack frame_stack; //frames of the functions being executed, pushed and popped by the jit
+
+        int checkpoint_ = 0; //counts function entries, every so often the fiber checks in with the gc
+
+        volatile std::sig_atomic_t sample_pending_ = 0; //set by the profiler, sample is taken at the next checkpoint
+
+        const uint64_t edit_; //never reused, marks the shared transients this fiber may edit
+
         Fiber();
         ~Fiber();
 
@@ -83,6 +93,12 @@ namespace park {
         virtual void resume_async(std::function<void(Fiber &fbr)> f, int64_t ret_code) = 0;
         virtual void resume_sync(std::function<void(Fiber &fbr)> f, int64_t ret_code) = 0;
 
+        //offsets of stack, frame_base_, frame_stack and checkpoint_ from the start of the fiber, for jit code
+        static size_t stack_offset();
+        static size_t frame_base_offset();
+        static size_t frame_stack_offset();
+        static size_t checkpoint_offset();
+
         void roots(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept);
 
     };
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "float.h"
+#include "integer.h"
+#include "frame.h"
+#include "type.h"
+#include "visitor.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace park {
+
+class FloatImpl : public ValueImpl<Float, FloatImpl>
+{
+    static gc::ref<Value> EQUALS;
+    static gc::ref<Value> ADD;
+    static gc::ref<Value> SUBTRACT;
+    static gc::ref<Value> MULTIPLY;
+    static gc::ref<Value> DIVIDE;
+    static gc::ref<Value> LESSTHAN;
+    static gc::ref<Value> GREATERTHAN;
+    static gc::ref<Value> INT;
+    static gc::ref<Value> FLOAT;
+
+public:
+    const double v;
+
+    explicit FloatImpl(double v) : v(v) {}
+
+    const Value &accept(Fiber &fbr, Visitor &visitor) const override {
+        return visitor.visit(fbr, *this);
+    }
+
+    //an integral float is the same key as the int of that value, as 1 == 1.0
+    const size_t map_key_hash(Fiber &fbr) const override
+    {
+        if (Float::is_int64(v)) {
+            return std::hash<int64_t>()(static_cast<int64_t>(v));
+        }
+        return std::hash<double>()(v);
+    }
+
+    const bool map_key_equals(Fiber &fbr, const Value &other) const override
+    {
+        if (&other.get_type() == &Integer::type()) {
+            return Float::is_int64(v) && static_cast<int64_t>(v) == Integer::value(other);
+        }
+        return &other.get_type() == TYPE.get() && static_cast<const FloatImpl &>(other).v == v;
+    }
+
+    //shortest representation that reads back as the same double, always with a '.' or exponent
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        char buff[32];
+        auto const end = std::to_chars(buff, buff + sizeof(buff), v).ptr;
+        auto const s = std::string_view(buff, end - buff);
+        out << s;
+        if (s.find_first_of(".einf") == std::string_view::npos) {
+            out << ".0";
+        }
+    }
+
+    bool to_bool(Fiber &fbr) const override {
+        return v != 0.0;
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}
+
+    //binary operation on 2 numbers of which at least one is a float, the int64 is promoted
+    template<typename T, typename F>
+    static int64_t binary(Fiber &fbr, const AST::Apply &apply, const Value &callable, F f) {
+        Frame frame(fbr, apply);
+
+        if (apply.argument_count() != 2) {
+            return frame.bad_dispatch();
+        }
+
+        auto &c = frame.argument_(0);
+        double a, b;
+
+        if (!(c.is_ref() && c.ref() == &callable) ||
+            !Float::number(frame.argument_(1), a) ||
+            !Float::number(frame.argument_(2), b)) {
+            return frame.bad_dispatch();
+        }
+
+        frame.stack.pop(3);
+        frame.stack.push<T>(f(a, b));
+
+        return 0;
+    }
+
+    static int64_t _equals(Fiber &fbr, const AST::Apply &apply) {
+        return binary<bool>(fbr, apply, *EQUALS, [](double a, double b) { return a == b; });
+    }
+
+    static int64_t _add(Fiber &fbr, const AST::Apply &apply) {
+        return binary<double>(fbr, apply, *ADD, [](double a, double b) { return a + b; });
+    }
+
+    static int64_t _subtract(Fiber &fbr, const AST::Apply &apply) {
+        return binary<double>(fbr, apply, *SUBTRACT, [](double a, double b) { return a - b; });
+    }
+
+    static int64_t _multiply(Fiber &fbr, const AST::Apply &apply) {
+        return binary<double>(fbr, apply, *MULTIPLY, [](double a, double b) { return a * b; });
+    }
+
+    static int64_t _divide(Fiber &fbr, const AST::Apply &apply) {
+        return binary<double>(fbr, apply, *DIVIDE, [](double a, double b) { return a / b; });
+    }
+
+    static int64_t _lessthan(Fiber &fbr, const AST::Apply &apply) {
+        return binary<bool>(fbr, apply, *LESSTHAN, [](double a, double b) { return a < b; });
+    }
+
+    static int64_t _greaterthan(Fiber &fbr, const AST::Apply &apply) {
+        return binary<bool>(fbr, apply, *GREATERTHAN, [](double a, double b) { return a > b; });
+    }
+
+    static int64_t _int(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        return frame.check().
+            static_dispatch(*INT).
+            argument_count(1).
+            result<int64_t>([&]() {
+                double d = 0.0;
+                Float::number(frame.argument_(1), d);
+                if (!Float::in_int64_range(d)) {
+                    throw std::runtime_error("int() of a float that is not within the int64 range");
+                }
+                return static_cast<int64_t>(d);
+            });
+    }
+
+    static int64_t _float(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        return frame.check().
+            static_dispatch(*FLOAT).
+            argument_count(1).
+            result<double>([&]() {
+                double d = 0.0;
+                Float::number(frame.argument_(1), d);
+                return d;
+            });
+    }
+
+    //registers method for float with float, and for the mixes of float and int64.
+    //unboxed kinds are tried first by the dispatch, the types cover boxed values
+    static void register_binary(Runtime &runtime, gc::ref<Value> builtin, MethodImpl method, bool int64 = false) {
+        auto const F = value_t::kind_t::DVALUE;
+        auto const I = value_t::kind_t::IVALUE;
+
+        runtime.register_method(builtin, F, F, method);
+        runtime.register_method(builtin, F, I, method);
+        runtime.register_method(builtin, I, F, method);
+        runtime.register_method(builtin, *TYPE, *TYPE, method);
+        runtime.register_method(builtin, *TYPE, Integer::type(), method);
+        runtime.register_method(builtin, Integer::type(), *TYPE, method);
+        if (int64) {
+            runtime.register_method(builtin, I, I, method);
+            runtime.register_method(builtin, Integer::type(), Integer::type(), method);
+        }
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("Float");
+
+        EQUALS = runtime.builtin("equals");
+        register_binary(runtime, EQUALS, _equals);
+
+        ADD = runtime.builtin("add");
+        register_binary(runtime, ADD, _add);
+
+        SUBTRACT = runtime.builtin("subtract");
+        register_binary(runtime, SUBTRACT, _subtract);
+
+        MULTIPLY = runtime.builtin("multiply");
+        register_binary(runtime, MULTIPLY, _multiply);
+
+        //division always gives a float, also for 2 int64's
+        DIVIDE = runtime.builtin("divide");
+        register_binary(runtime, DIVIDE, _divide, true);
+
+        LESSTHAN = runtime.builtin("lt");
+        register_binary(runtime, LESSTHAN, _lessthan);
+
+        GREATERTHAN = runtime.builtin("gt");
+        register_binary(runtime, GREATERTHAN, _greaterthan);
+
+        INT = runtime.builtin("int");
+        runtime.register_method(INT, *TYPE, _int);
+
+        FLOAT = runtime.builtin("float");
+        runtime.register_method(FLOAT, *TYPE, _float);
+        runtime.register_method(FLOAT, Integer::type(), _float);
+    }
+
+};
+
+gc::ref<Value> FloatImpl::EQUALS;
+gc::ref<Value> FloatImpl::ADD;
+gc::ref<Value> FloatImpl::SUBTRACT;
+gc::ref<Value> FloatImpl::MULTIPLY;
+gc::ref<Value> FloatImpl::DIVIDE;
+gc::ref<Value> FloatImpl::LESSTHAN;
+gc::ref<Value> FloatImpl::GREATERTHAN;
+gc::ref<Value> FloatImpl::INT;
+gc::ref<Value> FloatImpl::FLOAT;
+
+void Float::init(Runtime &runtime)
+{
+    FloatImpl::init(runtime);
+}
+
+const Type &Float::type() {
+    return *FloatImpl::TYPE;
+}
+
+double Float::value(const Value &f) {
+    assert(&f.get_type() == FloatImpl::TYPE.get());
+    return static_cast<const FloatImpl &>(f).v;
+}
+
+gc::ref<Float> Float::create(Fiber &fbr, double d) {
+    return gc::make_ref<FloatImpl>(fbr.allocator(), d);
+}
+
+bool Float::in_int64_range(double d) {
+    //false for nan too
+    return d >= -0x1p63 && d < 0x1p63;
+}
+
+bool Float::is_int64(double d) {
+    return in_int64_range(d) && d == std::trunc(d);
+}
+
+bool Float::number(const value_t &value, double &result) {
+    if (value.is_float64()) {
+        result = value.float64();
+        return true;
+    }
+    else if (value.is_int64()) {
+        result = static_cast<double>(value.int64());
+        return true;
+    }
+    else if (value.is_ref()) {
+        auto const &type = value.ref()->get_type();
+        if (&type == FloatImpl::TYPE.get()) {
+            result = static_cast<const FloatImpl *>(value.ref())->v;
+            return true;
+        }
+        else if (&type == &Integer::type()) {
+            result = static_cast<double>(Integer::value(*value.ref()));
+            return true;
+        }
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __FLOAT_H
+#define __FLOAT_H
+
+#include "value.h"
+
+namespace park {
+
+    //double precision float, normally unboxed in a value_t (DVALUE), boxed when it is stored in a collection
+    class Float : public Value {
+    public:
+        static gc::ref<Float> create(Fiber &fbr, double d);
+
+        static void init(Runtime &runtime);
+
+        static const Type &type();
+
+        //the value of a boxed float
+        static double value(const Value &f);
+
+        //the value of an int64 or float, boxed or not, with int64's promoted to double
+        static bool number(const value_t &value, double &result);
+
+        //whether d truncates to an int64, e.g. is finite and within [INT64_MIN, 2^63)
+        static bool in_int64_range(double d);
+
+        //whether d is an int64 value without a fraction
+        static bool is_int64(double d);
+    };
+
+}
+
+#endif
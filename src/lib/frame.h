@@ -69,6 +69,9 @@ namespace park {
         template<typename T>
         const FrameCheck argument(int index, T &out) const;
 
+        template<typename T>
+        const FrameCheck optional_argument(int index, T &out) const;
+
     };
 
     class Frame {
@@ -137,7 +140,7 @@ namespace park {
         } 
 
         inline value_t::kind_t argument_kind(int index) const {
-            return stack.argument(base, index).kind;
+            return stack.argument(base, index).kind();
         }
 
         int64_t bad_dispatch();
@@ -396,6 +399,15 @@ namespace park {
         return *this;        
     }
 
+    template<typename T>
+    inline const FrameCheck FrameCheck::optional_argument(int index, T &out) const
+    {
+        if(res_ == 0 && index >= 0 && index <= frame_.argument_count()) {
+            out = frame_.argument<T>(index);
+        }
+        return *this;
+    }
+
     template<typename T, typename F>
     inline int64_t FrameCheck::result(F f) const
     {
@@ -355,6 +355,7 @@ void collector_t::collect_shared(
         //update write barrier for each allocator
         for_each_allocator([&](auto &allocator) {
             allocator.write_barrier_ = true;
+            allocator.write_barrier_epoch_ += 1;
             allocator.local_collect_barrier_ = true; //prevent local collection until we scanned roots
         });
 
@@ -563,6 +564,26 @@ void allocator_t::share(const ref<collectable> &o)
     share_(o);
 }
 
+void allocator_t::record_shared(const collectable *r)
+{
+    ref_list_t shared;
+    std::function<void(const collectable *)> record = [&](auto r) {
+        if(is_shared_ref(r)) {
+            shared.push_back(r);
+        }
+        else {
+            const_cast<collectable *>(r)->walk([&](auto &r1) {
+                record(r1.get());
+            });
+        }
+    };
+
+    record(r);
+
+    std::lock_guard<std::mutex> lock_guard(lock_);
+    ref_list_.insert(ref_list_.end(), shared.begin(), shared.end());
+}
+
 void scan_shared_roots(const for_each_root_t &for_each_root, worker_t &worker)
 {
     //int level = 0;
@@ -75,6 +75,7 @@ struct allocator_t
 	std::unique_ptr<shared_heap_t> shared_heap_;
 
 	bool write_barrier_ = false;
+	uint64_t write_barrier_epoch_ = 0; //incremented each time the write barrier is turned on
 	std::atomic<bool> local_collect_barrier_ = false;
 
     ref_list_t ref_list_;
@@ -169,6 +170,8 @@ struct allocator_t
     void collect_local_to_local(const for_each_root_t &for_each_root);
     void collect_local_to_shared(const for_each_root_t &for_each_root);
 
+	void record_shared(const collectable *r);
+
 };
 
 //the write barrier
@@ -178,12 +181,30 @@ inline void ref_write(allocator_t &allocator, ref<T> &slot, ref<T> src)
     allocator.share(src);
 	if(allocator.write_barrier_) {
 		std::lock_guard<std::mutex> lock_guard(allocator.lock_);		
-		allocator.ref_list_.push_back(slot.get());
+		if(slot) {
+			allocator.ref_list_.push_back(slot.get());
+		}
 		allocator.ref_list_.push_back(src.get());
     }
     slot = src;
 }
 
+//the write barrier for private objects that are otherwise changed in place (e.g. transients).
+//while it is up the collector might be walking anything reachable from r, so the owner must not
+//change those in place and should copy instead. the first time in a collection, the shared refs
+//reachable from r are recorded, as the owner is about to drop some of them
+inline bool private_write(allocator_t &allocator, const collectable *r, uint64_t &epoch)
+{
+	if(!allocator.write_barrier_) {
+		return false;
+	}
+	if(epoch != allocator.write_barrier_epoch_) {
+		epoch = allocator.write_barrier_epoch_;
+		allocator.record_shared(r);
+	}
+	return true;
+}
+
 inline void ref_share(allocator_t &allocator, ref<collectable> &r) {
     allocator.share(r);
 }
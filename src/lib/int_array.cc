@@ -0,0 +1,756 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "int_array.h"
+#include "integer.h"
+#include "vector.h"
+#include "builtin.h"
+#include "frame.h"
+#include "type.h"
+
+#include <vector>
+#include <algorithm>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace park {
+
+    static gc::ref<Value> LENGTH;
+    static gc::ref<Value> GET;
+    static gc::ref<Value> NOT;
+    static gc::ref<Value> CONJ;
+    static gc::ref<Value> ADD;
+    static gc::ref<Value> MULTIPLY;
+    static gc::ref<Value> TRANSIENT;
+    static gc::ref<Value> PERSISTENT;
+    static gc::ref<Value> SUM;
+    static gc::ref<Value> MIN;
+    static gc::ref<Value> MAX;
+    static gc::ref<Value> WHERE;
+    static gc::ref<Value> CHUNKS;
+    static gc::ref<Value> CHUNK_FIRST;
+    static gc::ref<Value> CHUNK_NEXT;
+    static gc::ref<Value> LESSTHAN;
+    static gc::ref<Value> GREATERTHAN;
+    static gc::ref<Value> EQUALS;
+    static gc::ref<Value> NOT_EQUALS;
+    static gc::ref<BuiltinStaticDispatch> INT_ARRAY;
+    static gc::ref<BuiltinStaticDispatch> INT_RANGE;
+
+    /*
+     * Bulk kernels over raw int64's. The AVX2 versions are only compiled for that target and are picked at runtime
+     * when the cpu supports it, the scalar versions are the fallback and also do the remainders. Arithmetic wraps
+     * around like it does in two's complement.
+     */
+    namespace kernels {
+
+        enum class cmp_t {
+            LT, GT, EQ, NE
+        };
+
+        static bool has_avx2() {
+#if defined(__x86_64__)
+            static const bool avx2 = __builtin_cpu_supports("avx2");
+            return avx2;
+#else
+            return false;
+#endif
+        }
+
+        static int64_t sum_scalar(const int64_t *a, size_t n) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                sum += static_cast<uint64_t>(a[i]);
+            }
+            return sum;
+        }
+
+        template<bool IS_MAX>
+        static int64_t extreme_scalar(int64_t init, const int64_t *a, size_t n) {
+            auto res = init;
+            for (size_t i = 0; i < n; i++) {
+                res = IS_MAX ? std::max(res, a[i]) : std::min(res, a[i]);
+            }
+            return res;
+        }
+
+        //b is broadcast from x when it is null
+        static void add_scalar(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = static_cast<uint64_t>(a[i]) + static_cast<uint64_t>(b ? b[i] : x);
+            }
+        }
+
+        static void multiply_scalar(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = static_cast<uint64_t>(a[i]) * static_cast<uint64_t>(b ? b[i] : x);
+            }
+        }
+
+        static bool compare(cmp_t cmp, int64_t v, int64_t x) {
+            switch (cmp) {
+                case cmp_t::LT: return v < x;
+                case cmp_t::GT: return v > x;
+                case cmp_t::EQ: return v == x;
+                case cmp_t::NE: return v != x;
+            }
+            return false;
+        }
+
+        static size_t where_scalar(const int64_t *a, size_t n, cmp_t cmp, int64_t x, int64_t *out) {
+            size_t count = 0;
+            for (size_t i = 0; i < n; i++) {
+                out[count] = a[i];
+                count += compare(cmp, a[i], x);
+            }
+            return count;
+        }
+
+        static void range_scalar(int64_t start, int64_t step, int64_t *out, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                out[i] = static_cast<uint64_t>(start) + static_cast<uint64_t>(step) * i;
+            }
+        }
+
+#if defined(__x86_64__)
+
+#define AVX2 __attribute__((target("avx2")))
+
+        AVX2 static inline __m256i load(const int64_t *p) {
+            return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+        }
+
+        AVX2 static inline void store(int64_t *p, __m256i v) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+        }
+
+        //there is no 64 bit multiply in AVX2, the low 64 bits are composed from 32 bit products
+        AVX2 static inline __m256i mullo_epi64(__m256i a, __m256i b) {
+            auto lo = _mm256_mul_epu32(a, b);
+            auto cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                          _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+            return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+        }
+
+        AVX2 static int64_t sum_avx2(const int64_t *a, size_t n) {
+            auto acc0 = _mm256_setzero_si256();
+            auto acc1 = _mm256_setzero_si256();
+            size_t i = 0;
+            for (; i + 8 <= n; i += 8) {
+                acc0 = _mm256_add_epi64(acc0, load(a + i));
+                acc1 = _mm256_add_epi64(acc1, load(a + i + 4));
+            }
+            int64_t lanes[4];
+            store(lanes, _mm256_add_epi64(acc0, acc1));
+            return sum_scalar(lanes, 4) + static_cast<uint64_t>(sum_scalar(a + i, n - i));
+        }
+
+        template<bool IS_MAX>
+        AVX2 static int64_t extreme_avx2(const int64_t *a, size_t n) {
+            assert(n >= 4);
+            auto best = load(a);
+            size_t i = 4;
+            for (; i + 4 <= n; i += 4) {
+                auto v = load(a + i);
+                //lanes where v should replace best
+                auto better = IS_MAX ? _mm256_cmpgt_epi64(v, best) : _mm256_cmpgt_epi64(best, v);
+                best = _mm256_blendv_epi8(best, v, better);
+            }
+            int64_t lanes[4];
+            store(lanes, best);
+            return extreme_scalar<IS_MAX>(extreme_scalar<IS_MAX>(lanes[0], lanes + 1, 3), a + i, n - i);
+        }
+
+        AVX2 static void add_avx2(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+            auto vx = _mm256_set1_epi64x(x);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                store(out + i, _mm256_add_epi64(load(a + i), b ? load(b + i) : vx));
+            }
+            add_scalar(a + i, b ? b + i : nullptr, x, out + i, n - i);
+        }
+
+        AVX2 static void multiply_avx2(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+            auto vx = _mm256_set1_epi64x(x);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                store(out + i, mullo_epi64(load(a + i), b ? load(b + i) : vx));
+            }
+            multiply_scalar(a + i, b ? b + i : nullptr, x, out + i, n - i);
+        }
+
+        //permutations that move the selected 64 bit lanes (as pairs of 32 bit lanes) to the front, by 4 bit mask
+        struct compress_table_t {
+            int32_t idx[16][8];
+
+            constexpr compress_table_t() : idx() {
+                for (int mask = 0; mask < 16; mask++) {
+                    int k = 0;
+                    for (int lane = 0; lane < 4; lane++) {
+                        if (mask & (1 << lane)) {
+                            idx[mask][k++] = lane * 2;
+                            idx[mask][k++] = lane * 2 + 1;
+                        }
+                    }
+                }
+            }
+        };
+
+        static constexpr compress_table_t compress_table;
+
+        //out needs room for 4 more than n, the last store of each step writes a full vector
+        AVX2 static size_t where_avx2(const int64_t *a, size_t n, cmp_t cmp, int64_t x, int64_t *out) {
+            auto vx = _mm256_set1_epi64x(x);
+            size_t count = 0;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                auto v = load(a + i);
+                __m256i selected;
+                int invert = 0;
+                switch (cmp) {
+                    case cmp_t::LT: selected = _mm256_cmpgt_epi64(vx, v); break;
+                    case cmp_t::GT: selected = _mm256_cmpgt_epi64(v, vx); break;
+                    case cmp_t::EQ: selected = _mm256_cmpeq_epi64(v, vx); break;
+                    case cmp_t::NE: selected = _mm256_cmpeq_epi64(v, vx); invert = 0xf; break;
+                }
+                auto mask = _mm256_movemask_pd(_mm256_castsi256_pd(selected)) ^ invert;
+                auto perm = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(compress_table.idx[mask]));
+                store(out + count, _mm256_permutevar8x32_epi32(v, perm));
+                count += __builtin_popcount(mask);
+            }
+            return count + where_scalar(a + i, n - i, cmp, x, out + count);
+        }
+
+        AVX2 static void range_avx2(int64_t start, int64_t step, int64_t *out, size_t n) {
+            //wraps like range_scalar, signed overflow would be undefined
+            auto const first = static_cast<uint64_t>(start);
+            auto const delta = static_cast<uint64_t>(step);
+            auto v = _mm256_set_epi64x(first + 3 * delta, first + 2 * delta, first + delta, first);
+            auto inc = _mm256_set1_epi64x(4 * delta);
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                store(out + i, v);
+                v = _mm256_add_epi64(v, inc);
+            }
+            range_scalar(static_cast<uint64_t>(start) + static_cast<uint64_t>(step) * i, step, out + i, n - i);
+        }
+
+#undef AVX2
+
+#endif
+
+        static int64_t sum(const int64_t *a, size_t n) {
+#if defined(__x86_64__)
+            if (has_avx2()) {
+                return sum_avx2(a, n);
+            }
+#endif
+            return sum_scalar(a, n);
+        }
+
+        template<bool IS_MAX>
+        static int64_t extreme(const int64_t *a, size_t n) {
+            assert(n > 0);
+#if defined(__x86_64__)
+            if (has_avx2() && n >= 4) {
+                return extreme_avx2<IS_MAX>(a, n);
+            }
+#endif
+            return extreme_scalar<IS_MAX>(a[0], a + 1, n - 1);
+        }
+
+        static void add(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+#if defined(__x86_64__)
+            if (has_avx2()) {
+                return add_avx2(a, b, x, out, n);
+            }
+#endif
+            add_scalar(a, b, x, out, n);
+        }
+
+        static void multiply(const int64_t *a, const int64_t *b, int64_t x, int64_t *out, size_t n) {
+#if defined(__x86_64__)
+            if (has_avx2()) {
+                return multiply_avx2(a, b, x, out, n);
+            }
+#endif
+            multiply_scalar(a, b, x, out, n);
+        }
+
+        static size_t where(const int64_t *a, size_t n, cmp_t cmp, int64_t x, int64_t *out) {
+#if defined(__x86_64__)
+            if (has_avx2()) {
+                return where_avx2(a, n, cmp, x, out);
+            }
+#endif
+            return where_scalar(a, n, cmp, x, out);
+        }
+
+        static void range(int64_t start, int64_t step, int64_t *out, size_t n) {
+#if defined(__x86_64__)
+            if (has_avx2()) {
+                return range_avx2(start, step, out, n);
+            }
+#endif
+            range_scalar(start, step, out, n);
+        }
+    }
+
+    //the elements live outside of the gc heap, so arrays are allocated shared (with a finalizer) like big strings
+    class IntArrayImpl : public SharedValueImpl<IntArray, IntArrayImpl> {
+    private:
+        const std::vector<int64_t> data_;
+
+    public:
+        explicit IntArrayImpl(std::vector<int64_t> &&data)
+            : data_(std::move(data)) {}
+
+        static gc::ref<IntArrayImpl> create(Fiber &fbr, std::vector<int64_t> &&data) {
+            return gc::make_shared_ref<IntArrayImpl>(fbr.allocator(), std::move(data));
+        }
+
+        size_t size() const override {
+            return data_.size();
+        }
+
+        const int64_t *data() const override {
+            return data_.data();
+        }
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}
+
+        bool to_bool(Fiber &fbr) const override {
+            return !data_.empty();
+        }
+
+        void repr(Fiber &fbr, std::ostream &out) const override {
+            out << "int_array([";
+            for (size_t i = 0; i < std::min(130UL, size()); i++) {
+                out << data_[i] << ", ";
+            }
+            if (size() > 130UL) {
+                out << "...";
+            }
+            out << "])";
+        }
+
+        static int64_t _int_array(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<Vector> values;
+
+            return frame.check().
+                static_dispatch(*INT_ARRAY).
+                argument_count(1).
+                argument<Vector>(1, values).
+                result<Value>([&]() {
+                    if (&values->get_type() != &Vector::type()) {
+                        throw std::runtime_error("int_array expects a vector");
+                    }
+                    std::vector<int64_t> data(values->size());
+                    for (size_t i = 0; i < data.size(); i++) {
+                        auto value = values->nth(i);
+                        if (&value->get_type() != &Integer::type()) {
+                            throw std::runtime_error("int_array expects a vector of integers");
+                        }
+                        data[i] = Integer::value(*value);
+                    }
+                    return create(fbr, std::move(data));
+                });
+        }
+
+        static int64_t _int_range(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            int64_t start;
+            int64_t end;
+            int64_t step = 1;
+
+            return frame.check().
+                static_dispatch(*INT_RANGE).
+                argument_count(2, 3).
+                argument<int64_t>(1, start).
+                argument<int64_t>(2, end).
+                optional_argument<int64_t>(3, step).
+                result<Value>([&]() {
+                    if (step == 0) {
+                        throw std::runtime_error("int_range step cannot be 0");
+                    }
+                    size_t n = 0;
+                    if (step > 0 && end > start) {
+                        n = (static_cast<uint64_t>(end) - start + step - 1) / step;
+                    }
+                    else if (step < 0 && end < start) {
+                        n = (static_cast<uint64_t>(start) - end - step - 1) / -static_cast<uint64_t>(step);
+                    }
+                    std::vector<int64_t> data(n);
+                    kernels::range(start, step, data.data(), n);
+                    return create(fbr, std::move(data));
+                });
+        }
+
+        static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*LENGTH, *TYPE).
+                argument_count(1).
+                argument<IntArrayImpl>(1, self).
+                result<int64_t>([&]() {
+                    return self->size();
+                });
+        }
+
+        static int64_t _get(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+            int64_t idx;
+
+            return frame.check().
+                single_dispatch(*GET, *TYPE).
+                argument_count(2).
+                argument<IntArrayImpl>(1, self).
+                argument<int64_t>(2, idx).
+                result<int64_t>([&]() {
+                    if (idx < 0 || static_cast<size_t>(idx) >= self->size()) {
+                        throw std::runtime_error("index out of bound");
+                    }
+                    return self->data_[idx];
+                });
+        }
+
+        static int64_t _not(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*NOT, *TYPE).
+                argument_count(1).
+                argument<IntArrayImpl>(1, self).
+                result<bool>([&]() {
+                    return self->data_.empty();
+                });
+        }
+
+        static int64_t _sum(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*SUM, *TYPE).
+                argument_count(1).
+                argument<IntArrayImpl>(1, self).
+                result<int64_t>([&]() {
+                    return kernels::sum(self->data(), self->size());
+                });
+        }
+
+        template<bool IS_MAX>
+        static int64_t _extreme(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(IS_MAX ? *MAX : *MIN, *TYPE).
+                argument_count(1).
+                argument<IntArrayImpl>(1, self).
+                result<int64_t>([&]() {
+                    if (self->data_.empty()) {
+                        throw std::runtime_error("empty int_array has no min or max");
+                    }
+                    return kernels::extreme<IS_MAX>(self->data(), self->size());
+                });
+        }
+
+        //elementwise with another array of the same length, or with an integer that is broadcast
+        template<const gc::ref<Value> &BUILTIN, void (*KERNEL)(const int64_t *, const int64_t *, int64_t, int64_t *, size_t)>
+        static int64_t _elementwise(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            if (apply.argument_count() != 2) {
+                return frame.bad_dispatch();
+            }
+
+            auto &c = frame.argument_(0);
+            auto &rhs_type = frame.argument_type(2);
+
+            if (!(c.is_ref() && c.ref() == BUILTIN.get()) ||
+                &frame.argument_type(1) != TYPE.get() ||
+                (&rhs_type != TYPE.get() && &rhs_type != &Integer::type())) {
+                return frame.bad_dispatch();
+            }
+
+            auto &self = static_cast<const IntArrayImpl &>(frame.argument<const Value &>(1));
+            std::vector<int64_t> data(self.size());
+            if (&rhs_type == TYPE.get()) {
+                auto &other = static_cast<const IntArrayImpl &>(frame.argument<const Value &>(2));
+                if (other.size() != self.size()) {
+                    throw std::runtime_error("int_arrays differ in length");
+                }
+                KERNEL(self.data(), other.data(), 0, data.data(), data.size());
+            }
+            else {
+                KERNEL(self.data(), nullptr, frame.argument<int64_t>(2), data.data(), data.size());
+            }
+
+            frame.stack.pop(3);
+            frame.stack.push<gc::ref<Value>>(create(fbr, std::move(data)));
+
+            return 0;
+        }
+
+        static int64_t _where(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+            gc::ref<Value> op;
+            int64_t x;
+
+            return frame.check().
+                single_dispatch(*WHERE, *TYPE).
+                argument_count(3).
+                argument<IntArrayImpl>(1, self).
+                argument<Value>(2, op).
+                argument<int64_t>(3, x).
+                result<Value>([&]() {
+                    kernels::cmp_t cmp;
+                    if (op == LESSTHAN) {
+                        cmp = kernels::cmp_t::LT;
+                    }
+                    else if (op == GREATERTHAN) {
+                        cmp = kernels::cmp_t::GT;
+                    }
+                    else if (op == EQUALS) {
+                        cmp = kernels::cmp_t::EQ;
+                    }
+                    else if (op == NOT_EQUALS) {
+                        cmp = kernels::cmp_t::NE;
+                    }
+                    else {
+                        throw std::runtime_error("where compares with lt, gt, equals or not_equals");
+                    }
+                    std::vector<int64_t> data(self->size() + 4);
+                    data.resize(kernels::where(self->data(), self->size(), cmp, x, data.data()));
+                    data.shrink_to_fit();
+                    return create(fbr, std::move(data));
+                });
+        }
+
+        //the array is a single chunk, so sequence functions walk it with get
+        template<const gc::ref<Value> &BUILTIN, bool NEXT>
+        static int64_t _chunk(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<IntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*BUILTIN, *TYPE).
+                argument_count(1).
+                argument<IntArrayImpl>(1, self).
+                result<Value>([&]() -> gc::ref<Value> {
+                    if (NEXT) {
+                        return create(fbr, std::vector<int64_t>());
+                    }
+                    return self;
+                });
+        }
+
+        static int64_t _transient(Fiber &fbr, const AST::Apply &apply);
+
+        static void init(Runtime &runtime) {
+            TYPE = runtime.create_type("IntArray");
+
+            INT_ARRAY = runtime.create_builtin<BuiltinStaticDispatch>("int_array", _int_array);
+            INT_RANGE = runtime.create_builtin<BuiltinStaticDispatch>("int_range", _int_range);
+
+            runtime.register_method(LENGTH, *TYPE, _length);
+            runtime.register_method(GET, *TYPE, _get);
+            runtime.register_method(NOT, *TYPE, _not);
+            runtime.register_method(SUM, *TYPE, _sum);
+            runtime.register_method(MIN, *TYPE, _extreme<false>);
+            runtime.register_method(MAX, *TYPE, _extreme<true>);
+            runtime.register_method(WHERE, *TYPE, _where);
+            runtime.register_method(TRANSIENT, *TYPE, _transient);
+            runtime.register_method(CHUNKS, *TYPE, _chunk<CHUNKS, false>);
+            runtime.register_method(CHUNK_FIRST, *TYPE, _chunk<CHUNK_FIRST, false>);
+            runtime.register_method(CHUNK_NEXT, *TYPE, _chunk<CHUNK_NEXT, true>);
+
+            runtime.register_method(ADD, *TYPE, *TYPE, _elementwise<ADD, kernels::add>);
+            runtime.register_method(ADD, *TYPE, Integer::type(), _elementwise<ADD, kernels::add>);
+            runtime.register_method(ADD, *TYPE, value_t::kind_t::IVALUE, _elementwise<ADD, kernels::add>);
+            runtime.register_method(MULTIPLY, *TYPE, *TYPE, _elementwise<MULTIPLY, kernels::multiply>);
+            runtime.register_method(MULTIPLY, *TYPE, Integer::type(), _elementwise<MULTIPLY, kernels::multiply>);
+            runtime.register_method(MULTIPLY, *TYPE, value_t::kind_t::IVALUE, _elementwise<MULTIPLY, kernels::multiply>);
+        }
+    };
+
+    //shared like the array it builds, only the fiber that created it may use it
+    class TransientIntArrayImpl : public SharedValueImpl<TransientIntArray, TransientIntArrayImpl> {
+    private:
+        uint64_t edit_; //edit of the owning fiber, 0 once persistent
+        std::vector<int64_t> data_;
+
+    public:
+        TransientIntArrayImpl(uint64_t edit, std::vector<int64_t> &&data)
+            : edit_(edit), data_(std::move(data)) {}
+
+        static gc::ref<TransientIntArrayImpl> create(Fiber &fbr, const IntArray &array) {
+            std::vector<int64_t> data(array.data(), array.data() + array.size());
+            return gc::make_shared_ref<TransientIntArrayImpl>(fbr.allocator(), fbr.edit_, std::move(data));
+        }
+
+        void ensure_editable(Fiber &fbr) const {
+            if (edit_ == 0 || edit_ != fbr.edit_) {
+                throw Error::transient_not_editable(fbr, *this);
+            }
+        }
+
+        void conj(Fiber &fbr, int64_t val) override {
+            ensure_editable(fbr);
+            data_.push_back(val);
+        }
+
+        gc::ref<IntArray> persistent(Fiber &fbr) override {
+            ensure_editable(fbr);
+            edit_ = 0;
+            data_.shrink_to_fit();
+            return IntArrayImpl::create(fbr, std::move(data_));
+        }
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}
+
+        void repr(Fiber &fbr, std::ostream &out) const override {
+            out << "(transient int_array)";
+        }
+
+        static int64_t _conj(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientIntArrayImpl> self;
+            int64_t val;
+
+            return frame.check().
+                single_dispatch(*CONJ, *TYPE).
+                argument_count(2).
+                argument<TransientIntArrayImpl>(1, self).
+                argument<int64_t>(2, val).
+                result<Value>([&]() {
+                    self.mutate()->conj(fbr, val);
+                    return self;
+                });
+        }
+
+        static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientIntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*LENGTH, *TYPE).
+                argument_count(1).
+                argument<TransientIntArrayImpl>(1, self).
+                result<int64_t>([&]() {
+                    self->ensure_editable(fbr);
+                    return self->data_.size();
+                });
+        }
+
+        static int64_t _persistent(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientIntArrayImpl> self;
+
+            return frame.check().
+                single_dispatch(*PERSISTENT, *TYPE).
+                argument_count(1).
+                argument<TransientIntArrayImpl>(1, self).
+                result<Value>([&]() {
+                    return self.mutate()->persistent(fbr);
+                });
+        }
+
+        static void init(Runtime &runtime) {
+            TYPE = runtime.create_type("TransientIntArray");
+
+            runtime.register_method(CONJ, *TYPE, _conj);
+            runtime.register_method(LENGTH, *TYPE, _length);
+            runtime.register_method(PERSISTENT, *TYPE, _persistent);
+        }
+    };
+
+    int64_t IntArrayImpl::_transient(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<IntArrayImpl> self;
+
+        return frame.check().
+            single_dispatch(*TRANSIENT, *TYPE).
+            argument_count(1).
+            argument<IntArrayImpl>(1, self).
+            result<Value>([&]() {
+                return TransientIntArrayImpl::create(fbr, *self);
+            });
+    }
+
+    void IntArray::init(Runtime &runtime) {
+        LENGTH = runtime.builtin("length");
+        GET = runtime.builtin("get");
+        NOT = runtime.builtin("not");
+        CONJ = runtime.builtin("conj");
+        ADD = runtime.builtin("add");
+        MULTIPLY = runtime.builtin("multiply");
+        TRANSIENT = runtime.builtin("transient");
+        PERSISTENT = runtime.builtin("persistent");
+        SUM = runtime.builtin("sum");
+        MIN = runtime.builtin("min");
+        MAX = runtime.builtin("max");
+        WHERE = runtime.builtin("where");
+        LESSTHAN = runtime.builtin("lt");
+        GREATERTHAN = runtime.builtin("gt");
+        EQUALS = runtime.builtin("equals");
+        NOT_EQUALS = runtime.builtin("not_equals");
+        CHUNKS = runtime.builtin("chunks");
+        CHUNK_FIRST = runtime.builtin("chunk_first");
+        CHUNK_NEXT = runtime.builtin("chunk_next");
+
+        IntArrayImpl::init(runtime);
+        TransientIntArrayImpl::init(runtime);
+    }
+
+    gc::ref<IntArray> IntArray::create(Fiber &fbr, const int64_t *data, size_t size) {
+        return IntArrayImpl::create(fbr, std::vector<int64_t>(data, data + size));
+    }
+
+    const Type &IntArray::type() {
+        return *IntArrayImpl::TYPE;
+    }
+
+    gc::ref<TransientIntArray> TransientIntArray::create(Fiber &fbr, gc::ref<IntArray> array) {
+        return TransientIntArrayImpl::create(fbr, *array);
+    }
+
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __INT_ARRAY_H
+#define __INT_ARRAY_H
+
+#include "value.h"
+
+namespace park {
+
+    //immutable packed array of raw int64's, for bulk numeric work without a boxed Integer per element
+    class IntArray : public Value {
+    public:
+        static gc::ref<IntArray> create(Fiber &fbr, const int64_t *data, size_t size);
+
+        virtual size_t size() const = 0;
+
+        virtual const int64_t *data() const = 0;
+
+        static const Type &type();
+
+        static void init(Runtime &runtime);
+    };
+
+    //owner-only builder, conj appends in place until persistent freezes it
+    class TransientIntArray : public Value {
+    public:
+        static gc::ref<TransientIntArray> create(Fiber &fbr, gc::ref<IntArray> array);
+
+        virtual void conj(Fiber &fbr, int64_t val) = 0;
+
+        virtual gc::ref<IntArray> persistent(Fiber &fbr) = 0;
+    };
+
+}
+
+#endif
@@ -19,6 +19,7 @@
 
 
 #include "integer.h"
+#include "float.h"
 #include "frame.h"
 #include "type.h"
 #include "visitor.h"
@@ -29,6 +30,8 @@ class IntegerImpl :  public ValueImpl<Integer, IntegerImpl>
 {
 	int64_t v;
 
+    friend class Integer;
+
     static gc::ref<Value> EQUALS;
     static gc::ref<Value> ADD;
     static gc::ref<Value> SUBTRACT;
@@ -51,7 +54,12 @@ public:
 
     const bool map_key_equals(Fiber &fbr, const Value &other) const override
     {
-    	return v == other.to_index(fbr);
+    	if (&other.get_type() == &Float::type()) {
+    		//see FloatImpl::map_key_hash
+    		auto d = Float::value(other);
+    		return Float::is_int64(d) && static_cast<int64_t>(d) == v;
+    	}
+    	return &other.get_type() == TYPE.get() && v == static_cast<const IntegerImpl &>(other).v;
     }
 
     void repr(Fiber &fbr, std::ostream &out) const override {
@@ -178,7 +186,35 @@ public:
     }
 
     static int64_t _subtract_int64_boxed(Fiber &fbr, const AST::Apply &apply) {
-        throw std::runtime_error("TODO _subtract_int64_boxed");
+        Frame frame(fbr, apply);
+
+        if(apply.argument_count() != 2) {
+            return frame.bad_dispatch();
+        }
+
+        auto &c = frame.argument_(0);
+
+        if(!(c.is_ref() && c.ref() == SUBTRACT.get())) {
+            return frame.bad_dispatch();
+        }
+
+        auto &a = frame.argument_(1);
+        auto &b = frame.argument_(2);
+
+        if(!a.is_int64()) {
+            return frame.bad_dispatch();
+        }
+
+        if(!(b.is_ref() && &b.ref()->get_type() == IntegerImpl::TYPE.get())) {
+            return frame.bad_dispatch();
+        }
+
+        auto b_ = static_cast<const IntegerImpl *>(b.ref());
+
+        frame.stack.pop(3);
+        frame.stack.push<int64_t>(a.int64() - b_->v);
+
+        return 0;
     }
 
     static int64_t _subtract_int64_t(Fiber &fbr, const AST::Apply &apply) {
@@ -307,8 +343,17 @@ const Type &Integer::type() {
     return *IntegerImpl::TYPE;
 }
 
+int64_t Integer::value(const Value &integer) {
+    assert(&integer.get_type() == IntegerImpl::TYPE.get());
+    return static_cast<const IntegerImpl &>(integer).v;
+}
+
 gc::ref<Integer> Integer::create(Fiber &fbr, int64_t i) {
 	return gc::make_ref<IntegerImpl>(fbr.allocator(), i);
 }
 
+gc::ref<Integer> Integer::create(gc::allocator_t &allocator, int64_t i) {
+	return gc::make_ref<IntegerImpl>(allocator, i);
+}
+
 }
\ No newline at end of file
@@ -27,10 +27,14 @@ namespace park {
     class Integer : public Value {
     public:
     	static gc::ref<Integer> create(Fiber &fbr, int64_t i);
+    	static gc::ref<Integer> create(gc::allocator_t &allocator, int64_t i);
 
         static void init(Runtime &runtime);
 
         static const Type &type();
+
+        //the value of a boxed integer
+        static int64_t value(const Value &integer);
     };
 
 }
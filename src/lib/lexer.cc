@@ -108,12 +108,13 @@ namespace park {
 
             //reserved names
             rules.push(
-                    "let|import|from|const|struct|function|if|else|return|recurs|true|false|=>|in|==|!=|&&|\\?|\\|\\||\\{|\\}|\\(|\\)|\\[|\\]|!|=|,|:|\\-|\\+|\\*|\\<|\\>|\\x25",
+                    "let|import|from|const|struct|function|if|else|return|recurs|true|false|=>|in|==|!=|&&|\\?|\\|\\||#\\{|\\{|\\}|\\(|\\)|\\[|\\]|!|=|,|:|\\-|\\+|\\*|\\<|\\>|\\x25",
                     1); //reserved names, operators, punctuation etc
 
             rules.push("$[a-zA-Z_]\\w*", 6); //keyword 
             rules.push("[a-zA-Z_]\\w*", 2); //identifier
             rules.push("[1-9][0-9]*|0", 3); //integer literal
+            rules.push("([1-9][0-9]*|0)\\.[0-9]+([eE][\\-+]?[0-9]+)?", 7); //float literal
 
             // string literals
             rules.push("'.*?'", 5);
@@ -138,6 +139,7 @@ namespace park {
             translate["["] = "lbrack";
             translate["]"] = "rbrack";
             translate["{"] = "lbrace";
+            translate["#{"] = "hash_lbrace";
             translate["}"] = "rbrace";
             translate["=="] = "double_equals";
             translate["!="] = "not_equals";
@@ -215,6 +217,12 @@ namespace park {
                                     String::create(fbr, "integer_literal"))->
                                 assoc(fbr, String::create(fbr, "value"),
                                     String::create(fbr, self->results_.str()));
+                    } else if (self->results_.id == 7) { //float literal
+                        return m->
+                                assoc(fbr, String::create(fbr, "token"),
+                                    String::create(fbr, "float_literal"))->
+                                assoc(fbr, String::create(fbr, "value"),
+                                    String::create(fbr, self->results_.str()));
                     } else if (self->results_.id == 5) { //string literal
                         std::vector<char> buff;
                         bool escape = false;
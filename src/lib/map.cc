@@ -18,11 +18,12 @@
  */
 
 #include "map.h"
-#include "vector.h"
+#include "set.h"
 #include "builtin.h"
 #include "type.h"
 #include "visitor.h"
 
+#include <atomic>
 #include <bitset>
 
 namespace park {
@@ -43,6 +44,9 @@ uint32_t map_bitpos(size_t hash, size_t shift) {
     return 1u << map_mask(hash, shift);
 }
 
+//edit tokens of transients, 0 is the edit of persistent nodes which are never mutated
+static std::atomic<uint64_t> next_edit(1);
+
 class Node : public gc::collectable {
 public:
 
@@ -50,80 +54,119 @@ public:
     using find_ret_t = std::optional<gc::ref<Node>>;
 
     virtual assoc_ret_t
-    assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const = 0;
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const = 0;
 
     virtual find_ret_t 
     find(Fiber &fbr, size_t hash, const Value &key) const = 0;
 
-    virtual void 
-    iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> value)> f) const = 0;
-
     virtual size_t get_hash() const = 0;
+
+    //the number of leafs below and including this node
+    virtual size_t count() const = 0;
+
+    //the children in iteration order, for MapCursor
+    virtual size_t arity() const = 0;
+
+    virtual const Node *child(size_t idx) const = 0;
+
+    virtual bool is_leaf() const {
+        return false;
+    }
+
+    virtual bool is_branch() const {
+        return false;
+    }
+
+    //the children of a branch by the 5 hash bits they are under, null where there is none
+    virtual void slots(gc::ref<Node> slots[]) const {
+        assert(false);
+    }
 };
 
+//a node may be changed in place by the transient that created it, as long as it is still private to the fiber
+inline bool editable(const gc::collectable *node, uint64_t node_edit, uint64_t edit) {
+    return edit != 0 && node_edit == edit && !gc::is_shared_ref(node);
+}
+
+//transient nodes get some room to grow in place, persistent nodes are allocated exactly
+inline size_t node_capacity(uint64_t edit, size_t size) {
+    return edit ? std::min<size_t>(31, std::max<size_t>(4, size * 2)) : size;
+}
 
 void insert_leaf_node_at_idx(Fiber &, const gc::ref<Node> nodes_src[], size_t src_size, gc::ref<Node> nodes_dst[], uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash);
 
+size_t count_leafs(const gc::ref<Node> nodes[], size_t size) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; i++) {
+        count += nodes[i]->count();
+    }
+    return count;
+}
+
 class FullNode : public Node {
     using full_nodes_t = std::array<gc::ref<Node>, 32>;
 
-    const full_nodes_t _nodes;
+    full_nodes_t _nodes;
+    size_t _count;
     const size_t _shift;
     const size_t _hash;
+    const uint64_t _edit;
 
 public:
-    FullNode(const gc::ref<Node> nodes[], size_t size, size_t shift)
-        : _shift(shift), _hash(nodes[0]->get_hash()) {
+    FullNode(uint64_t edit, const gc::ref<Node> nodes[], size_t size, size_t shift)
+        : _count(count_leafs(nodes, size)), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit) {
         assert(size == 32);
-        auto &__nodes = const_cast<full_nodes_t &>(_nodes);
-        std::copy_n(nodes, 32, __nodes.begin());
+        std::copy_n(nodes, 32, _nodes.begin());
     }
 
-    FullNode(const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Node> n)
-        : _shift(shift), _hash(nodes[0]->get_hash())
+    FullNode(uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Node> n)
+        : _count(count), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit)
     {
         assert(size == 32);
-        auto &__nodes = const_cast<full_nodes_t &>(_nodes);
-        std::copy_n(nodes, 32, __nodes.begin());
-        __nodes[idx] = n;
+        std::copy_n(nodes, 32, _nodes.begin());
+        _nodes[idx] = n;
     }
 
-     FullNode(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
-        : _shift(shift), _hash(nodes[0]->get_hash())
+     FullNode(Fiber & fbr, uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
+        : _count(count), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit)
     {
         assert(size == 31);
-        auto &__nodes = const_cast<full_nodes_t &>(_nodes);
-        insert_leaf_node_at_idx(fbr, nodes, size, __nodes.data(), idx, key, val, hash);
+        insert_leaf_node_at_idx(fbr, nodes, size, _nodes.data(), idx, key, val, hash);
     }
 
 
-    static gc::ref<FullNode> create(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, size_t shift)
+    static gc::ref<FullNode> create(Fiber & fbr, uint64_t edit, const gc::ref<Node> nodes[], size_t size, size_t shift)
     {
-        return gc::make_ref<FullNode>(fbr.allocator(), nodes, size, shift);        
+        return gc::make_ref<FullNode>(fbr.allocator(), edit, nodes, size, shift);        
     }
 
-    static gc::ref<FullNode> create(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Node> n)
+    static gc::ref<FullNode> create(Fiber & fbr, uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Node> n)
     {
-        return gc::make_ref<FullNode>(fbr.allocator(), nodes, size, shift, idx, n);
+        return gc::make_ref<FullNode>(fbr.allocator(), edit, count, nodes, size, shift, idx, n);
     }
 
-    static gc::ref<FullNode> create(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
+    static gc::ref<FullNode> create(Fiber & fbr, uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
     {
-        return gc::make_ref<FullNode>(fbr.allocator(), fbr, nodes, size, shift, idx, key, val, hash);
+        return gc::make_ref<FullNode>(fbr.allocator(), fbr, edit, count, nodes, size, shift, idx, key, val, hash);
     }   
 
 
     assoc_ret_t
-    assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
     {
         auto idx = map_mask(hash, _shift);
 
-        auto [n, leaf_added] = _nodes[idx]->assoc(fbr, _shift + 5, hash, key, val);
+        auto [n, leaf_added] = _nodes[idx]->assoc(fbr, edit, _shift + 5, hash, key, val);
 
-        if (n == _nodes[idx]) {
+        if (n == _nodes[idx] && !leaf_added) {
+            return {this, false};
+        } else if (editable(this, _edit, edit)) {
+            const_cast<FullNode *>(this)->_nodes[idx] = n;
+            const_cast<FullNode *>(this)->_count += leaf_added;
             return {this, leaf_added};
         } else {           
-            return {create(fbr, _nodes.data(), _nodes.size(), _shift, idx, n), leaf_added};
+            assert(!(n == _nodes[idx])); //a child is only edited in place below an editable parent
+            return {create(fbr, edit, _count + leaf_added, _nodes.data(), _nodes.size(), _shift, idx, n), leaf_added};
         }
     }
 
@@ -132,18 +175,30 @@ public:
         return _nodes[map_mask(hash, _shift)]->find(fbr, hash, key);
     }
 
-    void 
-    iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> value)> f) const override
-    {
-        for(auto &node : _nodes) {
-            node->iterate(f);
-        }
-    }
-
     size_t get_hash() const override {
         return _hash;
     }
 
+    size_t count() const override {
+        return _count;
+    }
+
+    size_t arity() const override {
+        return 32;
+    }
+
+    const Node *child(size_t idx) const override {
+        return _nodes[idx].get();
+    }
+
+    bool is_branch() const override {
+        return true;
+    }
+
+    void slots(gc::ref<Node> slots[]) const override {
+        std::copy_n(_nodes.begin(), 32, slots);
+    }
+
     void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
         for(auto &node : _nodes) {
             accept(node);
@@ -154,55 +209,67 @@ public:
 
 class BitmapIndexedNode : public Node {
 
-    const uint32_t _bitmap;
-    const size_t _size;
+    uint32_t _bitmap;
+    uint32_t _size;
+    const uint32_t _capacity;
+    size_t _count;
     const size_t _shift;
     const size_t _hash;
+    const uint64_t _edit;
 
     alignas(16)
     gc::ref<Node> _nodes[];
 
 public:
-    BitmapIndexedNode(const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift)
-            : _bitmap(bitmap), _size(size), _shift(shift), _hash(nodes[0]->get_hash()) {
-        assert(size > 0 && size <=31);
+    BitmapIndexedNode(uint64_t edit, size_t capacity, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift)
+            : _bitmap(bitmap), _size(size), _capacity(capacity), _count(count_leafs(nodes, size)), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit) {
+        assert(size > 0 && size <= capacity && capacity <= 31);
         std::copy_n(nodes, size, _nodes);
     }   
 
-    BitmapIndexedNode(const gc::ref<Node> nodes[], size_t size,  uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Node> n)
-        : _bitmap(bitmap), _size(size), _shift(shift), _hash(nodes[0]->get_hash())
+    BitmapIndexedNode(uint64_t edit, size_t capacity, size_t count, const gc::ref<Node> nodes[], size_t size,  uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Node> n)
+        : _bitmap(bitmap), _size(size), _capacity(capacity), _count(count), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit)
     {
-        assert(size > 0 && size <=31);
+        assert(size > 0 && size <= capacity && capacity <= 31);
         std::copy_n(nodes, size, _nodes);
         _nodes[idx] = n;
 //        assert(idx != 0); //otherwise we would need to get the hash here
     }
 
-    BitmapIndexedNode(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
-        : _bitmap(bitmap), _size(size + 1), _shift(shift), _hash(nodes[0]->get_hash())
+    BitmapIndexedNode(Fiber & fbr, uint64_t edit, size_t capacity, size_t count, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
+        : _bitmap(bitmap), _size(size + 1), _capacity(capacity), _count(count), _shift(shift), _hash(nodes[0]->get_hash()), _edit(edit)
     {
-        assert(size > 0 && size <=31);
+        assert(size > 0 && size < capacity && capacity <= 31);
         insert_leaf_node_at_idx(fbr, nodes, size, _nodes, idx, key, val, hash);
     }
          
     assoc_ret_t
-    static create(Fiber & fbr, gc::ref<Node> branch, size_t shift, gc::ref<Value> key, gc::ref<Value> val, size_t hash) {
-        auto new_node = gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), 1, &branch, 1, map_bitpos(branch->get_hash(), shift), shift);
-        return new_node->assoc(fbr, shift, hash, key, val);
+    static create(Fiber & fbr, uint64_t edit, gc::ref<Node> branch, size_t shift, gc::ref<Value> key, gc::ref<Value> val, size_t hash) {
+        auto capacity = node_capacity(edit, 1);
+        auto new_node = gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), capacity, edit, capacity, &branch, 1, map_bitpos(branch->get_hash(), shift), shift);
+        return new_node->assoc(fbr, edit, shift, hash, key, val);
+    }
+
+    static gc::ref<BitmapIndexedNode> create(Fiber & fbr, uint64_t edit, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift)
+    {
+        auto capacity = node_capacity(edit, size);
+        return gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), capacity, edit, capacity, nodes, size, bitmap, shift);
     }
 
-    static gc::ref<BitmapIndexedNode> create(Fiber & fbr, const gc::ref<Node> nodes[], size_t size,  uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Node> n)
+    static gc::ref<BitmapIndexedNode> create(Fiber & fbr, uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size,  uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Node> n)
     {
-        return gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), size, nodes, size, bitmap, shift, idx, n);
+        auto capacity = node_capacity(edit, size);
+        return gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), capacity, edit, capacity, count, nodes, size, bitmap, shift, idx, n);
     }
 
-    static gc::ref<BitmapIndexedNode> create(Fiber & fbr, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
+    static gc::ref<BitmapIndexedNode> create(Fiber & fbr, uint64_t edit, size_t count, const gc::ref<Node> nodes[], size_t size, uint32_t bitmap, size_t shift, uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
     {
-        return gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), size + 1, fbr, nodes, size, bitmap, shift, idx, key, val, hash);
+        auto capacity = node_capacity(edit, size + 1);
+        return gc::make_ref_fam<BitmapIndexedNode, gc::ref<Node>>(fbr.allocator(), capacity, fbr, edit, capacity, count, nodes, size, bitmap, shift, idx, key, val, hash);
     }
 
     assoc_ret_t
-    assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override;
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override;
 
     find_ret_t 
     find(Fiber &fbr, size_t hash, const Value &key) const override {
@@ -214,18 +281,32 @@ public:
         }
     }
 
-    void 
-    iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> value)> f) const override
-    {
-        for(auto i = 0; i < _size; i++) {
-            _nodes[i]->iterate(f);
-        }
-    }
-
     size_t get_hash() const override {
         return _hash;
     }
 
+    size_t count() const override {
+        return _count;
+    }
+
+    size_t arity() const override {
+        return _size;
+    }
+
+    const Node *child(size_t idx) const override {
+        return _nodes[idx].get();
+    }
+
+    bool is_branch() const override {
+        return true;
+    }
+
+    void slots(gc::ref<Node> slots[]) const override {
+        for (uint32_t i = 0, idx = 0; i < 32; i++) {
+            slots[i] = (_bitmap & (1u << i)) ? _nodes[idx++] : nullptr;
+        }
+    }
+
    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {  
         for(auto i = 0; i < _size; i++) {
             accept(_nodes[i]);
@@ -234,39 +315,24 @@ public:
 
 };
 
+//the leafs of sets only have a key, map entries extend it with a value
 class LeafNode : public Node {
 public:
 
     const size_t _hash;
     const gc::ref<Value> key_;
-    const gc::ref<Value> val_;
 
-    LeafNode(size_t hash, gc::ref<Value> key, gc::ref<Value> val)
-            : _hash(hash), key_(key), val_(val) {
+    LeafNode(size_t hash, gc::ref<Value> key)
+            : _hash(hash), key_(key) {
     }
 
-    assoc_ret_t
-    assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
-    {
-        if (hash == _hash) {
-            if (this->key_->map_key_equals(fbr, *key)) {
-                //replacing
-                return {gc::make_ref<LeafNode>(fbr.allocator(), hash, key, val), false};
-            } else {
-                //hash collision - same hash, different keys
-                /*
-                LeafNode newLeaf = new LeafNode(hash, key, val);
-                addedLeaf.val = newLeaf;
-                return new HashCollisionNode(hash, this, newLeaf);
-                */
-                std::cerr << "collision!!! in leafnode" << std::endl;
-                throw std::runtime_error("todo possible collision");
-            }
-        } else {
-            return BitmapIndexedNode::create(fbr, this, level_shift, key, val, hash);
-        }
+    virtual gc::ref<Value> value() const {
+        return nullptr;
     }
 
+    assoc_ret_t
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override;
+
     find_ret_t 
     find(Fiber &fbr, size_t hash, const Value &key) const override {
         if (hash == _hash && key_->map_key_equals(fbr, key)) {
@@ -276,58 +342,246 @@ public:
         }    
     }
 
-    void 
-    iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> value)> f) const override
+    size_t get_hash() const override {
+        return _hash;
+    }
+
+    size_t count() const override {
+        return 1;
+    }
+
+    size_t arity() const override {
+        return 0;
+    }
+
+    const Node *child(size_t idx) const override {
+        return nullptr;
+    }
+
+    bool is_leaf() const override {
+        return true;
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        accept(key_);
+    }
+
+};
+
+class EntryNode : public LeafNode {
+public:
+
+    const gc::ref<Value> val_;
+
+    EntryNode(size_t hash, gc::ref<Value> key, gc::ref<Value> val)
+            : LeafNode(hash, key), val_(val) {
+    }
+
+    gc::ref<Value> value() const override {
+        return val_;
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        accept(key_);
+        accept(val_);
+    }
+
+};
+
+//sets assoc their keys without a value
+static gc::ref<LeafNode> make_leaf(Fiber &fbr, size_t hash, gc::ref<Value> key, gc::ref<Value> val) {
+    if (val) {
+        return gc::make_ref<EntryNode>(fbr.allocator(), hash, key, val);
+    }
+    return gc::make_ref<LeafNode>(fbr.allocator(), hash, key);
+}
+
+/*
+ * Leafs of different keys with the same full hash. The leafs are kept in a list that is searched linearly, a node
+ * holds up to CAPACITY of them and continues in the next one. Collision nodes are never edited in place.
+ */
+class HashCollisionNode : public Node {
+
+    static const size_t CAPACITY = 32;
+
+    const size_t _hash;
+    const size_t _size;
+    const gc::ref<HashCollisionNode> _next;
+
+    alignas(16)
+    gc::ref<LeafNode> _leafs[];
+
+public:
+    HashCollisionNode(size_t hash, const gc::ref<LeafNode> leafs[], size_t size, gc::ref<HashCollisionNode> next)
+        : _hash(hash), _size(size), _next(next) {
+        assert(size > 0 && size <= CAPACITY);
+        std::copy_n(leafs, size, _leafs);
+    }
+
+    static gc::ref<HashCollisionNode> create(Fiber &fbr, size_t hash, const gc::ref<LeafNode> leafs[], size_t size, gc::ref<HashCollisionNode> next)
+    {
+        return gc::make_ref_fam<HashCollisionNode, gc::ref<LeafNode>>(fbr.allocator(), size, hash, leafs, size, next);
+    }
+
+    static gc::ref<HashCollisionNode> create(Fiber &fbr, size_t hash, gc::ref<LeafNode> leaf1, gc::ref<LeafNode> leaf2)
+    {
+        gc::ref<LeafNode> leafs[] = {leaf1, leaf2};
+        return create(fbr, hash, leafs, 2, nullptr);
+    }
+
+    assoc_ret_t
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
     {
-        f(key_, val_);
+        if (hash != _hash) {
+            return BitmapIndexedNode::create(fbr, edit, this, level_shift, key, val, hash);
+        }
+
+        gc::ref<LeafNode> leafs[CAPACITY + 1];
+        std::copy_n(_leafs, _size, leafs);
+
+        for (size_t i = 0; i < _size; i++) {
+            if (_leafs[i]->key_->map_key_equals(fbr, *key)) {
+                if (!val) {
+                    return {this, false};
+                }
+                leafs[i] = make_leaf(fbr, hash, key, val);
+                return {create(fbr, _hash, leafs, _size, _next), false};
+            }
+        }
+
+        if (_next) {
+            //this node is full, the key is either further down the list or gets added at its end
+            auto [next, leaf_added] = _next->assoc(fbr, edit, level_shift, hash, key, val);
+            if (next == _next) {
+                return {this, leaf_added};
+            }
+            return {create(fbr, _hash, leafs, _size, gc::ref_dynamic_cast<HashCollisionNode>(next)), leaf_added};
+        }
+
+        auto leaf = make_leaf(fbr, hash, key, val);
+        if (_size < CAPACITY) {
+            leafs[_size] = leaf;
+            return {create(fbr, _hash, leafs, _size + 1, nullptr), true};
+        }
+        return {create(fbr, _hash, leafs, _size, create(fbr, _hash, &leaf, 1, nullptr)), true};
     }
 
+    find_ret_t
+    find(Fiber &fbr, size_t hash, const Value &key) const override {
+        if (hash != _hash) {
+            return std::nullopt;
+        }
+        for (size_t i = 0; i < _size; i++) {
+            if (_leafs[i]->key_->map_key_equals(fbr, key)) {
+                return gc::ref<Node>(_leafs[i]);
+            }
+        }
+        if (_next) {
+            return _next->find(fbr, hash, key);
+        }
+        return std::nullopt;
+    }
 
     size_t get_hash() const override {
         return _hash;
     }
 
+    size_t count() const override {
+        return _next ? _size + _next->count() : _size;
+    }
+
+    //the leafs and then the rest of the list
+    size_t arity() const override {
+        return _next ? _size + 1 : _size;
+    }
+
+    const Node *child(size_t idx) const override {
+        if (idx < _size) {
+            return _leafs[idx].get();
+        }
+        return _next.get();
+    }
+
     void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
-        accept(key_);
-        accept(val_);
+        for (size_t i = 0; i < _size; i++) {
+            accept(_leafs[i]);
+        }
+        if (_next) {
+            accept(_next);
+        }
     }
 
 };
 
+Node::assoc_ret_t
+LeafNode::assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const
+{
+    if (hash == _hash) {
+        if (this->key_->map_key_equals(fbr, *key)) {
+            if (!val) {
+                //a set that already has the key
+                return {this, false};
+            }
+            //replacing
+            return {make_leaf(fbr, hash, key, val), false};
+        } else {
+            //hash collision - same hash, different keys
+            return {HashCollisionNode::create(fbr, hash, this, make_leaf(fbr, hash, key, val)), true};
+        }
+    } else {
+        return BitmapIndexedNode::create(fbr, edit, this, level_shift, key, val, hash);
+    }
+}
+
 void insert_leaf_node_at_idx(Fiber & fbr, const gc::ref<Node> nodes_src[], size_t src_size, gc::ref<Node> nodes_dst[], uint32_t idx, gc::ref<Value> key, gc::ref<Value> val, size_t hash)
 {
     std::copy_n(nodes_src, idx, nodes_dst);
 
-    nodes_dst[idx] = gc::make_ref<LeafNode>(fbr.allocator(), hash, key, val);
+    nodes_dst[idx] = make_leaf(fbr, hash, key, val);
 
     std::copy_n(nodes_src + idx, src_size - idx, nodes_dst + idx + 1);
 }
 
 
 Node::assoc_ret_t
-BitmapIndexedNode::assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const
+BitmapIndexedNode::assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const
 {
     auto bit = map_bitpos(hash, _shift);
 
     auto idx = map_index(_bitmap, bit);
 
     if (_bitmap & bit) {
-        auto [n, leaf_added] = _nodes[idx]->assoc(fbr, _shift + 5, hash, key, val);
+        auto [n, leaf_added] = _nodes[idx]->assoc(fbr, edit, _shift + 5, hash, key, val);
 
-        if (n == _nodes[idx]) {
+        if (n == _nodes[idx] && !leaf_added) {
+            return {this, false};
+        } else if (editable(this, _edit, edit)) {
+            const_cast<BitmapIndexedNode *>(this)->_nodes[idx] = n;
+            const_cast<BitmapIndexedNode *>(this)->_count += leaf_added;
             return {this, leaf_added};
         } else {
-            return {BitmapIndexedNode::create(fbr, _nodes, _size, _bitmap, _shift, idx, n), leaf_added};
+            assert(!(n == _nodes[idx])); //a child is only edited in place below an editable parent
+            return {BitmapIndexedNode::create(fbr, edit, _count + leaf_added, _nodes, _size, _bitmap, _shift, idx, n), leaf_added};
         }
     } else {
 
         auto new_bitmap = _bitmap | bit;
 
         if (new_bitmap == 0xffffffff) {
-            return {FullNode::create(fbr, _nodes, _size, _shift, idx, key, val, hash), true};
+            return {FullNode::create(fbr, edit, _count + 1, _nodes, _size, _shift, idx, key, val, hash), true};
+        }
+        else if (editable(this, _edit, edit) && _size < _capacity) {
+            //room left in the transient node, shift up and insert in place
+            auto self = const_cast<BitmapIndexedNode *>(this);
+            std::copy_backward(self->_nodes + idx, self->_nodes + _size, self->_nodes + _size + 1);
+            self->_nodes[idx] = make_leaf(fbr, hash, key, val);
+            self->_size += 1;
+            self->_count += 1;
+            self->_bitmap = new_bitmap;
+            return {this, true};
         }
         else {
-            return {BitmapIndexedNode::create(fbr, _nodes, _size, new_bitmap, _shift, idx, key, val, hash), true};
+            return {BitmapIndexedNode::create(fbr, edit, _count + 1, _nodes, _size, new_bitmap, _shift, idx, key, val, hash), true};
         }
     }
 }
@@ -338,9 +592,9 @@ BitmapIndexedNode::assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<V
 class EmptyNode : public Node {
 public:
     assoc_ret_t
-    assoc(Fiber & fbr, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
+    assoc(Fiber & fbr, uint64_t edit, size_t level_shift, size_t hash, gc::ref<Value> key, gc::ref<Value> val) const override
     {
-        auto leaf_added = gc::make_ref<LeafNode>(fbr.allocator(), hash, key, val);
+        auto leaf_added = make_leaf(fbr, hash, key, val);
         return {leaf_added, true};
     }
 
@@ -349,27 +603,232 @@ public:
         return std::nullopt;
     }
 
-    void 
-    iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> value)> f) const override
-    {
+    size_t get_hash() const override {
+        return 0;
     }
 
-    size_t get_hash() const override {
+    size_t count() const override {
         return 0;
     }
 
+    size_t arity() const override {
+        return 0;
+    }
+
+    const Node *child(size_t idx) const override {
+        return nullptr;
+    }
+
     void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}
 
 };
 
 
 
+/*
+ * Set algebra on two tries, the nodes at the same position below the roots are merged slot by slot. Where both
+ * sides hold the same node it is taken as is, and where one side has only a leaf or collision node its few keys
+ * are looked up in or added to the other side. Results share every node they do not change.
+ */
+enum class SetOp { UNION, INTERSECTION, DIFFERENCE };
+
+template<typename F>
+void for_each_leaf(const Node &node, F &&f) {
+    if (node.is_leaf()) {
+        f(static_cast<const LeafNode &>(node));
+        return;
+    }
+    for (size_t i = 0; i < node.arity(); i++) {
+        for_each_leaf(*node.child(i), f);
+    }
+}
+
+//a branch at shift with the given slots, a single leaf or collision node replaces its parent
+gc::ref<Node> make_branch(Fiber &fbr, const gc::ref<Node> slots[], size_t shift) {
+    gc::ref<Node> nodes[32];
+    uint32_t bitmap = 0;
+    size_t size = 0;
+    for (uint32_t i = 0; i < 32; i++) {
+        if (slots[i]) {
+            nodes[size++] = slots[i];
+            bitmap |= 1u << i;
+        }
+    }
+    if (size == 0) {
+        return nullptr;
+    }
+    if (size == 1 && !nodes[0]->is_branch()) {
+        return nodes[0];
+    }
+    if (size == 32) {
+        return FullNode::create(fbr, 0, nodes, size, shift);
+    }
+    return BitmapIndexedNode::create(fbr, 0, nodes, size, bitmap, shift);
+}
+
+gc::ref<Node> insert_leaf(Fiber &fbr, gc::ref<Node> node, size_t shift, const LeafNode &leaf) {
+    if (!node) {
+        return gc::ref<Node>(&leaf);
+    }
+    return std::get<0>(node->assoc(fbr, 0, shift, leaf._hash, leaf.key_, nullptr));
+}
+
+//the keys of node that are in other when keep, or that are not, and how many were in other
+std::tuple<gc::ref<Node>, size_t> select(Fiber &fbr, gc::ref<Node> node, const Node &other, bool keep, size_t shift) {
+    gc::ref<Node> ret;
+    size_t found = 0;
+    size_t dropped = 0;
+    for_each_leaf(*node, [&](const LeafNode &leaf) {
+        auto in_other = other.find(fbr, leaf._hash, *leaf.key_).has_value();
+        found += in_other;
+        if (in_other == keep) {
+            ret = insert_leaf(fbr, ret, shift, leaf);
+        }
+        else {
+            dropped++;
+        }
+    });
+    return {dropped ? ret : node, found};
+}
+
+std::tuple<gc::ref<Node>, bool> without(Fiber &fbr, gc::ref<Node> node, size_t shift, const LeafNode &leaf) {
+    if (!node || !node->find(fbr, leaf._hash, *leaf.key_)) {
+        return {node, false};
+    }
+    if (node->is_branch()) {
+        gc::ref<Node> slots[32];
+        node->slots(slots);
+        auto idx = map_mask(leaf._hash, shift);
+        slots[idx] = std::get<0>(without(fbr, slots[idx], shift + 5, leaf));
+        return {make_branch(fbr, slots, shift), true};
+    }
+    return {std::get<0>(select(fbr, node, leaf, false, shift)), true};
+}
+
+//the merged node, null when it is empty, and the number of keys that are in both a and b
+std::tuple<gc::ref<Node>, size_t> merge(Fiber &fbr, SetOp op, gc::ref<Node> a, gc::ref<Node> b, size_t shift) {
+    if (a == b) {
+        return {op == SetOp::DIFFERENCE ? nullptr : a, a ? a->count() : 0};
+    }
+    if (!a || !b) {
+        return {op == SetOp::UNION ? (a ? a : b) : (op == SetOp::DIFFERENCE ? a : nullptr), 0};
+    }
+
+    if (a->is_branch() && b->is_branch()) {
+        gc::ref<Node> a_slots[32];
+        gc::ref<Node> b_slots[32];
+        gc::ref<Node> slots[32];
+        a->slots(a_slots);
+        b->slots(b_slots);
+        size_t found = 0;
+        bool same_a = true;
+        bool same_b = true;
+        for (size_t i = 0; i < 32; i++) {
+            auto [node, node_found] = merge(fbr, op, a_slots[i], b_slots[i], shift + 5);
+            slots[i] = node;
+            found += node_found;
+            same_a = same_a && node == a_slots[i];
+            same_b = same_b && node == b_slots[i];
+        }
+        if (same_a) {
+            return {a, found};
+        }
+        if (same_b) {
+            return {b, found};
+        }
+        return {make_branch(fbr, slots, shift), found};
+    }
+
+    switch (op) {
+        case SetOp::UNION: {
+            //add the keys of the leaf or collision node to the other side
+            auto [into, from] = a->is_branch() ? std::make_tuple(a, b) : std::make_tuple(b, a);
+            auto ret = into;
+            size_t found = 0;
+            for_each_leaf(*from, [&](const LeafNode &leaf) {
+                if (into->find(fbr, leaf._hash, *leaf.key_)) {
+                    found++;
+                }
+                else {
+                    ret = insert_leaf(fbr, ret, shift, leaf);
+                }
+            });
+            return {ret, found};
+        }
+        case SetOp::INTERSECTION: {
+            if (a->is_branch()) {
+                return select(fbr, b, *a, true, shift);
+            }
+            return select(fbr, a, *b, true, shift);
+        }
+        case SetOp::DIFFERENCE: {
+            if (a->is_branch()) {
+                auto ret = a;
+                size_t found = 0;
+                for_each_leaf(*b, [&](const LeafNode &leaf) {
+                    auto [node, removed] = without(fbr, ret, shift, leaf);
+                    ret = node;
+                    found += removed;
+                });
+                return {ret, found};
+            }
+            return select(fbr, a, *b, false, shift);
+        }
+    }
+    assert(false);
+    return {nullptr, 0};
+}
 
 } //map impl
 
 
 using namespace mapimpl;
 
+MapCursor::MapCursor(const Node &root) {
+    if (root.is_leaf()) {
+        leaf_ = static_cast<const LeafNode *>(&root);
+    }
+    else {
+        nodes_[0] = &root;
+        indexes_[0] = 0;
+        depth_ = 1;
+        next();
+    }
+}
+
+gc::ref<Value> MapCursor::key() const {
+    return leaf_->key_;
+}
+
+gc::ref<Value> MapCursor::value() const {
+    return leaf_->value();
+}
+
+void MapCursor::next() {
+    leaf_ = nullptr;
+    while (depth_ > 0) {
+        auto node = nodes_[depth_ - 1];
+        auto idx = indexes_[depth_ - 1]++;
+        if (idx >= node->arity()) {
+            depth_--;
+            continue;
+        }
+        if (idx + 1 == node->arity()) {
+            //no need to come back to a node after its last child
+            depth_--;
+        }
+        auto child = node->child(idx);
+        if (child->is_leaf()) {
+            leaf_ = static_cast<const LeafNode *>(child);
+            return;
+        }
+        assert(depth_ < MAX_DEPTH);
+        nodes_[depth_] = child;
+        indexes_[depth_] = 0;
+        depth_++;
+    }
+}
+
 class MapImpl : public ValueImpl<Map, MapImpl>  {
 
     static gc::ref<MapImpl> EMPTY;
@@ -379,10 +838,14 @@ class MapImpl : public ValueImpl<Map, MapImpl>  {
     static gc::ref<Value> GET;
     static gc::ref<Value> ITERATOR;
     static gc::ref<Value> CONTAINS;
+    static gc::ref<Value> TRANSIENT;
 
     const size_t count_;
     const gc::ref<Node> root_;
 
+    friend class TransientMapImpl;
+    friend class park::MapCursor;
+
 public:
     MapImpl(size_t count, gc::ref<Node> root)
          : count_(count), root_(root) {}
@@ -397,7 +860,7 @@ public:
 
     gc::ref<Map> assoc(Fiber & fbr, gc::ref<Value> key, gc::ref<Value> val) const override {
         size_t hash = key->map_key_hash(fbr);
-        auto [new_root, leaf_added] = root_->assoc(fbr, 0, hash, key, val);
+        auto [new_root, leaf_added] = root_->assoc(fbr, 0, 0, hash, key, val);
         if (new_root == root_) {
             return this;
         } else {
@@ -409,28 +872,24 @@ public:
         size_t hash = key.map_key_hash(fbr);
         if (auto found = root_->find(fbr, hash, key)) {
             auto node = gc::ref_dynamic_cast<LeafNode>(*found);
-            return node->val_;
+            return node->value();
         } else {
             return std::nullopt;
         }
     }
 
-    void iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> val)> f) const override {
-        root_->iterate(f);
-    }
-
     void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
         accept(root_);
     }
 
     void repr(Fiber &fbr, std::ostream &out) const override {
         out << "{";
-        iterate([&](gc::ref<Value> key, gc::ref<Value> val) {
-            key->repr(fbr, out);
+        for (MapCursor cursor(*root_); cursor; cursor.next()) {
+            cursor.key()->repr(fbr, out);
             out << ": ";
-            val->repr(fbr, out);
+            cursor.value()->repr(fbr, out);
             out << ", ";
-        });
+        }
         out << "}";
     }
 
@@ -514,27 +973,7 @@ public:
         throw Error::key_not_found(fbr, *key);
     }
 
-    static int64_t _iterator(Fiber &fbr, const AST::Apply &apply) {
-        Frame frame(fbr, apply);
-
-        gc::ref<MapImpl> self;
-
-        auto checked = frame.check().
-            single_dispatch(*ITERATOR, *TYPE).
-            argument_count(1).
-            argument<MapImpl>(1, self);
-
-        if(!checked) {
-            return checked.result();
-        }
-
-        auto keys = Vector::create(fbr);
-        self->root_->iterate([&](gc::ref<Value> key, gc::ref<Value> value) {
-            keys = keys->conj(fbr, key); 
-        });
- 
-        return frame.result<Value>(keys);
-    }
+    static int64_t _iterator(Fiber &fbr, const AST::Apply &apply);
 
     static int64_t _contains(Fiber &fbr, const AST::Apply &apply) {
         Frame frame(fbr, apply);
@@ -560,6 +999,8 @@ public:
         }
     }
 
+    static int64_t _transient(Fiber &fbr, const AST::Apply &apply);
+
     static gc::ref<Map> create() {
         return EMPTY;
     }
@@ -584,6 +1025,9 @@ public:
         CONTAINS = runtime.builtin("contains");
         runtime.register_method(CONTAINS, *TYPE, _contains);
 
+        TRANSIENT = runtime.builtin("transient");
+        runtime.register_method(TRANSIENT, *TYPE, _transient);
+
         EMPTY = runtime.create_root<MapImpl>([&](gc::allocator_t &allocator) {
             return gc::make_shared_ref<MapImpl>(allocator, 0, gc::make_shared_ref<EmptyNode>(allocator));
         });
@@ -598,13 +1042,792 @@ gc::ref<Value> MapImpl::LENGTH;
 gc::ref<Value> MapImpl::GET;
 gc::ref<Value> MapImpl::ITERATOR;
 gc::ref<Value> MapImpl::CONTAINS;
+gc::ref<Value> MapImpl::TRANSIENT;
 
-void Map::init(Runtime &runtime) {
-    MapImpl::init(runtime);
-}
+class TransientMapImpl : public ValueImpl<TransientMap, TransientMapImpl>  {
 
-gc::ref<Map> Map::create(Fiber &fbr) {
-    return MapImpl::create();
+    static gc::ref<Value> ASSOC;
+    static gc::ref<Value> LENGTH;
+    static gc::ref<Value> GET;
+    static gc::ref<Value> CONTAINS;
+    static gc::ref<Value> PERSISTENT;
+
+    uint64_t edit_;
+    uint64_t barrier_epoch_;
+    size_t count_;
+    gc::ref<Node> root_;
+
+public:
+    TransientMapImpl(uint64_t edit, size_t count, gc::ref<Node> root)
+         : edit_(edit), barrier_epoch_(0), count_(count), root_(root) {}
+
+    static gc::ref<TransientMapImpl> create(Fiber &fbr, gc::ref<MapImpl> map) {
+        return gc::make_ref<TransientMapImpl>(fbr.allocator(), next_edit++, map->count_, map->root_);
+    }
+
+    void ensure_editable(Fiber &fbr) const {
+        //the transient itself is private to its fiber, unless it was shared after which it can no longer be mutated
+        if (edit_ == 0 || gc::is_shared_ref(this)) {
+            throw Error::transient_not_editable(fbr, *this);
+        }
+    }
+
+    void assoc(Fiber &fbr, gc::ref<Value> key, gc::ref<Value> val) override {
+        ensure_editable(fbr);
+        //the collector may be walking our nodes, copy them instead. the new edit keeps the nodes we
+        //can no longer change from being edited afterwards, so that an editable node (and its count)
+        //only ever sits below editable nodes
+        auto edit = edit_;
+        if (gc::private_write(fbr.allocator(), this, barrier_epoch_)) {
+            edit_ = next_edit++;
+            edit = 0;
+        }
+        size_t hash = key->map_key_hash(fbr);
+        auto [new_root, leaf_added] = root_->assoc(fbr, edit, 0, hash, key, val);
+        root_ = new_root;
+        if (leaf_added) {
+            count_ += 1;
+        }
+    }
+
+    gc::ref<Map> persistent(Fiber &fbr) override {
+        ensure_editable(fbr);
+        //nodes keep the edit of this transient, but nothing will use it anymore
+        edit_ = 0;
+        if (count_ == 0) {
+            return MapImpl::create();
+        }
+        return gc::make_ref<MapImpl>(fbr.allocator(), count_, root_);
+    }
+
+    std::optional<gc::ref<Value>> get(Fiber &fbr, const Value &key) const {
+        ensure_editable(fbr);
+        size_t hash = key.map_key_hash(fbr);
+        if (auto found = root_->find(fbr, hash, key)) {
+            return gc::ref_dynamic_cast<LeafNode>(*found)->value();
+        } else {
+            return std::nullopt;
+        }
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        accept(root_);
+    }
+
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        out << "(transient map)";
+    }
+
+    static int64_t _assoc(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientMapImpl> self;
+        gc::ref<Value> key;
+        gc::ref<Value> val;
+
+        auto checked = frame.check().
+            single_dispatch(*ASSOC, *TYPE).
+            argument_count(3).
+            argument<TransientMapImpl>(1, self).
+            argument<Value>(2, key).
+            argument<Value>(3, val);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        self.mutate()->assoc(fbr, key, val);
+
+        return frame.result<Value>(self);
+    }
+
+    static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientMapImpl> self;
+
+        auto checked = frame.check().
+            single_dispatch(*LENGTH, *TYPE).
+            argument_count(1).
+            argument<TransientMapImpl>(1, self);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        self->ensure_editable(fbr);
+
+        return frame.result<int64_t>(self->count_);
+    }
+
+    static int64_t _get(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientMapImpl> self;
+        gc::ref<Value> key;
+        gc::ref<Value> default_value;
+
+        auto checked = frame.check().
+            single_dispatch(*GET, *TYPE).
+            argument_count(2, 3).
+            argument<TransientMapImpl>(1, self).
+            argument<Value>(2, key).
+            optional_argument<Value>(3, default_value);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        if (auto found = self->get(fbr, *key)) {
+            return frame.result<Value>(*found);
+        } 
+        else if(default_value) {
+            return frame.result<Value>(default_value);
+        }
+
+        throw Error::key_not_found(fbr, *key);
+    }
+
+    static int64_t _contains(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientMapImpl> self;
+        gc::ref<Value> key;
+
+        auto checked = frame.check().
+            single_dispatch(*CONTAINS, *TYPE).
+            argument_count(2).
+            argument<TransientMapImpl>(1, self).
+            argument<Value>(2, key);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<bool>(self->get(fbr, *key).has_value());
+    }
+
+    static int64_t _persistent(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientMapImpl> self;
+
+        auto checked = frame.check().
+            single_dispatch(*PERSISTENT, *TYPE).
+            argument_count(1).
+            argument<TransientMapImpl>(1, self);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<Value>(self.mutate()->persistent(fbr));
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("TransientMap");
+
+        ASSOC = runtime.builtin("assoc");
+        runtime.register_method(ASSOC, *TYPE, _assoc);
+
+        LENGTH = runtime.builtin("length");
+        runtime.register_method(LENGTH, *TYPE, _length);
+
+        GET = runtime.builtin("get");
+        runtime.register_method(GET, *TYPE, _get);
+
+        CONTAINS = runtime.builtin("contains");
+        runtime.register_method(CONTAINS, *TYPE, _contains);
+
+        PERSISTENT = runtime.builtin("persistent");
+        runtime.register_method(PERSISTENT, *TYPE, _persistent);
+    }
+
+};
+
+gc::ref<Value> TransientMapImpl::ASSOC;
+gc::ref<Value> TransientMapImpl::LENGTH;
+gc::ref<Value> TransientMapImpl::GET;
+gc::ref<Value> TransientMapImpl::CONTAINS;
+gc::ref<Value> TransientMapImpl::PERSISTENT;
+
+int64_t MapImpl::_transient(Fiber &fbr, const AST::Apply &apply) {
+    Frame frame(fbr, apply);
+
+    gc::ref<MapImpl> self;
+
+    auto checked = frame.check().
+        single_dispatch(*TRANSIENT, *TYPE).
+        argument_count(1).
+        argument<MapImpl>(1, self);
+
+    if(!checked) {
+        return checked.result();
+    }
+
+    return frame.result<Value>(TransientMapImpl::create(fbr, self));
+}
+
+MapCursor::MapCursor(const Map &map) : MapCursor(*static_cast<const MapImpl &>(map).root_) {}
+
+class SetImpl : public ValueImpl<Set, SetImpl> {
+
+    static gc::ref<SetImpl> EMPTY;
+    static gc::ref<Value> SET;
+    static gc::ref<Value> CONJ;
+    static gc::ref<Value> LENGTH;
+    static gc::ref<Value> CONTAINS;
+    static gc::ref<Value> ITERATOR;
+    static gc::ref<Value> TRANSIENT;
+    static gc::ref<Value> UNION;
+    static gc::ref<Value> INTERSECTION;
+    static gc::ref<Value> DIFFERENCE;
+
+    const size_t count_;
+    const gc::ref<Node> root_;
+
+    friend class TransientSetImpl;
+    friend class park::MapCursor;
+
+public:
+    SetImpl(size_t count, gc::ref<Node> root)
+         : count_(count), root_(root) {}
+
+    size_t size() const override {
+        return count_;
+    }
+
+    const Value &accept(Fiber &fbr, Visitor &visitor) const override {
+        return visitor.visit(fbr, *this);
+    }
+
+    gc::ref<Set> conj(Fiber &fbr, gc::ref<Value> key) const override {
+        size_t hash = key->map_key_hash(fbr);
+        auto [new_root, leaf_added] = root_->assoc(fbr, 0, 0, hash, key, nullptr);
+        if (new_root == root_) {
+            return this;
+        } else {
+            return gc::make_ref<SetImpl>(fbr.allocator(), leaf_added ? count_ + 1 : count_, new_root);
+        }
+    }
+
+    bool contains(Fiber &fbr, const Value &key) const override {
+        return root_->find(fbr, key.map_key_hash(fbr), key).has_value();
+    }
+
+    gc::ref<Set> merge(Fiber &fbr, SetOp op, const SetImpl &other) const {
+        auto [root, found] = mapimpl::merge(fbr, op, count_ ? root_ : nullptr, other.count_ ? other.root_ : nullptr, 0);
+        if (!root) {
+            return EMPTY;
+        } else if (root == root_) {
+            return this;
+        } else if (root == other.root_) {
+            return &other;
+        }
+        switch (op) {
+            case SetOp::UNION:
+                return gc::make_ref<SetImpl>(fbr.allocator(), count_ + other.count_ - found, root);
+            case SetOp::INTERSECTION:
+                return gc::make_ref<SetImpl>(fbr.allocator(), found, root);
+            case SetOp::DIFFERENCE:
+                return gc::make_ref<SetImpl>(fbr.allocator(), count_ - found, root);
+        }
+        assert(false);
+        return EMPTY;
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        accept(root_);
+    }
+
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        out << "#{";
+        for (MapCursor cursor(*root_); cursor; cursor.next()) {
+            cursor.key()->repr(fbr, out);
+            out << ", ";
+        }
+        out << "}";
+    }
+
+    static int64_t _set(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        auto checked = frame.check().
+            static_dispatch(*SET).
+            argument_count(0);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<Value>(EMPTY);
+    }
+
+    static int64_t _conj(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<SetImpl> self;
+        gc::ref<Value> key;
+
+        auto checked = frame.check().
+            single_dispatch(*CONJ, *TYPE).
+            argument_count(2).
+            argument<SetImpl>(1, self).
+            argument<Value>(2, key);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<Value>(self->conj(fbr, key));
+    }
+
+    static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<SetImpl> self;
+
+        auto checked = frame.check().
+            single_dispatch(*LENGTH, *TYPE).
+            argument_count(1).
+            argument<SetImpl>(1, self);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<int64_t>(self->count_);
+    }
+
+    static int64_t _contains(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<SetImpl> self;
+        gc::ref<Value> key;
+
+        auto checked = frame.check().
+            single_dispatch(*CONTAINS, *TYPE).
+            argument_count(2).
+            argument<SetImpl>(1, self).
+            argument<Value>(2, key);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<bool>(self->contains(fbr, *key));
+    }
+
+    static int64_t _iterator(Fiber &fbr, const AST::Apply &apply);
+
+    static int64_t _transient(Fiber &fbr, const AST::Apply &apply);
+
+    template<gc::ref<Value> &BUILTIN, SetOp OP>
+    static int64_t _merge(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<SetImpl> self;
+        gc::ref<SetImpl> other;
+
+        auto checked = frame.check().
+            single_dispatch(*BUILTIN, *TYPE).
+            argument_count(2).
+            argument<SetImpl>(1, self).
+            argument<SetImpl>(2, other);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<Value>(self->merge(fbr, OP, *other));
+    }
+
+    static gc::ref<Set> create() {
+        return EMPTY;
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("Set");
+
+        SET = runtime.create_builtin<BuiltinStaticDispatch>("set", _set);
+
+        CONJ = runtime.builtin("conj");
+        runtime.register_method(CONJ, *TYPE, _conj);
+
+        LENGTH = runtime.builtin("length");
+        runtime.register_method(LENGTH, *TYPE, _length);
+
+        CONTAINS = runtime.builtin("contains");
+        runtime.register_method(CONTAINS, *TYPE, _contains);
+
+        ITERATOR = runtime.builtin("iterator");
+        runtime.register_method(ITERATOR, *TYPE, _iterator);
+
+        TRANSIENT = runtime.builtin("transient");
+        runtime.register_method(TRANSIENT, *TYPE, _transient);
+
+        UNION = runtime.builtin("union");
+        runtime.register_method(UNION, *TYPE, _merge<UNION, SetOp::UNION>);
+
+        INTERSECTION = runtime.builtin("intersection");
+        runtime.register_method(INTERSECTION, *TYPE, _merge<INTERSECTION, SetOp::INTERSECTION>);
+
+        DIFFERENCE = runtime.builtin("difference");
+        runtime.register_method(DIFFERENCE, *TYPE, _merge<DIFFERENCE, SetOp::DIFFERENCE>);
+
+        EMPTY = runtime.create_root<SetImpl>([&](gc::allocator_t &allocator) {
+            return gc::make_shared_ref<SetImpl>(allocator, 0, gc::make_shared_ref<EmptyNode>(allocator));
+        });
+    }
+
+};
+
+gc::ref<SetImpl> SetImpl::EMPTY;
+gc::ref<Value> SetImpl::SET;
+gc::ref<Value> SetImpl::CONJ;
+gc::ref<Value> SetImpl::LENGTH;
+gc::ref<Value> SetImpl::CONTAINS;
+gc::ref<Value> SetImpl::ITERATOR;
+gc::ref<Value> SetImpl::TRANSIENT;
+gc::ref<Value> SetImpl::UNION;
+gc::ref<Value> SetImpl::INTERSECTION;
+gc::ref<Value> SetImpl::DIFFERENCE;
+
+class TransientSetImpl : public ValueImpl<TransientSet, TransientSetImpl>  {
+
+    static gc::ref<Value> CONJ;
+    static gc::ref<Value> LENGTH;
+    static gc::ref<Value> CONTAINS;
+    static gc::ref<Value> PERSISTENT;
+
+    uint64_t edit_;
+    uint64_t barrier_epoch_;
+    size_t count_;
+    gc::ref<Node> root_;
+
+public:
+    TransientSetImpl(uint64_t edit, size_t count, gc::ref<Node> root)
+         : edit_(edit), barrier_epoch_(0), count_(count), root_(root) {}
+
+    static gc::ref<TransientSetImpl> create(Fiber &fbr, gc::ref<SetImpl> set) {
+        return gc::make_ref<TransientSetImpl>(fbr.allocator(), next_edit++, set->count_, set->root_);
+    }
+
+    void ensure_editable(Fiber &fbr) const {
+        if (edit_ == 0 || gc::is_shared_ref(this)) {
+            throw Error::transient_not_editable(fbr, *this);
+        }
+    }
+
+    void conj(Fiber &fbr, gc::ref<Value> key) override {
+        ensure_editable(fbr);
+        //the collector may be walking our nodes, copy them instead. the new edit keeps the nodes we
+        //can no longer change from being edited afterwards, so that an editable node (and its count)
+        //only ever sits below editable nodes
+        auto edit = edit_;
+        if (gc::private_write(fbr.allocator(), this, barrier_epoch_)) {
+            edit_ = next_edit++;
+            edit = 0;
+        }
+        size_t hash = key->map_key_hash(fbr);
+        auto [new_root, leaf_added] = root_->assoc(fbr, edit, 0, hash, key, nullptr);
+        root_ = new_root;
+        if (leaf_added) {
+            count_ += 1;
+        }
+    }
+
+    gc::ref<Set> persistent(Fiber &fbr) override {
+        ensure_editable(fbr);
+        edit_ = 0;
+        if (count_ == 0) {
+            return SetImpl::create();
+        }
+        return gc::make_ref<SetImpl>(fbr.allocator(), count_, root_);
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        accept(root_);
+    }
+
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        out << "(transient set)";
+    }
+
+    static int64_t _conj(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientSetImpl> self;
+        gc::ref<Value> key;
+
+        auto checked = frame.check().
+            single_dispatch(*CONJ, *TYPE).
+            argument_count(2).
+            argument<TransientSetImpl>(1, self).
+            argument<Value>(2, key);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        self.mutate()->conj(fbr, key);
+
+        return frame.result<Value>(self);
+    }
+
+    static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientSetImpl> self;
+
+        auto checked = frame.check().
+            single_dispatch(*LENGTH, *TYPE).
+            argument_count(1).
+            argument<TransientSetImpl>(1, self);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        self->ensure_editable(fbr);
+
+        return frame.result<int64_t>(self->count_);
+    }
+
+    static int64_t _contains(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientSetImpl> self;
+        gc::ref<Value> key;
+
+        auto checked = frame.check().
+            single_dispatch(*CONTAINS, *TYPE).
+            argument_count(2).
+            argument<TransientSetImpl>(1, self).
+            argument<Value>(2, key);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        self->ensure_editable(fbr);
+
+        return frame.result<bool>(self->root_->find(fbr, key->map_key_hash(fbr), *key).has_value());
+    }
+
+    static int64_t _persistent(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<TransientSetImpl> self;
+
+        auto checked = frame.check().
+            single_dispatch(*PERSISTENT, *TYPE).
+            argument_count(1).
+            argument<TransientSetImpl>(1, self);
+
+        if(!checked) {
+            return checked.result();
+        }
+
+        return frame.result<Value>(self.mutate()->persistent(fbr));
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("TransientSet");
+
+        CONJ = runtime.builtin("conj");
+        runtime.register_method(CONJ, *TYPE, _conj);
+
+        LENGTH = runtime.builtin("length");
+        runtime.register_method(LENGTH, *TYPE, _length);
+
+        CONTAINS = runtime.builtin("contains");
+        runtime.register_method(CONTAINS, *TYPE, _contains);
+
+        PERSISTENT = runtime.builtin("persistent");
+        runtime.register_method(PERSISTENT, *TYPE, _persistent);
+    }
+
+};
+
+gc::ref<Value> TransientSetImpl::CONJ;
+gc::ref<Value> TransientSetImpl::LENGTH;
+gc::ref<Value> TransientSetImpl::CONTAINS;
+gc::ref<Value> TransientSetImpl::PERSISTENT;
+
+int64_t SetImpl::_transient(Fiber &fbr, const AST::Apply &apply) {
+    Frame frame(fbr, apply);
+
+    gc::ref<SetImpl> self;
+
+    auto checked = frame.check().
+        single_dispatch(*TRANSIENT, *TYPE).
+        argument_count(1).
+        argument<SetImpl>(1, self);
+
+    if(!checked) {
+        return checked.result();
+    }
+
+    return frame.result<Value>(TransientSetImpl::create(fbr, self));
+}
+
+MapCursor::MapCursor(const Set &set) : MapCursor(*static_cast<const SetImpl &>(set).root_) {}
+
+class MapIterator : public Value {
+};
+
+//the keys of a map, each next copies the cursor into a new iterator
+class MapIteratorImpl : public ValueImpl<MapIterator, MapIteratorImpl> {
+
+    static gc::ref<Value> FIRST;
+    static gc::ref<Value> NEXT;
+
+    gc::ref<Node> nodes_[MapCursor::MAX_DEPTH];
+    size_t indexes_[MapCursor::MAX_DEPTH];
+    size_t depth_;
+    gc::ref<LeafNode> leaf_;
+
+public:
+    explicit MapIteratorImpl(const MapCursor &cursor)
+        : depth_(cursor.depth_), leaf_(cursor.leaf_) {
+        for (size_t i = 0; i < depth_; i++) {
+            nodes_[i] = cursor.nodes_[i];
+            indexes_[i] = cursor.indexes_[i];
+        }
+    }
+
+    MapCursor cursor() const {
+        MapCursor cursor;
+        for (size_t i = 0; i < depth_; i++) {
+            cursor.nodes_[i] = nodes_[i].get();
+            cursor.indexes_[i] = indexes_[i];
+        }
+        cursor.depth_ = depth_;
+        cursor.leaf_ = leaf_ ? leaf_.get() : nullptr;
+        return cursor;
+    }
+
+    bool to_bool(Fiber &fbr) const override {
+        return leaf_;
+    }
+
+    void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        for (size_t i = 0; i < depth_; i++) {
+            accept(nodes_[i]);
+        }
+        if (leaf_) {
+            accept(leaf_);
+        }
+    }
+
+    void repr(Fiber &fbr, std::ostream &out) const override {
+        out << "(map iterator)";
+    }
+
+    static int64_t _first(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<MapIteratorImpl> self;
+
+        return frame.check().
+            single_dispatch(*FIRST, *TYPE).
+            argument_count(1).
+            argument<MapIteratorImpl>(1, self).
+            result<Value>([&]() {
+                if (!self->leaf_) {
+                    throw std::runtime_error("end of map iterator");
+                }
+                return self->leaf_->key_;
+            });
+    }
+
+    static int64_t _next(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<MapIteratorImpl> self;
+
+        return frame.check().
+            single_dispatch(*NEXT, *TYPE).
+            argument_count(1).
+            argument<MapIteratorImpl>(1, self).
+            result<Value>([&]() {
+                if (!self->leaf_) {
+                    throw std::runtime_error("end of map iterator");
+                }
+                auto cursor = self->cursor();
+                cursor.next();
+                return gc::make_ref<MapIteratorImpl>(fbr.allocator(), cursor);
+            });
+    }
+
+    static void init(Runtime &runtime) {
+        TYPE = runtime.create_type("MapIterator");
+
+        FIRST = runtime.builtin("first");
+        runtime.register_method(FIRST, *TYPE, _first);
+
+        NEXT = runtime.builtin("next");
+        runtime.register_method(NEXT, *TYPE, _next);
+    }
+};
+
+gc::ref<Value> MapIteratorImpl::FIRST;
+gc::ref<Value> MapIteratorImpl::NEXT;
+
+int64_t MapImpl::_iterator(Fiber &fbr, const AST::Apply &apply) {
+    Frame frame(fbr, apply);
+
+    gc::ref<MapImpl> self;
+
+    return frame.check().
+        single_dispatch(*ITERATOR, *TYPE).
+        argument_count(1).
+        argument<MapImpl>(1, self).
+        result<Value>([&]() {
+            return gc::make_ref<MapIteratorImpl>(fbr.allocator(), MapCursor(*self->root_));
+        });
+}
+
+void Map::init(Runtime &runtime) {
+    MapImpl::init(runtime);
+    TransientMapImpl::init(runtime);
+    MapIteratorImpl::init(runtime);
+}
+
+int64_t SetImpl::_iterator(Fiber &fbr, const AST::Apply &apply) {
+    Frame frame(fbr, apply);
+
+    gc::ref<SetImpl> self;
+
+    return frame.check().
+        single_dispatch(*ITERATOR, *TYPE).
+        argument_count(1).
+        argument<SetImpl>(1, self).
+        result<Value>([&]() {
+            return gc::make_ref<MapIteratorImpl>(fbr.allocator(), MapCursor(*self->root_));
+        });
+}
+
+void Set::init(Runtime &runtime) {
+    SetImpl::init(runtime);
+    TransientSetImpl::init(runtime);
+}
+
+gc::ref<Map> Map::create(Fiber &fbr) {
+    return MapImpl::create();
+}
+
+gc::ref<TransientMap> TransientMap::create(Fiber &fbr, gc::ref<Map> map) {
+    return TransientMapImpl::create(fbr, gc::ref_dynamic_cast<MapImpl>(map));
+}
+
+gc::ref<Set> Set::create(Fiber &fbr) {
+    return SetImpl::create();
+}
+
+gc::ref<TransientSet> TransientSet::create(Fiber &fbr, gc::ref<Set> set) {
+    return TransientSetImpl::create(fbr, gc::ref_dynamic_cast<SetImpl>(set));
 }
 
 
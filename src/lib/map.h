@@ -38,7 +38,61 @@ namespace park {
 
         virtual size_t size() const = 0;
 
-        virtual void iterate(std::function<void(gc::ref<Value> key, gc::ref<Value> val)> f) const = 0;
+    };
+
+    class Set;
+
+    namespace mapimpl {
+        class Node;
+        class LeafNode;
+    }
+
+    /*
+     * Depth first walk over the entries of a map that allocates nothing. It holds plain pointers into the map, so
+     * it can not be kept across a checkpoint where the collector may move the nodes.
+     */
+    class MapCursor {
+    public:
+        explicit MapCursor(const Map &map);
+
+        explicit MapCursor(const mapimpl::Node &root);
+
+        //the keys of a set, their value is null
+        explicit MapCursor(const Set &set);
+
+        explicit operator bool() const {
+            return leaf_ != nullptr;
+        }
+
+        gc::ref<Value> key() const;
+
+        gc::ref<Value> value() const;
+
+        void next();
+
+    private:
+        //13 levels of 5 hash bits, the last child of a node replaces its parent so collision lists add nothing
+        static const size_t MAX_DEPTH = 16;
+
+        const mapimpl::Node *nodes_[MAX_DEPTH];
+        size_t indexes_[MAX_DEPTH];
+        size_t depth_ = 0;
+        const mapimpl::LeafNode *leaf_ = nullptr;
+
+        MapCursor() = default;
+
+        friend class MapIteratorImpl;
+    };
+
+    //owner-only builder, assoc mutates the nodes it created in place until persistent freezes it
+    class TransientMap : public Value {
+    public:
+
+        static gc::ref<TransientMap> create(Fiber &fbr, gc::ref<Map> map);
+
+        virtual void assoc(Fiber &fbr, gc::ref<Value> key, gc::ref<Value> val) = 0;
+
+        virtual gc::ref<Map> persistent(Fiber &fbr) = 0;
 
     };
 
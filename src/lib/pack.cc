@@ -118,10 +118,26 @@ namespace park {
 
             const Value &visit(Fiber &fbr, const Map &v) override {
                 write_map_header(v);
-                v.iterate([&fbr, this](gc::ref<Value> key, gc::ref<Value> value) {
-                    key->accept(fbr, *this);
-                    value->accept(fbr, *this);
-                });
+                for (MapCursor cursor(v); cursor; cursor.next()) {
+                    cursor.key()->accept(fbr, *this);
+                    cursor.value()->accept(fbr, *this);
+                }
+                return v;
+            }
+
+            //the keys as an array
+            const Value &visit(Fiber &fbr, const Set &v) override {
+                write_type(0xc7); //ext 8
+                write_type(0x00); //0 data len
+                write_type(0x03); //set type
+
+                write_type(0xdd); //array 32
+                int32_t len = len_from_size(v.size());
+                boost::endian::native_to_big_inplace(len);
+                os.write(reinterpret_cast<const char *>(&len), sizeof(len));
+                for (MapCursor cursor(v); cursor; cursor.next()) {
+                    cursor.key()->accept(fbr, *this);
+                }
                 return v;
             }
 
@@ -146,6 +162,19 @@ namespace park {
                 return v;
             }
 
+            const Value &visit(Fiber &fbr, const Float &v) override {
+                write_type(0xcb); //float 64
+
+                uint64_t vb;
+                auto const d = Float::value(v);
+                std::memcpy(&vb, &d, sizeof(vb));
+                boost::endian::native_to_big_inplace(vb);
+
+                os.write(reinterpret_cast<const char *>(&vb), sizeof(vb));
+
+                return v;
+            }
+
             const Value &visit(Fiber &fbr, const Atom &v) override {
                 write_type(0xc7); //ext 8
                 write_type(0x00); //0 data len
@@ -156,6 +185,19 @@ namespace park {
                 return v;
             }
 
+            //only the capacity, a cmap is packed as a const which starts out empty
+            const Value &visit(Fiber &fbr, const CMap &v) override {
+                write_type(0xc7); //ext 8
+                write_type(0x00); //0 data len
+                write_type(0x02); //cmap type
+
+                write_type(0xd3); //int 64
+                int64_t vb = boost::endian::native_to_big(static_cast<int64_t>(v.capacity()));
+                os.write(reinterpret_cast<const char *>(&vb), sizeof(vb));
+
+                return v;
+            }
+
             const Value &visit(Fiber &fbr, const String &v) override {
                 auto s = v.to_string(fbr);
 
@@ -191,32 +233,33 @@ namespace park {
 
                 if(in_data_) {
                     //data map, keys can be anything
-                    v.iterate([&](gc::ref<Value> key, gc::ref<Value> value) {
-                        key->accept(fbr, *this);
-                        value->accept(fbr, *this);
-                    });
+                    for (MapCursor cursor(v); cursor; cursor.next()) {
+                        cursor.key()->accept(fbr, *this);
+                        cursor.value()->accept(fbr, *this);
+                    }
                 }
                 else {
                     //node map, keys should be string, 1 is type
-                    v.iterate([&](gc::ref<Value> key, gc::ref<Value> value) {
-                        if(key->to_string(fbr) == "type") {
-                            key->accept(fbr, *this);
-                            value->accept(fbr, *this);
+                    for (MapCursor cursor(v); cursor; cursor.next()) {
+                        if(cursor.key()->to_string(fbr) == "type") {
+                            cursor.key()->accept(fbr, *this);
+                            cursor.value()->accept(fbr, *this);
                         }
-                    });
+                    }
 
-                    v.iterate([&](gc::ref<Value> key, gc::ref<Value> value) {
+                    for (MapCursor cursor(v); cursor; cursor.next()) {
+                        auto key = cursor.key();
                         if(key->to_string(fbr) != "type") {                    
                             key->accept(fbr, *this);
                             if(key->to_string(fbr) == "data") {
                                 in_data_ = true;
                             }
-                            value->accept(fbr, *this);
+                            cursor.value()->accept(fbr, *this);
                             if(key->to_string(fbr) == "data") {                           
                                 in_data_ = false;
                             }
                         }
-                    });
+                    }
                 }
 
                 return v;
@@ -239,6 +282,14 @@ namespace park {
                     ins.read(reinterpret_cast<char *>(&v), sizeof(v));
                     return Integer::create(fbr, boost::endian::big_to_native(v));
                 }
+                case 0xcb: { //float 64
+                    uint64_t v;
+                    ins.read(reinterpret_cast<char *>(&v), sizeof(v));
+                    boost::endian::big_to_native_inplace(v);
+                    double d;
+                    std::memcpy(&d, &v, sizeof(d));
+                    return Float::create(fbr, d);
+                }
                 case 0xdb: { //str 32
                     int32_t len;
                     ins.read(reinterpret_cast<char *>(&len), sizeof(len));
@@ -251,28 +302,41 @@ namespace park {
                     int32_t len;
                     ins.read(reinterpret_cast<char *>(&len), sizeof(len));
                     boost::endian::big_to_native_inplace(len);
-                    auto v = Vector::create(fbr);
+                    auto v = TransientVector::create(fbr, Vector::create(fbr));
                     for (auto i = 0; i < len; i++) {
-                        v = v->conj(fbr, unpack(fbr, ins));
+                        v.mutate()->conj(fbr, unpack(fbr, ins));
                     }
-                    return v;
+                    return v.mutate()->persistent(fbr);
                 }
                 case 0xdf: { //map 32
                     int32_t len;
                     ins.read(reinterpret_cast<char *>(&len), sizeof(len));
                     boost::endian::big_to_native_inplace(len);
-                    auto m = Map::create(fbr);
+                    auto m = TransientMap::create(fbr, Map::create(fbr));
                     for (auto i = 0; i < len; i++) {
-                        m = m->assoc(fbr, unpack(fbr, ins), unpack(fbr, ins));
+                        auto key = unpack(fbr, ins);
+                        auto val = unpack(fbr, ins);
+                        m.mutate()->assoc(fbr, key, val);
                     }
-                    return m;
+                    return m.mutate()->persistent(fbr);
                 }
                 case 0xc7: { // ext type
                     uint8_t ch;
                     ins.read(reinterpret_cast<char *>(&ch), sizeof(ch)); //data
                     assert(ch == 0);
                     ins.read(reinterpret_cast<char *>(&ch), sizeof(ch)); //type
-                    assert(ch == 1); //for now only atom supported;
+                    if(ch == 2) {
+                        return CMap::create(fbr.allocator(), read_integer(ins));
+                    }
+                    if(ch == 3) {
+                        auto len = read_array_header(ins);
+                        auto s = TransientSet::create(fbr, Set::create(fbr));
+                        for (size_t i = 0; i < len; i++) {
+                            s.mutate()->conj(fbr, unpack(fbr, ins));
+                        }
+                        return s.mutate()->persistent(fbr);
+                    }
+                    assert(ch == 1); //for now only atom, cmap and set supported;
                     return Atom::create(fbr.allocator(), unpack(fbr, ins));                   
                 }
                 
@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+
+#include "profiler.h"
+#include "fiber.h"
+#include "closure.h"
+#include "ast.h"
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+namespace park {
+
+    thread_local Fiber *current_fiber_ = nullptr;
+
+    //runs on the interrupted thread, only marks its fiber. Lowering the checkpoint counter makes the next
+    //checkpoint of the fiber take the slow path
+    static void on_tick(int)
+    {
+        auto fbr = current_fiber_;
+        if (fbr != nullptr) {
+            fbr->sample_pending_ = 1;
+            fbr->checkpoint_ = -1;
+        }
+    }
+
+    class Profiler::Impl {
+    public:
+        struct thread_t {
+            pthread_t thread;
+            pid_t tid;
+            timer_t timer;
+            bool timing;
+        };
+
+        std::mutex lock_;
+        std::vector<thread_t> threads_;
+        bool running_ = false;
+        std::unordered_map<std::string, int64_t> stacks_;
+
+        //call with lock
+        void start_timer(thread_t &thread) {
+            clockid_t clock;
+            if (pthread_getcpuclockid(thread.thread, &clock) != 0) {
+                return;
+            }
+            struct sigevent event = {};
+            event.sigev_notify = SIGEV_THREAD_ID;
+            event.sigev_signo = SIGPROF;
+            event.sigev_notify_thread_id = thread.tid;
+            if (timer_create(clock, &event, &thread.timer) != 0) {
+                return;
+            }
+            struct itimerspec spec = {};
+            spec.it_interval.tv_nsec = 1000000000 / HZ;
+            spec.it_value = spec.it_interval;
+            timer_settime(thread.timer, 0, &spec, nullptr);
+            thread.timing = true;
+        }
+
+        //call with lock
+        void stop_timer(thread_t &thread) {
+            if (thread.timing) {
+                timer_delete(thread.timer);
+                thread.timing = false;
+            }
+        }
+    };
+
+    Profiler::Profiler()
+        : impl_(std::make_unique<Profiler::Impl>()) {
+    }
+
+    Profiler::~Profiler() {
+        stop();
+    }
+
+    void Profiler::add_thread()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        impl_->threads_.push_back({pthread_self(), static_cast<pid_t>(syscall(SYS_gettid)), {}, false});
+        if (impl_->running_) {
+            impl_->start_timer(impl_->threads_.back());
+        }
+    }
+
+    void Profiler::remove_thread()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        auto &threads = impl_->threads_;
+        auto const self = pthread_self();
+        auto found = std::find_if(threads.begin(), threads.end(), [&](auto &thread) {
+            return pthread_equal(thread.thread, self);
+        });
+        if (found != threads.end()) {
+            impl_->stop_timer(*found);
+            threads.erase(found);
+        }
+        current_fiber_ = nullptr;
+    }
+
+    void Profiler::start()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        if (impl_->running_) {
+            return;
+        }
+        struct sigaction action = {};
+        action.sa_handler = on_tick;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGPROF, &action, nullptr);
+        for (auto &thread : impl_->threads_) {
+            impl_->start_timer(thread);
+        }
+        impl_->running_ = true;
+    }
+
+    void Profiler::stop()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        for (auto &thread : impl_->threads_) {
+            impl_->stop_timer(thread);
+        }
+        impl_->running_ = false;
+    }
+
+    bool Profiler::running()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        return impl_->running_;
+    }
+
+    std::string Profiler::folded()
+    {
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        std::vector<std::pair<std::string, int64_t>> stacks(impl_->stacks_.begin(), impl_->stacks_.end());
+        std::sort(stacks.begin(), stacks.end());
+        impl_->stacks_.clear();
+        std::ostringstream out;
+        for (auto const &[stack, count] : stacks) {
+            out << stack << " " << count << "\n";
+        }
+        return out.str();
+    }
+
+    void Profiler::set_current(Fiber *fbr)
+    {
+        current_fiber_ = fbr;
+    }
+
+    void Profiler::sample(Fiber &fbr)
+    {
+        std::string stack;
+        for (auto const &frame : fbr.frame_stack) {
+            if (!stack.empty()) {
+                stack += ";";
+            }
+            auto const &callable = fbr.stack.callable(frame.base);
+            if (callable.is_ref() && Closure::isinstance(*callable.ref())) {
+                stack += static_cast<const Closure &>(*callable.ref()).function().name_;
+            }
+            else {
+                stack += "?";
+            }
+            stack += ":" + std::to_string(frame.apply != nullptr ? frame.apply->line_ : 0);
+        }
+        if (stack.empty()) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(impl_->lock_);
+        impl_->stacks_[stack]++;
+    }
+
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <memory>
+#include <string>
+
+namespace park {
+
+    class Fiber;
+
+    //samples the park call stacks of running fibers. A cpu time timer per worker thread interrupts the
+    //thread, and the fiber it was running takes the sample at its next checkpoint (function entry or
+    //loop iteration), where its frames are consistent
+    class Profiler {
+    public:
+        static const int HZ = 100;
+
+        Profiler();
+        ~Profiler();
+
+        //call on a worker thread after it starts and before it exits
+        void add_thread();
+        void remove_thread();
+
+        void start();
+        void stop();
+        bool running();
+
+        //collapsed stacks as 'function:line;function:line;... count' lines, the line is that of the call.
+        //clears the samples taken so far
+        std::string folded();
+
+        //the fiber running on the current thread, which the timer marks for sampling
+        static void set_current(Fiber *fbr);
+
+        //called by a marked fiber at its checkpoint
+        void sample(Fiber &fbr);
+
+    private:
+        class Impl;
+
+        std::unique_ptr<Impl> impl_;
+    };
+
+}
+
+#endif
@@ -21,10 +21,22 @@
 #include "boolean.h"
 #include "type.h"
 #include "builtin.h"
+#include "frame.h"
 #include "range.h"
+#include "vector.h"
 
 namespace park {
 
+    static gc::ref<Value> FIRST;
+    static gc::ref<Value> NEXT;
+    static gc::ref<Value> LENGTH;
+    static gc::ref<Value> GET;
+    static gc::ref<Value> PARTITION;
+    static gc::ref<Value> CHUNKS;
+    static gc::ref<Value> CHUNK_FIRST;
+    static gc::ref<Value> CHUNK_NEXT;
+
+    //the integers from start up to end, without storing them
     class RangeImpl : public ValueImpl<Range, RangeImpl> {
     private:
         int64_t start_;
@@ -36,46 +48,183 @@ namespace park {
             }
         }
 
-        /*
-
-        virtual const Value &first(Fiber &fbr) const override
-        {
-          if((end - start) > 0) {
-            return Integer::from_integer(fbr, start);
-          }
-          else {
-            throw std::runtime_error("empty range");
-          }
+        static gc::ref<RangeImpl> create(Fiber &fbr, int64_t start, int64_t end) {
+            return gc::make_ref<RangeImpl>(fbr.allocator(), start, end);
         }
 
-        virtual const Value &next(Fiber &fbr) const override
-        {
-          if((start + 1) <= end) {
-            return *new(fbr) RangeImpl(start + 1, end);
-          }
-          else {
-            throw std::runtime_error("end of range");
-          }
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {}
+
+        bool to_bool(Fiber &fbr) const override {
+            return end_ > start_;
         }
-        */
 
         void repr(Fiber &fbr, std::ostream &out) const override {
             out << "(range " << start_ << " " << end_ << ")";
         }
 
+        static int64_t _range(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            int64_t start;
+            int64_t end = 0;
+
+            return frame.check().
+                static_dispatch(*Builtin::RANGE).
+                argument_count(1, 2).
+                argument<int64_t>(1, start).
+                optional_argument<int64_t>(2, end).
+                result<Value>([&]() {
+                    //range(n) counts from 0
+                    if (frame.argument_count() == 1) {
+                        return create(fbr, 0, start);
+                    }
+                    return create(fbr, start, end);
+                });
+        }
+
+        static int64_t _first(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+
+            return frame.check().
+                single_dispatch(*FIRST, *TYPE).
+                argument_count(1).
+                argument<RangeImpl>(1, self).
+                result<int64_t>([&]() {
+                    if (self->end_ > self->start_) {
+                        return self->start_;
+                    }
+                    throw std::runtime_error("empty range");
+                });
+        }
+
+        static int64_t _next(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+
+            return frame.check().
+                single_dispatch(*NEXT, *TYPE).
+                argument_count(1).
+                argument<RangeImpl>(1, self).
+                result<Value>([&]() {
+                    if (self->end_ > self->start_) {
+                        return create(fbr, self->start_ + 1, self->end_);
+                    }
+                    throw std::runtime_error("end of range");
+                });
+        }
+
+        static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+
+            return frame.check().
+                single_dispatch(*LENGTH, *TYPE).
+                argument_count(1).
+                argument<RangeImpl>(1, self).
+                result<int64_t>([&]() {
+                    return self->end_ - self->start_;
+                });
+        }
+
+        static int64_t _get(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+            int64_t idx;
+
+            return frame.check().
+                single_dispatch(*GET, *TYPE).
+                argument_count(2).
+                argument<RangeImpl>(1, self).
+                argument<int64_t>(2, idx).
+                result<int64_t>([&]() {
+                    if (idx < 0 || idx >= self->end_ - self->start_) {
+                        throw std::runtime_error("index out of bound");
+                    }
+                    return self->start_ + idx;
+                });
+        }
+
+        static int64_t _partition(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+            int64_t n;
+
+            return frame.check().
+                single_dispatch(*PARTITION, *TYPE).
+                argument_count(2).
+                argument<RangeImpl>(1, self).
+                argument<int64_t>(2, n).
+                result<Value>([&]() {
+                    if (n <= 0) {
+                        throw std::runtime_error("partition size must be positive");
+                    }
+                    auto parts = TransientVector::create(fbr, Vector::create(fbr));
+                    auto start = self->start_;
+                    while (start < self->end_) {
+                        auto end = self->end_ - start > n ? start + n : self->end_;
+                        parts.mutate()->conj(fbr, create(fbr, start, end));
+                        start = end;
+                    }
+                    return parts.mutate()->persistent(fbr);
+                });
+        }
+
+        //a range is a single chunk, indexed by get
+        template<const gc::ref<Value> &BUILTIN, bool NEXT>
+        static int64_t _chunk(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<RangeImpl> self;
+
+            return frame.check().
+                single_dispatch(*BUILTIN, *TYPE).
+                argument_count(1).
+                argument<RangeImpl>(1, self).
+                result<Value>([&]() -> gc::ref<Value> {
+                    if (NEXT) {
+                        return create(fbr, self->end_, self->end_);
+                    }
+                    return self;
+                });
+        }
+
         static void init(Runtime &runtime) {
             TYPE = runtime.create_type("Range");
+
+            Builtin::RANGE = runtime.create_builtin<BuiltinStaticDispatch>("range", _range);
+
+            runtime.register_method(FIRST, *TYPE, _first);
+            runtime.register_method(NEXT, *TYPE, _next);
+            runtime.register_method(LENGTH, *TYPE, _length);
+            runtime.register_method(GET, *TYPE, _get);
+            runtime.register_method(PARTITION, *TYPE, _partition);
+            runtime.register_method(CHUNKS, *TYPE, _chunk<CHUNKS, false>);
+            runtime.register_method(CHUNK_FIRST, *TYPE, _chunk<CHUNK_FIRST, false>);
+            runtime.register_method(CHUNK_NEXT, *TYPE, _chunk<CHUNK_NEXT, true>);
         }
 
     };
 
-    /*
-    const Value &Range::from_range(Fiber &fbr, int64_t start, int64_t end) {
-        return *new(fbr) RangeImpl(start, end);
+    gc::ref<Range> Range::create(Fiber &fbr, int64_t start, int64_t end) {
+        return RangeImpl::create(fbr, start, end);
     }
-    */
 
     void Range::init(Runtime &runtime) {
+        FIRST = runtime.builtin("first");
+        NEXT = runtime.builtin("next");
+        LENGTH = runtime.builtin("length");
+        GET = runtime.builtin("get");
+        PARTITION = runtime.builtin("partition");
+        CHUNKS = runtime.builtin("chunks");
+        CHUNK_FIRST = runtime.builtin("chunk_first");
+        CHUNK_NEXT = runtime.builtin("chunk_next");
+
         RangeImpl::init(runtime);
     }
 
@@ -27,8 +27,9 @@ namespace park {
 class Range : public Value
 {
 public:
+  static gc::ref<Range> create(Fiber &fbr, int64_t start, int64_t end);
+
   static void init(Runtime &runtime);
-//  static const Value &from_range(Fiber &fbr, int64_t start, int64_t end);
 };
 
 }
@@ -34,18 +34,23 @@
 #include "runtime.h"
 
 #include "vector.h"
+#include "int_array.h"
 
 #include "fiber.h"
 #include "closure.h"
 #include "compiler.h"
 #include "builtin.h"
 #include "map.h"
+#include "set.h"
 #include "integer.h"
+#include "float.h"
 #include "string.h"
 #include "boolean.h"
 #include "type.h"
 #include "channel.h"
 #include "atom.h"
+#include "cmap.h"
+#include "semaphore.h"
 #include "lexer.h"
 #include "pack.h"
 #include "struct.h"
@@ -55,7 +60,9 @@
 #include "intern.h"
 #include "error2.h"
 #include "list.h"
+#include "range.h"
 #include "mod_random.h"
+#include "profiler.h"
 
 #include <boost/filesystem.hpp>
 
@@ -84,6 +91,8 @@ namespace park {
 
         std::unique_ptr<Compiler> compiler_;
 
+        std::unique_ptr<Profiler> profiler_;
+
         std::unordered_map<size_t, gc::ref<Value>> builtins_;
         std::unordered_map<std::string, gc::ref<Namespace>> modules_;
         std::unordered_map<std::string, gc::ref<Type>> types_;
@@ -149,6 +158,12 @@ namespace park {
             return *compiler_;
         }
 
+        Profiler &profiler() override
+        {
+            assert(profiler_);
+            return *profiler_;
+        }
+
         void add_root(gc::ref<gc::collectable> ref) override
         {
             roots_.push_back(ref);
@@ -196,6 +211,7 @@ namespace park {
     RuntimeImpl::RuntimeImpl()
             : workers_(std::thread::hardware_concurrency() * 2),
               compiler_(std::make_unique<Compiler>()),
+              profiler_(std::make_unique<Profiler>()),
               collector_(lock),
               allocator_(std::make_unique<gc::allocator_t>(collector_)),
               fibers_running_(&fibers_0_),
@@ -224,16 +240,22 @@ namespace park {
         Namespace::init(*this);
         Closure::init(*this);
         Integer::init(*this);
+        Float::init(*this);
         String::init(*this);
         Map::init(*this);
+        Set::init(*this);
         Vector::init(*this);
+        IntArray::init(*this);
         List::init(*this);
         Boolean::init(*this);
         Error2::init(*this);
         Channel::init(*this);
         Atom::init(*this);
+        CMap::init(*this);
+        Semaphore::init(*this);
+        WaitGroup::init(*this);
         Struct::init(*this);
-//        Range::init(*this);
+        Range::init(*this);
         Lexer::init(*this);
         pack::init(*this);
         http::init(*this);
@@ -667,6 +689,7 @@ namespace park {
             worker.allocator_ = std::make_unique<gc::allocator_t>(collector_);
             worker.thread_ = std::thread([&]() {
                 current_allocator_ = worker.allocator_.get();
+                profiler_->add_thread();
                 while(true) {   
                     this->io_service.run();
                     if(collector_.stw_mutators_wait.load()) 
@@ -679,10 +702,17 @@ namespace park {
                         break;
                     }
                 }
+                profiler_->remove_thread();
                 current_allocator_ = nullptr;
             });
         }
 
+        //PARK_PROFILE=<path> profiles the whole run and writes the collapsed stacks to path at exit
+        auto const profile_path = getenv("PARK_PROFILE");
+        if (profile_path != nullptr) {
+            profiler_->start();
+        }
+
         collector_.start();
         collector_.collect_shared(
         //continue running?:
@@ -785,6 +815,12 @@ namespace park {
             worker.thread_.join();
         }
 
+        if (profile_path != nullptr) {
+            profiler_->stop();
+            std::ofstream out(profile_path);
+            out << profiler_->folded();
+        }
+
         //fbr.private_heap_->clear();
         fiber_exitted(main_fiber_);
    
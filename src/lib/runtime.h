@@ -37,6 +37,8 @@ namespace park {
 
     class Compiler;
 
+    class Profiler;
+
     class Closure;
 
     namespace AST {
@@ -65,6 +67,8 @@ namespace park {
         virtual gc::collector_t &collector() = 0;
 
         virtual Compiler &compiler() = 0;
+
+        virtual Profiler &profiler() = 0;
         
         virtual void add_root(gc::ref<gc::collectable> ref) = 0;
 
@@ -0,0 +1,352 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <deque>
+#include <mutex>
+
+#include "runtime.h"
+#include "semaphore.h"
+#include "fiber.h"
+#include "type.h"
+#include "boolean.h"
+#include "frame.h"
+#include "builtin.h"
+
+namespace park {
+
+    //parks waiting fibers in fifo order like ChannelImpl does, no os level blocking
+    class SemaphoreImpl : public SharedValueImpl<Semaphore, SemaphoreImpl> {
+    private:
+        std::mutex lock_;
+
+        int64_t permits_;
+        const int64_t max_permits_; //the permits it was created with
+        const bool mutex_; //created by mutex()
+
+        std::deque<gc::ref<Fiber>> waiters_;
+
+        static gc::ref<Value> SEMAPHORE;
+        static gc::ref<Value> MUTEX;
+        static gc::ref<Value> ACQUIRE;
+        static gc::ref<Value> RELEASE;
+
+        //returns the waiter to hand the permit to, if any,
+        //throws before touching the permits when there is nothing to release
+        gc::ref<Fiber> release() {
+            std::lock_guard<std::mutex> lock_guard(lock_);
+
+            if (waiters_.empty()) {
+                if (permits_ >= max_permits_) {
+                    throw std::runtime_error(mutex_ ? "release of a mutex that is not held" :
+                                                      "release of a semaphore beyond its permits");
+                }
+                permits_ += 1;
+                return {};
+            }
+
+            auto waiter = waiters_.front();
+            waiters_.pop_front();
+            return waiter;
+        }
+
+    public:
+        SemaphoreImpl(int64_t permits, bool mutex) : permits_(permits), max_permits_(permits), mutex_(mutex) {}
+
+        static void init(Runtime &runtime);
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+            lock_.lock();
+            auto waiters = waiters_;
+            lock_.unlock();
+            for(auto &item : waiters) {
+                accept(item);
+            }
+        }
+
+        static int64_t _acquire(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<SemaphoreImpl> semaphore;
+
+            return frame.check().
+                single_dispatch(*ACQUIRE, *TYPE).
+                argument_count(1).
+                argument<SemaphoreImpl>(1, semaphore).
+                cc_resume([semaphore](Fiber &fbr) -> bool {
+                    std::lock_guard<std::mutex> lock_guard(semaphore.mutate()->lock_);
+
+                    //waiters go first, so that a release always hands over in fifo order
+                    if (semaphore->permits_ > 0 && semaphore->waiters_.empty()) {
+                        semaphore.mutate()->permits_ -= 1;
+                        fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                        return true; //continue
+                    }
+                    else {
+                        semaphore.mutate()->waiters_.emplace_back(&fbr);
+                        return false; //block
+                    }
+                });
+        }
+
+        static int64_t _release(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<SemaphoreImpl> semaphore;
+
+            auto check = frame.check().
+                single_dispatch(*RELEASE, *TYPE).
+                argument_count(1).
+                argument<SemaphoreImpl>(1, semaphore);
+
+            if (!check) {
+                return check.result();
+            }
+
+            auto waiter = semaphore.mutate()->release();
+
+            return check.cc_resume([waiter](Fiber &fbr) -> bool {
+                if (waiter) {
+                    //hand the permit directly to the first waiter
+                    waiter.mutate()->resume_async([](Fiber &fbr) {
+                        fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                    }, 0);
+                }
+                fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                return true; //continue
+            });
+        }
+
+        static int64_t _semaphore(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            int64_t permits;
+
+            return frame.check().
+                static_dispatch(*SEMAPHORE).
+                argument_count(1).
+                argument<int64_t>(1, permits).
+                result<Value>([&]() {
+                    if (permits < 0) {
+                        throw std::runtime_error("semaphore needs a non negative number of permits");
+                    }
+                    return Semaphore::create(fbr, permits);
+                });
+        }
+
+        static int64_t _mutex(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*MUTEX).
+                argument_count(0).
+                result<Value>([&]() {
+                    return gc::make_shared_ref<SemaphoreImpl>(fbr.allocator(), 1, true);
+                });
+        }
+
+        void repr(Fiber &fbr, std::ostream &out) const override {
+            out << (mutex_ ? "<mutex " : "<semaphore ") << this << ">";
+        }
+    };
+
+    class WaitGroupImpl : public SharedValueImpl<WaitGroup, WaitGroupImpl> {
+    private:
+        std::mutex lock_;
+
+        int64_t count_ = 0;
+
+        std::deque<gc::ref<Fiber>> waiters_;
+
+        static gc::ref<Value> WAIT_GROUP;
+        static gc::ref<Value> WG_ADD;
+        static gc::ref<Value> WG_DONE;
+        static gc::ref<Value> WAIT;
+
+        //returns the waiters to wake when the counter drops to zero,
+        //throws before touching the counter if it would go negative
+        std::deque<gc::ref<Fiber>> add(int64_t delta) {
+            if (&get_type() != TYPE.get()) {
+                throw std::runtime_error("expected a wait group");
+            }
+
+            std::lock_guard<std::mutex> lock_guard(lock_);
+
+            if (count_ + delta < 0) {
+                throw std::runtime_error("negative wait group counter");
+            }
+            count_ += delta;
+            if (count_ > 0) {
+                return {};
+            }
+
+            auto waiters = std::move(waiters_);
+            waiters_.clear();
+            return waiters;
+        }
+
+        static int64_t wake(const FrameCheck &check, std::deque<gc::ref<Fiber>> waiters) {
+            return check.cc_resume([waiters = std::move(waiters)](Fiber &fbr) -> bool {
+                for (auto &waiter : waiters) {
+                    waiter.mutate()->resume_async([](Fiber &fbr) {
+                        fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                    }, 0);
+                }
+                fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                return true; //continue
+            });
+        }
+
+    public:
+        static void init(Runtime &runtime);
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+            lock_.lock();
+            auto waiters = waiters_;
+            lock_.unlock();
+            for(auto &item : waiters) {
+                accept(item);
+            }
+        }
+
+        static int64_t _wg_add(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<WaitGroupImpl> wait_group;
+            int64_t delta;
+
+            auto check = frame.check().
+                static_dispatch(*WG_ADD).
+                argument_count(2).
+                argument<WaitGroupImpl>(1, wait_group).
+                argument<int64_t>(2, delta);
+
+            if (!check) {
+                return check.result();
+            }
+
+            return wake(check, wait_group.mutate()->add(delta));
+        }
+
+        static int64_t _wg_done(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<WaitGroupImpl> wait_group;
+
+            auto check = frame.check().
+                static_dispatch(*WG_DONE).
+                argument_count(1).
+                argument<WaitGroupImpl>(1, wait_group);
+
+            if (!check) {
+                return check.result();
+            }
+
+            return wake(check, wait_group.mutate()->add(-1));
+        }
+
+        static int64_t _wait(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<WaitGroupImpl> wait_group;
+
+            return frame.check().
+                single_dispatch(*WAIT, *TYPE).
+                argument_count(1).
+                argument<WaitGroupImpl>(1, wait_group).
+                cc_resume([wait_group](Fiber &fbr) -> bool {
+                    std::lock_guard<std::mutex> lock_guard(wait_group.mutate()->lock_);
+
+                    if (wait_group->count_ == 0) {
+                        fbr.stack.push<gc::ref<Value>>(Boolean::create(true));
+                        return true; //continue
+                    }
+                    else {
+                        wait_group.mutate()->waiters_.emplace_back(&fbr);
+                        return false; //block
+                    }
+                });
+        }
+
+        static int64_t _wait_group(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            return frame.check().
+                static_dispatch(*WAIT_GROUP).
+                argument_count(0).
+                result<Value>([&]() {
+                    return WaitGroup::create(fbr);
+                });
+        }
+
+        void repr(Fiber &fbr, std::ostream &out) const override {
+            out << "<wait_group " << this << ">";
+        }
+    };
+
+    gc::ref<Semaphore> Semaphore::create(Fiber &fbr, int64_t permits) {
+        return gc::make_shared_ref<SemaphoreImpl>(fbr.allocator(), permits, false);
+    }
+
+    gc::ref<WaitGroup> WaitGroup::create(Fiber &fbr) {
+        return gc::make_shared_ref<WaitGroupImpl>(fbr.allocator());
+    }
+
+    gc::ref<Value> SemaphoreImpl::SEMAPHORE;
+    gc::ref<Value> SemaphoreImpl::MUTEX;
+    gc::ref<Value> SemaphoreImpl::ACQUIRE;
+    gc::ref<Value> SemaphoreImpl::RELEASE;
+
+    gc::ref<Value> WaitGroupImpl::WAIT_GROUP;
+    gc::ref<Value> WaitGroupImpl::WG_ADD;
+    gc::ref<Value> WaitGroupImpl::WG_DONE;
+    gc::ref<Value> WaitGroupImpl::WAIT;
+
+    void SemaphoreImpl::init(Runtime &runtime) {
+        TYPE = runtime.create_type("Semaphore");
+
+        SEMAPHORE = runtime.create_builtin<BuiltinStaticDispatch>("semaphore", _semaphore);
+        MUTEX = runtime.create_builtin<BuiltinStaticDispatch>("mutex", _mutex);
+
+        ACQUIRE = runtime.builtin("acquire");
+        RELEASE = runtime.builtin("release");
+
+        runtime.register_method(ACQUIRE, *TYPE, _acquire);
+        runtime.register_method(RELEASE, *TYPE, _release);
+    }
+
+    void WaitGroupImpl::init(Runtime &runtime) {
+        TYPE = runtime.create_type("WaitGroup");
+
+        WAIT_GROUP = runtime.create_builtin<BuiltinStaticDispatch>("wait_group", _wait_group);
+        WG_ADD = runtime.create_builtin<BuiltinStaticDispatch>("wg_add", _wg_add);
+        WG_DONE = runtime.create_builtin<BuiltinStaticDispatch>("wg_done", _wg_done);
+
+        WAIT = runtime.builtin("wait");
+        runtime.register_method(WAIT, *TYPE, _wait);
+    }
+
+    void Semaphore::init(Runtime &runtime) {
+        SemaphoreImpl::init(runtime);
+    }
+
+    void WaitGroup::init(Runtime &runtime) {
+        WaitGroupImpl::init(runtime);
+    }
+
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright 2020 Henk Punt
+ *
+ * This file is part of Park.
+ *
+ * Park is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or (at
+ * your option) any later version.
+ *
+ * Park is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public
+ * License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with Park. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SET_H
+#define __SET_H
+
+#include "value.h"
+#include "fiber.h"
+
+namespace park {
+
+    //persistent hash set, it shares the trie of Map (see map.cc) with leafs that only hold a key
+    class Set : public Value {
+    public:
+
+        static void init(Runtime &runtime);
+
+        static gc::ref<Set> create(Fiber &fbr);
+
+        virtual gc::ref<Set> conj(Fiber &fbr, gc::ref<Value> key) const = 0;
+
+        virtual bool contains(Fiber &fbr, const Value &key) const = 0;
+
+        virtual size_t size() const = 0;
+
+    };
+
+    class TransientSet : public Value {
+    public:
+
+        static gc::ref<TransientSet> create(Fiber &fbr, gc::ref<Set> set);
+
+        virtual void conj(Fiber &fbr, gc::ref<Value> key) = 0;
+
+        virtual gc::ref<Set> persistent(Fiber &fbr) = 0;
+
+    };
+
+}
+
+#endif
@@ -22,7 +22,40 @@
 
 namespace park {
 
-    static_assert(sizeof(value_t) == 16);
+    static_assert(sizeof(value_t) == 8);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+    size_t Stack::begin_offset()
+    {
+        return offsetof(Stack, begin_);
+    }
+
+    size_t Stack::end_offset()
+    {
+        return offsetof(Stack, end_);
+    }
+
+    size_t Stack::cap_offset()
+    {
+        return offsetof(Stack, cap_);
+    }
+
+    size_t FrameStack::begin_offset()
+    {
+        return offsetof(FrameStack, begin_);
+    }
+
+    size_t FrameStack::end_offset()
+    {
+        return offsetof(FrameStack, end_);
+    }
+
+    size_t FrameStack::cap_offset()
+    {
+        return offsetof(FrameStack, cap_);
+    }
+#pragma GCC diagnostic pop
 
     void Stack::ensure_capacity(size_t n)
     {
@@ -57,4 +90,19 @@ namespace park {
         chunk_ = std::move(new_chunk);
     }
 
+    void FrameStack::grow()
+    {
+        auto const current_size = size();
+        auto const next_capacity = frames_ ? 2 * (cap_ - begin_) : INIT_CAP;
+
+        std::unique_ptr<frame_t[]> new_frames(new frame_t[next_capacity]);
+        std::copy(begin_, end_, new_frames.get());
+
+        begin_ = new_frames.get();
+        cap_ = begin_ + next_capacity;
+        end_ = begin_ + current_size;
+
+        frames_ = std::move(new_frames);
+    }
+
 }
\ No newline at end of file
@@ -23,6 +23,7 @@
 #include <type_traits>
 #include <vector>
 #include <csignal>
+#include <memory>
 
 #include "value.h"
 #include "integer.h"
@@ -43,8 +44,9 @@ namespace park {
         value_t * begin_ = nullptr; //start of stack
         value_t * cap_ = nullptr; //end of stack array e.g. not the stack ptr
 
-        static const size_t INIT_CAP = 32;
-        static const size_t MAX_CAP = 4096;
+        //in value_t's, the stack lives in local chunks of 512 bytes to 64kb
+        static const size_t INIT_CAP = 64;
+        static const size_t MAX_CAP = 8192;
     public:
 
         Stack()
@@ -58,6 +60,11 @@ namespace park {
 
         void ensure_capacity(size_t n);
 
+        //offsets of the stack pointers, used by jit code that manipulates the stack directly
+        static size_t begin_offset();
+        static size_t end_offset();
+        static size_t cap_offset();
+
         template<typename F>
         void each(F f) {
             for(auto cur = begin_ ; cur < end_; cur++) {
@@ -160,6 +167,13 @@ namespace park {
             assert(end_ >= begin_ && end_ <= cap_);
         }
 
+        //pushes val below the top n values
+        void insert_back(size_t n, const value_t &val)
+        {
+            push_back(val);
+            std::rotate(end_ - n - 1, end_ - 1, end_);
+        }
+
         void pop_frame(size_t base)
         {
             pop(size() - base);
@@ -176,6 +190,85 @@ namespace park {
 
        
     };
+
+    class List;
+
+    //activation of a function, pushed by its prolog and popped by its epilog
+    struct frame_t {
+        const AST::Apply *apply; //callsite
+        size_t base; //position of current callable in value stack
+        size_t argument_count; //argument count to current callable
+        size_t local_count;
+        gc::ref<List> defers; //list of defers we need to apply on function exit
+        void *link; //return address from current function
+    };
+
+    //the frames are plain memory so that jit code can push and pop them inline
+    class FrameStack {
+    private:
+        std::unique_ptr<frame_t[]> frames_;
+
+        frame_t *begin_ = nullptr;
+        frame_t *end_ = nullptr;
+        frame_t *cap_ = nullptr;
+
+        static const size_t INIT_CAP = 16;
+
+        void grow();
+
+    public:
+        //offsets of the frame pointers, used by jit code that manipulates the frames directly
+        static size_t begin_offset();
+        static size_t end_offset();
+        static size_t cap_offset();
+
+        bool empty() const noexcept
+        {
+            return end_ == begin_;
+        }
+
+        size_t size() const noexcept
+        {
+            return end_ - begin_;
+        }
+
+        frame_t *begin() const noexcept
+        {
+            return begin_;
+        }
+
+        frame_t *end() const noexcept
+        {
+            return end_;
+        }
+
+        frame_t &operator[](size_t i) const
+        {
+            assert(begin_ + i < end_);
+            return begin_[i];
+        }
+
+        frame_t &back() const
+        {
+            assert(!empty());
+            return *(end_ - 1);
+        }
+
+        void push_back(const frame_t &frame)
+        {
+            if(end_ == cap_) {
+                grow();
+            }
+            *end_ = frame;
+            end_++;
+        }
+
+        void pop_back()
+        {
+            assert(!empty());
+            end_--;
+        }
+    };
 }
 
 #endif
\ No newline at end of file
@@ -26,9 +26,13 @@
 #include "visitor.h"
 #include "frame.h"
 
+#include <atomic>
+#include <random>
+
 namespace park {
 
     static gc::ref<Value> INT;
+    static gc::ref<Value> FLOAT;
     static gc::ref<Value> LENGTH;
     static gc::ref<Value> HASH;
     static gc::ref<Value> ADD;
@@ -38,9 +42,68 @@ namespace park {
 
     static const int CUTOFF = 256;
 
+    /*
+     * Seeded string hash in the style of wyhash, it folds in 16 bytes at a time with 64x64->128 bit multiplies.
+     * The seed is random per process so map keys coming from outside can not be picked to collide on purpose,
+     * PARK_HASH_SEED=<n> fixes it for reproducible runs.
+     */
+    namespace strhash {
+
+        static uint64_t seed;
+
+        static const uint64_t P0 = 0xa0761d6478bd642full;
+        static const uint64_t P1 = 0xe7037ed1a0b428dbull;
+        static const uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+
+        inline uint64_t mix(uint64_t a, uint64_t b) {
+            auto r = static_cast<__uint128_t>(a) * b;
+            return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+        }
+
+        inline uint64_t read(const char *p, size_t n) {
+            uint64_t v = 0;
+            std::memcpy(&v, p, n);
+            return v;
+        }
+
+        uint64_t hash(const char *data, size_t size) {
+            //the state is xor-ed into both operands, so no input can zero a multiply without knowing the seed
+            uint64_t h = seed ^ P0;
+            size_t i = 0;
+            for (; i + 16 <= size; i += 16) {
+                h = mix(read(data + i, 8) ^ P1 ^ h, read(data + i + 8, 8) ^ P2 ^ h);
+            }
+            uint64_t a = 0;
+            uint64_t b = 0;
+            auto left = size - i;
+            if (left > 8) {
+                a = read(data + i, 8);
+                b = read(data + i + 8, left - 8);
+            }
+            else {
+                a = read(data + i, left);
+            }
+            h = mix(a ^ P1 ^ h, b ^ P2 ^ h);
+            return mix(h ^ P0, size ^ P1);
+        }
+
+        void init() {
+            auto const fixed = getenv("PARK_HASH_SEED");
+            if (fixed != nullptr) {
+                seed = std::stoull(fixed);
+            }
+            else {
+                std::random_device rd;
+                seed = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+            }
+        }
+    }
+
     template<typename S, typename Impl>
     class BaseStringImpl : public ValueImpl<S, Impl>
     {
+        //0 until first hashed, strings are immutable so racing fibers can only store the same value
+        mutable std::atomic<size_t> hash_{0};
 
     public:
         const char *data() const override = 0;
@@ -80,14 +143,12 @@ namespace park {
 
         const size_t map_key_hash(Fiber &fbr) const override
         {
-            std::hash<char> hasher;
-            size_t result = 0;
-            auto _size = size();
-            auto _data = data();
-            for(size_t i = 0; i < _size; ++i) {
-                result = result * 31 + hasher(_data[i]);
+            auto hash = hash_.load(std::memory_order_relaxed);
+            if (hash == 0) {
+                hash = strhash::hash(data(), size());
+                hash_.store(hash, std::memory_order_relaxed);
             }
-            return result;        
+            return hash;
         }
         
         std::string to_string(Fiber &fbr) const override {
@@ -367,6 +428,20 @@ namespace park {
             });
     }
 
+    static int64_t _float_small(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<StringImpl> self;
+
+        return frame.check().
+            single_dispatch(*FLOAT, *StringImpl::TYPE).
+            argument_count(1).
+            argument<StringImpl>(1, self).
+            result<double>([&]() {
+                return std::stod(self->to_string(fbr));
+            });
+    }
+
     void String::init(Runtime &runtime)
     {
         LENGTH = runtime.builtin("length");
@@ -376,12 +451,16 @@ namespace park {
         HASH = runtime.builtin("hash");
         INT = runtime.builtin("int");
 
+        strhash::init();
+        FLOAT = runtime.builtin("float");
+
         StringImpl::init(runtime);
         BigStringImpl::init(runtime);
 
         runtime.register_method(ADD, *BigStringImpl::TYPE, *StringImpl::TYPE, _add_big_small);
         runtime.register_method(ADD, *StringImpl::TYPE, *BigStringImpl::TYPE, _add_small_big);
         runtime.register_method(INT, *StringImpl::TYPE, _int_small);
+        runtime.register_method(FLOAT, *StringImpl::TYPE, _float_small);
 
     }
 
@@ -408,23 +487,17 @@ namespace park {
     const bool StringImpl::map_key_equals(Fiber &fbr, const Value &other) const 
     {
         auto &type = other.get_type();
-        if(&type == StringImpl::TYPE.get() || &type == BigStringImpl::TYPE.get()) {
-            return equals(static_cast<const BaseStringImpl &>(other));
-        }
-        else {
-            throw std::runtime_error("not a string");
-        }
+        //keys of other types can end up here when their hashes collide
+        return (&type == StringImpl::TYPE.get() || &type == BigStringImpl::TYPE.get()) &&
+            equals(static_cast<const BaseStringImpl &>(other));
     }
 
     const bool BigStringImpl::map_key_equals(Fiber &fbr, const Value &other) const 
     {
         auto &type = other.get_type();
-        if(&type == StringImpl::TYPE.get() || &type == BigStringImpl::TYPE.get()) {
-            return equals(static_cast<const BaseStringImpl &>(other));
-        }
-        else {
-            throw std::runtime_error("not a string");
-        }
+        //keys of other types can end up here when their hashes collide
+        return (&type == StringImpl::TYPE.get() || &type == BigStringImpl::TYPE.get()) &&
+            equals(static_cast<const BaseStringImpl &>(other));
     }
 
 
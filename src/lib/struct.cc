@@ -76,7 +76,9 @@ namespace park {
         }
 
         void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
-            throw std::runtime_error("TODO walk struct type");
+            for(auto &[keyword, slot] : slot_map_) {
+                accept(keyword);
+            }
         }  
 
         virtual void repr(Fiber &fbr, std::ostream &out) const override {
@@ -223,7 +225,7 @@ namespace park {
                 auto &runtime = Runtime::from_fbr(fbr);
                 auto impl = runtime.compiler().code(closure->function());
                 std::lock_guard<std::mutex> guard(runtime.lock);//TODO remove when implement is toplevel constuct
-                runtime.register_method(method, *type, impl);
+                method.mutate()->register_method(fbr.allocator(), *type, impl, closure);
                 return closure;
             });                   
     }
@@ -22,6 +22,12 @@
 
 namespace park {
 
+    static std::atomic<size_t> next_type_id(Type::FIRST_ID);
+
+    Type::Type() : id_(next_type_id++) {
+        static_assert(static_cast<size_t>(value_t::kind_t::RVALUE) < Type::FIRST_ID);
+    }
+
     class TypeImpl : public SharedValueImpl<Type, TypeImpl> {
     private:
         const std::string name_;
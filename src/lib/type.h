@@ -20,6 +20,8 @@
 #ifndef __TYPE
 #define __TYPE
 
+#include <atomic>
+
 #include "value.h"
 
 namespace park {
@@ -27,9 +29,22 @@ namespace park {
     class Runtime;
 
     class Type : public Value {
+    private:
+        const size_t id_;
+
     public:
+        //dispatch ids below FIRST_ID are used for the kinds of unboxed values
+        static const size_t FIRST_ID = 5;
+
+        Type();
+
         static void init(Runtime &runtime);
 
+        //small dense id, given out in order of creation, to index dispatch tables
+        size_t id() const {
+            return id_;
+        }
+
         virtual std::string name() const = 0;
 
         static gc::ref<Type> create(gc::allocator_t &allocator, std::string name);
@@ -21,20 +21,25 @@
 
 #include "boolean.h"
 #include "integer.h"
+#include "float.h"
 #include "error.h"
 #include "string.h"
+#include "runtime.h"
 
 namespace park {
 
     namespace value {
 
         const Value &from_value_t(Fiber &fbr, const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::IVALUE: {
-                    return *Integer::create(fbr, value.ivalue);
+                    return *Integer::create(fbr, value.int64());
                 }
                 case value_t::kind_t::BVALUE: {
-                    return *Boolean::create(value.bvalue);
+                    return *Boolean::create(value.boolean());
+                }
+                case value_t::kind_t::DVALUE: {
+                    return *Float::create(fbr, value.float64());
                 }
                 default: {
                     throw std::runtime_error("TODO from_value_t");
@@ -43,12 +48,15 @@ namespace park {
         }
 
         gc::ref<Value> ref_from_value_t(Fiber &fbr, const value_t &value) {  
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::IVALUE: {
-                    return Integer::create(fbr, value.ivalue);
+                    return Integer::create(fbr, value.int64());
                 }
                 case value_t::kind_t::BVALUE: {
-                    return Boolean::create(value.bvalue);
+                    return Boolean::create(value.boolean());
+                }
+                case value_t::kind_t::DVALUE: {
+                    return Float::create(fbr, value.float64());
                 }
                 default: {
                     throw std::runtime_error("TODO ref_from_value_t");
@@ -57,9 +65,9 @@ namespace park {
         }
 
         const Type &value_type(const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::RVALUE: {
-                    return value.rvalue->get_type();
+                    return value.ref()->get_type();
                 }
                 case value_t::kind_t::IVALUE: {
                     return Integer::type();
@@ -67,11 +75,18 @@ namespace park {
                 case value_t::kind_t::BVALUE: {
                     return Boolean::type();
                 }
+                case value_t::kind_t::DVALUE: {
+                    return Float::type();
+                }
                 default: {
                     throw std::runtime_error("unexpected kind in value_type");
                 }
             }
         }
+
+        value_t box_int64(int64_t value) {
+            return to_value_t<gc::ref<Value>>(gc::ref_cast<Value>(Integer::create(Runtime::current_allocator(), value)));
+        }
     }
 }
 
@@ -26,6 +26,7 @@
 #include <limits>
 #include <cassert>
 #include <csignal>
+#include <cstring>
 
 #include "error.h"
 #include "gc.h"
@@ -120,38 +121,90 @@ namespace park {
     template<typename T, typename TImpl>
     class SharedValueImpl : public ValueImpl<gc::with_finalizer<T>, TImpl> {};
 
-    //variant type for use without heap allocations (in stack etc)
+    //variant type for use without heap allocations (in stack etc), NaN-boxed in 64 bits:
+    //pointers have 0x0000 as upper 16 bits (the null pointer is the undefined value), int64's
+    //have 0xffff and a 48 bit payload (larger ones are boxed as Integer), doubles are offset by 2^48 so
+    //that they never have 0x0000 or 0xffff, and booleans are small constants no pointer can have
     struct value_t {
         enum class kind_t {
             UVALUE, IVALUE, BVALUE, DVALUE, RVALUE
-        } kind;
-        union {
-            int64_t ivalue;
-            bool bvalue;
-            double dvalue;
-            const Value *rvalue;
         };
 
+        uint64_t bits;
+
+        static constexpr uint64_t INT_TAG = 0xffff000000000000ull;
+        static constexpr uint64_t INT_PAYLOAD = 0x0000ffffffffffffull;
+        static constexpr uint64_t DOUBLE_OFFSET = 1ull << 48;
+        static constexpr uint64_t BOOL_FALSE = 0x6;
+        static constexpr uint64_t BOOL_TRUE = 0x7;
+        static constexpr uint64_t MAX_CONSTANT = 0xf; //pointers are above
+        static constexpr int64_t INT_MIN_ = -(1ll << 47);
+        static constexpr int64_t INT_MAX_ = (1ll << 47) - 1;
+
+        kind_t kind() const {
+            if (bits >= INT_TAG) {
+                return kind_t::IVALUE;
+            }
+            else if (bits >= DOUBLE_OFFSET) {
+                return kind_t::DVALUE;
+            }
+            else if (bits > MAX_CONSTANT) {
+                return kind_t::RVALUE;
+            }
+            return bits == 0 ? kind_t::UVALUE : kind_t::BVALUE;
+        }
+
         bool is_ref() const {
-            return kind == kind_t::RVALUE;
+            return bits > MAX_CONSTANT && bits < DOUBLE_OFFSET;
         }
 
         bool is_int64() const {
-            return kind == kind_t::IVALUE;
+            return bits >= INT_TAG;
+        }
+
+        bool is_boolean() const {
+            return (bits | 1) == BOOL_TRUE;
+        }
+
+        bool is_float64() const {
+            return bits >= DOUBLE_OFFSET && bits < INT_TAG;
+        }
+
+        bool is_undefined() const {
+            return bits == 0;
         }
 
         int64_t int64() const {
             assert(is_int64());
-            return ivalue;
+            return static_cast<int64_t>(bits << 16) >> 16;
+        }
+
+        bool boolean() const {
+            assert(is_boolean());
+            return bits == BOOL_TRUE;
+        }
+
+        double float64() const {
+            assert(is_float64());
+            double value;
+            auto const raw = bits - DOUBLE_OFFSET;
+            std::memcpy(&value, &raw, sizeof(value));
+            return value;
         }
 
         const Value * ref() const {
             assert(is_ref());
-            return rvalue;
+            return reinterpret_cast<const Value *>(bits);
+        }
+
+        //whether an int64 fits in the payload, otherwise it needs to be boxed
+        static bool is_small_int64(int64_t value) {
+            return value >= INT_MIN_ && value <= INT_MAX_;
         }
 
     };
 
+    static_assert(sizeof(value_t) == 8, "value_t must fit in a register.");
     static_assert(std::is_pod<value_t>::value, "value_t must be a POD type.");
 
     namespace value {
@@ -165,8 +218,8 @@ namespace park {
 
         template<>
         inline bool from_value_t(const value_t &sval, const Value *&tval) {
-            if (sval.kind == value_t::kind_t::RVALUE) {
-                tval = sval.rvalue;
+            if (sval.is_ref()) {
+                tval = sval.ref();
                 return true;
             } else {
                 return false;
@@ -175,8 +228,18 @@ namespace park {
 
         template<>
         inline bool from_value_t(const value_t &sval, int64_t &tval) {
-            if (sval.kind == value_t::kind_t::IVALUE) {
-                tval = sval.ivalue;
+            if (sval.is_int64()) {
+                tval = sval.int64();
+                return true;
+            } else {
+                return false;
+            }
+        }
+
+        template<>
+        inline bool from_value_t(const value_t &sval, double &tval) {
+            if (sval.is_float64()) {
+                tval = sval.float64();
                 return true;
             } else {
                 return false;
@@ -190,18 +253,18 @@ namespace park {
 
         template<>
         inline bool cast(Fiber &fbr, const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::BVALUE: {
-                    return value.bvalue;
+                    return value.boolean();
                 }
                 case value_t::kind_t::RVALUE: {
-                    return value.rvalue->to_bool(fbr);
+                    return value.ref()->to_bool(fbr);
                 }
                 case value_t::kind_t::IVALUE: {
-                    return value.ivalue != 0;
+                    return value.int64() != 0;
                 }
                 case value_t::kind_t::DVALUE: {
-                    return value.dvalue != 0.0;
+                    return value.float64() != 0.0;
                 }
                 case value_t::kind_t::UVALUE: {
                     return false;
@@ -211,18 +274,18 @@ namespace park {
 
         template<>
         inline int64_t cast(Fiber &fbr, const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::BVALUE: {
-                    return value.bvalue;
+                    return value.boolean();
                 }
                 case value_t::kind_t::RVALUE: {
-                    return value.rvalue->to_index(fbr);
+                    return value.ref()->to_index(fbr);
                 }                
                 case value_t::kind_t::IVALUE: {
-                    return value.ivalue;
+                    return value.int64();
                 }
                 case value_t::kind_t::DVALUE: {
-                    return value.dvalue;
+                    return value.float64();
                 }
                 case value_t::kind_t::UVALUE: {
                     throw std::runtime_error("blah");
@@ -232,9 +295,9 @@ namespace park {
 
         template<>
         inline const Value &cast(Fiber &fbr, const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::RVALUE: {
-                    return *value.rvalue;
+                    return *value.ref();
                 }
                 case value_t::kind_t::IVALUE: {
                     return from_value_t(fbr, value);
@@ -243,7 +306,7 @@ namespace park {
                     return from_value_t(fbr, value);
                 }
                 case value_t::kind_t::DVALUE: {
-                    throw std::runtime_error("TODO");
+                    return from_value_t(fbr, value);
                 }
                 case value_t::kind_t::UVALUE: {
                     throw std::runtime_error("undefined value_t cannot be cast to Value &");
@@ -253,9 +316,9 @@ namespace park {
 
         template<>
         inline gc::ref<Value> cast(Fiber &fbr, const value_t &value) {
-            switch (value.kind) {
+            switch (value.kind()) {
                 case value_t::kind_t::RVALUE: {
-                    return gc::ref<Value>(value.rvalue);
+                    return gc::ref<Value>(value.ref());
                 }                                
                 case value_t::kind_t::IVALUE: {
                     return ref_from_value_t(fbr, value);
@@ -272,17 +335,20 @@ namespace park {
             }
         }
 
+        //an int64 that does not fit in a value_t, boxed as Integer in the allocator of the current thread
+        value_t box_int64(int64_t value);
+
         template<typename T>
         value_t to_value_t(T);
 
         template<>
         inline value_t to_value_t<const Value *>(const Value *rvalue) {
-            return {.kind = value_t::kind_t::RVALUE, .rvalue = rvalue};
+            return {.bits = reinterpret_cast<uint64_t>(rvalue)};
         }
 
         template<>
         inline value_t to_value_t<const Value &>(const Value &value) {
-            return {.kind = value_t::kind_t::RVALUE, .rvalue = &value};
+            return {.bits = reinterpret_cast<uint64_t>(&value)};
         }
 
         template<>
@@ -290,19 +356,33 @@ namespace park {
 #ifndef NDEBUG
             assert(value.get() != nullptr);
 #endif
-            return {.kind = value_t::kind_t::RVALUE, .rvalue = value.mutate()};
+            return {.bits = reinterpret_cast<uint64_t>(value.mutate())};
         }
 
         template<>
         inline value_t to_value_t<int64_t>(int64_t value) {
-            return {.kind = value_t::kind_t::IVALUE, .ivalue = value};
+            if (!value_t::is_small_int64(value)) {
+                return box_int64(value);
+            }
+            return {.bits = value_t::INT_TAG | (static_cast<uint64_t>(value) & value_t::INT_PAYLOAD)};
         }
 
         template<>
         inline value_t to_value_t<bool>(bool value) {
-            return {.kind = value_t::kind_t::BVALUE, .bvalue = value};
+            return {.bits = value ? value_t::BOOL_TRUE : value_t::BOOL_FALSE};
         }
 
+        template<>
+        inline value_t to_value_t<double>(double value) {
+            uint64_t raw;
+            if (value != value) {
+                raw = 0x7ff8000000000000ull; //canonical NaN, some NaN's would wrap around into the pointers
+            }
+            else {
+                std::memcpy(&raw, &value, sizeof(raw));
+            }
+            return {.bits = raw + value_t::DOUBLE_OFFSET};
+        }
 
     }
 }
@@ -33,6 +33,45 @@ namespace park {
     static gc::ref<Value> FIRST;
     static gc::ref<Value> NEXT;
     static gc::ref<Value> ADD;
+    static gc::ref<Value> TRANSIENT;
+    static gc::ref<Value> PERSISTENT;
+    static gc::ref<Value> SUBVEC;
+    static gc::ref<Value> SPLIT_AT;
+    static gc::ref<Value> PARTITION;
+    static gc::ref<Value> CHUNKS;
+    static gc::ref<Value> CHUNK_FIRST;
+    static gc::ref<Value> CHUNK_NEXT;
+
+    //cumulative element counts of the children of a relaxed node
+    class SizeTable : public gc::collectable
+    {
+    private:
+        const size_t size_;
+
+        alignas(16)
+        size_t sizes_[];
+
+    public:
+        explicit SizeTable(const size_t sizes[], size_t size)
+            : size_(size)
+        {
+            assert(size_ > 0 && size_ <= 32);
+            std::copy_n(sizes, size, sizes_);
+        }
+
+        static gc::ref<SizeTable> create(Fiber &fbr, const size_t sizes[], size_t size)
+        {
+            return gc::make_ref_fam<SizeTable, size_t>(fbr.allocator(), size, sizes, size);
+        }
+
+        size_t get(size_t idx) const {
+            assert(idx < size_);
+            return sizes_[idx];
+        }
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {
+        }
+    };
 
     class Array : public Value
     {
@@ -41,7 +80,10 @@ namespace park {
     class ArrayImpl : public ValueImpl<Array, ArrayImpl> 
     {
     private:
-        const size_t size_;
+        size_t size_;
+
+        //only set on relaxed internal nodes, leafs and balanced nodes are indexed by radix
+        gc::ref<SizeTable> sizes_;
 
         alignas(16)
         gc::ref<Value> arr_[];
@@ -112,6 +154,14 @@ namespace park {
             return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), other.size_, other.arr_, other.size_);
         }
 
+        static gc::ref<ArrayImpl> create(Fiber &fbr, const gc::ref<Value> arr[], size_t size)
+        {
+            if (size == 0) {
+                return EMPTY;
+            }
+            return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), size, arr, size);
+        }
+
         static gc::ref<ArrayImpl> create(Fiber &fbr, gc::ref<Value> val)
         {
             return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), 1, val);
@@ -122,15 +172,36 @@ namespace park {
             return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), 2, val1, val2);
         }
 
+        /* copy with room for 32, so that a transient can push into it */
+        static gc::ref<ArrayImpl> create_tail(Fiber &fbr, const ArrayImpl &other)
+        {
+            if (other.size_ == 0) {
+                return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), 32);
+            }
+            return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), 32, other.arr_, other.size_);
+        }
+
         gc::ref<ArrayImpl> append(Fiber &fbr, gc::ref<Value> val) const {
            return gc::make_ref_fam<ArrayImpl, gc::ref<Value>>(fbr.allocator(), size_ + 1, arr_, size_, val);
         }
 
+        gc::ref<ArrayImpl> slice(Fiber &fbr, size_t from, size_t to) const {
+            assert(from <= to && to <= size_);
+            return create(fbr, arr_ + from, to - from);
+        }
+
         void set(size_t idx, gc::ref<Value> v) {
             assert(idx >= 0 && idx < size_);
             arr_[idx] = v;
         }
 
+        /* only on arrays from create_tail */
+        void push(gc::ref<Value> v) {
+            assert(size_ < 32);
+            assert(v);
+            arr_[size_++] = v;
+        }
+
         gc::ref<Value> get(size_t idx) const {
             assert(idx >= 0 && idx < size_);
             return arr_[idx];
@@ -140,12 +211,23 @@ namespace park {
             return size_;
         }
 
+        gc::ref<SizeTable> sizes() const {
+            return sizes_;
+        }
+
+        void set_sizes(gc::ref<SizeTable> sizes) {
+            sizes_ = sizes;
+        }
+
         void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {  
             assert(size_ >= 0 && size_ <= 32);
             for(auto i = 0; i < size_; i++) {
                 assert(arr_[i]);
                 accept(arr_[i]);
             }
+            if (sizes_) {
+                accept(sizes_);
+            }
         }
 
         void repr(Fiber &fbr, std::ostream &out) const override {
@@ -248,41 +330,250 @@ namespace park {
             gc::ref<VectorImpl> self;
             gc::ref<VectorImpl> other;
 
-            //TODO this impl is silly and slow
             return frame.check().
                 binary_dispatch(*ADD, *TYPE, *TYPE).
                 argument_count(2).
                 argument<VectorImpl>(1, self). 
                 argument<VectorImpl>(2, other). 
                 result<Value>([&]() {
-                    auto new_vector = self;
-                    for (size_t i = 0; i < other->size(); i++) {
-                        new_vector = gc::ref_dynamic_cast<VectorImpl>(new_vector->conj(fbr, other->nth(i)));
+                    return concat(fbr, self, other);
+                });
+        }
+
+        static int64_t _subvec(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorImpl> self;
+            int64_t start;
+            int64_t end = 0;
+
+            auto checked = frame.check().
+                single_dispatch(*SUBVEC, *TYPE).
+                argument_count(2, 3).
+                argument<VectorImpl>(1, self).
+                argument<int64_t>(2, start).
+                optional_argument<int64_t>(3, end);
+
+            if(!checked) {
+                return checked.result();
+            }
+
+            if (frame.argument_count() == 2) {
+                end = self->cnt_;
+            }
+            if (start < 0 || start > end || end > self->cnt_) {
+                throw std::runtime_error("index out of bound");
+            }
+            return frame.result<Value>(subvec(fbr, self, start, end));
+        }
+
+        static int64_t _split_at(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorImpl> self;
+            int64_t idx;
+
+            return frame.check().
+                single_dispatch(*SPLIT_AT, *TYPE).
+                argument_count(2).
+                argument<VectorImpl>(1, self).
+                argument<int64_t>(2, idx).
+                result<Value>([&]() {
+                    if (idx < 0 || idx > self->cnt_) {
+                        throw std::runtime_error("index out of bound");
                     }
-                    return new_vector;
+                    return EMPTY->
+                        conj(fbr, subvec(fbr, self, 0, idx))->
+                        conj(fbr, subvec(fbr, self, idx, self->cnt_));
+                });
+        }
+
+        /*
+         * Splits into pieces of at least n values for parallel work. The piece size is rounded up to a multiple of
+         * the largest subtree that fits in n, so in a balanced tree the pieces share whole nodes with self.
+         */
+        static int64_t _partition(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorImpl> self;
+            int64_t n;
+
+            return frame.check().
+                single_dispatch(*PARTITION, *TYPE).
+                argument_count(2).
+                argument<VectorImpl>(1, self).
+                argument<int64_t>(2, n).
+                result<Value>([&]() {
+                    if (n <= 0) {
+                        throw std::runtime_error("partition size must be positive");
+                    }
+                    size_t unit = 32;
+                    while ((unit << 5) <= static_cast<size_t>(n)) {
+                        unit <<= 5;
+                    }
+                    size_t size = (n + unit - 1) / unit * unit;
+                    size_t cnt = self->cnt_;
+                    auto parts = TransientVector::create(fbr, EMPTY);
+                    for (size_t start = 0; start < cnt; start += size) {
+                        parts.mutate()->conj(fbr, subvec(fbr, self, start, std::min(start + size, cnt)));
+                    }
+                    return parts.mutate()->persistent(fbr);
+                });
+        }
+
+        static int64_t _chunks(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorImpl> self;
+
+            return frame.check().
+                single_dispatch(*CHUNKS, *TYPE).
+                argument_count(1).
+                argument<VectorImpl>(1, self).
+                result<Value>([&]() {
+                    return self;
+                });
+        }
+
+        static int64_t _chunk_first(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorImpl> self;
+
+            return frame.check().
+                single_dispatch(*CHUNK_FIRST, *TYPE).
+                argument_count(1).
+                argument<VectorImpl>(1, self).
+                result<Value>([&]() {
+                    return chunk(fbr, self, 0);
                 });
         }
 
 public:
         static int64_t _next(Fiber &fbr, const AST::Apply &apply);
+        static int64_t _chunk_next(Fiber &fbr, const AST::Apply &apply);
         static int64_t _add_vector_iterator(Fiber &fbr, const AST::Apply &apply);
+        static int64_t _transient(Fiber &fbr, const AST::Apply &apply);
 
         virtual size_t size() const override {
             return cnt_;
         }
 
          gc::ref<Value> nth(size_t i) const override {
-            if (i < cnt_) {
-                if (i >= tailoff()) {
-                    return tail_->get(i & 0x01f);
+            return nth(cnt_, shift_, root_, tail_, i);
+         }
+
+         static gc::ref<Value> nth(size_t cnt, int shift, gc::ref<ArrayImpl> root, gc::ref<ArrayImpl> tail, size_t i) {
+            if (i < cnt) {
+                auto [arr, idx] = leaf(cnt, shift, root, tail, i);
+                return arr->get(idx);
+            }
+            throw std::runtime_error("index out of bound");
+        }
+
+        //the leaf holding value i (i < cnt) and the index of i in that leaf
+        static std::tuple<gc::ref<ArrayImpl>, size_t> leaf(size_t cnt, int shift, gc::ref<ArrayImpl> root, gc::ref<ArrayImpl> tail, size_t i) {
+            auto tailoff = cnt - tail->size();
+            if (i >= tailoff) {
+                return {tail, i - tailoff};
+            }
+            auto arr = root;
+            for (auto level = shift; level > 0; level -= 5) {
+                auto idx = (i >> level) & 0x01f;
+                if (auto sizes = arr->sizes()) {
+                    //relaxed node, the radix index is a lower bound for the child holding i
+                    while (sizes->get(idx) <= i) {
+                        idx++;
+                    }
+                    if (idx > 0) {
+                        i -= sizes->get(idx - 1);
+                    }
                 }
-                auto arr = root_;
-                for (auto level = shift_; level > 0; level -= 5) {
-                    arr = gc::ref_dynamic_cast<ArrayImpl>(arr->get((i >> level) & 0x01f));
+                arr = gc::ref_dynamic_cast<ArrayImpl>(arr->get(idx));
+            }
+            return {arr, i & 0x01f};
+        }
+
+        //the values from i up to the end of their leaf, as a vector that only has a tail
+        static gc::ref<VectorImpl> chunk(Fiber &fbr, gc::ref<VectorImpl> self, size_t i) {
+            if (i >= static_cast<size_t>(self->cnt_)) {
+                return EMPTY;
+            }
+            auto [arr, idx] = leaf(self->cnt_, self->shift_, self->root_, self->tail_, i);
+            auto values = idx == 0 ? arr : arr->slice(fbr, idx, arr->size());
+            return gc::make_ref<VectorImpl>(fbr.allocator(), values->size(), 5, ArrayImpl::EMPTY, values);
+        }
+
+        static size_t chunk_size(gc::ref<VectorImpl> self, size_t i) {
+            if (i >= static_cast<size_t>(self->cnt_)) {
+                return 0;
+            }
+            auto [arr, idx] = leaf(self->cnt_, self->shift_, self->root_, self->tail_, i);
+            return arr->size() - idx;
+        }
+
+        static gc::ref<VectorImpl> concat(Fiber &fbr, gc::ref<VectorImpl> left, gc::ref<VectorImpl> right) {
+            if (left->cnt_ == 0) {
+                return right;
+            }
+            if (right->cnt_ == 0) {
+                return left;
+            }
+            auto cnt = left->cnt_ + right->cnt_;
+            if (static_cast<size_t>(right->cnt_) == right->tail_->size()) {
+                //right is only a tail, append it to the tail on the left
+                gc::ref<Value> values[64];
+                size_t n = 0;
+                for (size_t i = 0; i < left->tail_->size(); i++) {
+                    values[n++] = left->tail_->get(i);
+                }
+                for (size_t i = 0; i < right->tail_->size(); i++) {
+                    values[n++] = right->tail_->get(i);
+                }
+                if (n <= 32) {
+                    return gc::make_ref<VectorImpl>(fbr.allocator(), cnt, left->shift_, left->root_, ArrayImpl::create(fbr, values, n));
                 }
-                return arr->get(i & 0x01f);
+                auto [root, shift] = push_tail(fbr, left->shift_, left->root_, ArrayImpl::create(fbr, values, 32));
+                return gc::make_ref<VectorImpl>(fbr.allocator(), cnt, shift, root, ArrayImpl::create(fbr, values + 32, n - 32));
             }
-            throw std::runtime_error("index out of bound");
+            auto lroot = left->root_;
+            auto lshift = left->shift_;
+            if (left->tail_->size() > 0) {
+                std::tie(lroot, lshift) = push_tail(fbr, lshift, lroot, left->tail_);
+            }
+            auto root = concat_sub_tree(fbr, lroot, lshift, right->root_, right->shift_);
+            auto shift = std::max(lshift, right->shift_) + 5;
+            while (shift > 5 && root->size() == 1) {
+                root = child(*root, 0);
+                shift -= 5;
+            }
+            return gc::make_ref<VectorImpl>(fbr.allocator(), cnt, shift, root, right->tail_);
+        }
+
+        static gc::ref<VectorImpl> subvec(Fiber &fbr, gc::ref<VectorImpl> self, size_t start, size_t end) {
+            const size_t cnt = self->cnt_;
+            assert(start <= end && end <= cnt);
+            if (start == end) {
+                return EMPTY;
+            }
+            if (start == 0 && end == cnt) {
+                return self;
+            }
+            auto tailoff = self->cnt_ - self->tail_->size();
+            auto tail = ArrayImpl::EMPTY;
+            if (end > tailoff) {
+                tail = self->tail_->slice(fbr, std::max(start, tailoff) - tailoff, end - tailoff);
+            }
+            if (start >= std::min(end, tailoff)) {
+                return gc::make_ref<VectorImpl>(fbr.allocator(), end - start, 5, ArrayImpl::EMPTY, tail);
+            }
+            auto root = slice_tree(fbr, self->root_, self->shift_, start, std::min(end, tailoff));
+            auto shift = self->shift_;
+            while (shift > 5 && root->size() == 1) {
+                root = child(*root, 0);
+                shift -= 5;
+            }
+            return gc::make_ref<VectorImpl>(fbr.allocator(), end - start, shift, root, tail);
         }
 
 private:
@@ -290,10 +581,6 @@ private:
             return cnt_ != 0;
         }
 
-        const size_t tailoff() const {
-            return cnt_ - tail_->size();
-        }
-
         void repr(Fiber &fbr, std::ostream &out) const override {
             out << "[";
             for(auto i = 0; i < std::min(130UL, size()); i++) {
@@ -306,62 +593,264 @@ private:
             out << "]";
         }
 
-        gc::ref<ArrayImpl> pushTail(Fiber &fbr, int level,
-            gc::ref<ArrayImpl> arr,
-            gc::ref<ArrayImpl> tailNode,
-            gc::ref<ArrayImpl> &expansion) const {
-            assert(arr);
-            assert(tailNode);
-            gc::ref<ArrayImpl> newchild;
-            if (level == 0) {
-                newchild = tailNode;
-            } else {
-                assert(arr->size() > 0);
-                assert((&arr->get(arr->size() - 1)->get_type()) == ArrayImpl::TYPE.get());
-                newchild = pushTail(
-                        fbr,
-                        level - 5,
-                        ArrayImpl::create(fbr, *gc::ref_dynamic_cast<ArrayImpl>(arr->get(arr->size() - 1))),
-                        tailNode, expansion
-                );
-                if (!expansion) {
-                    auto ret = ArrayImpl::create(fbr, *arr);
-                    ret.mutate()->set(arr->size() - 1, gc::ref_cast<Value>(newchild));
-                    return ret;
-                } else {
-                    newchild = expansion;
-                }
-            }
-            assert(newchild);
-            //expansion
-            if (arr->size() == 32) {
-                expansion = ArrayImpl::create(fbr, gc::ref_cast<Value>(newchild));
-                return arr;
-            } else {
-                expansion = nullptr;
-                return arr->append(fbr, gc::ref_cast<Value>(newchild));
-            }
-
-        }
-
         gc::ref<Vector> conj(Fiber &fbr, gc::ref<Value> val) const override {
             if (tail_->size() < 32) {
                 return gc::make_ref<VectorImpl>(
                     fbr.allocator(), cnt_ + 1, shift_, root_, tail_->append(fbr, val));
             } 
             else {
-                gc::ref<ArrayImpl> expansion;
-                auto newroot = pushTail(fbr, shift_ - 5, root_, tail_, expansion);
-                int newshift = shift_;
-                if (expansion) {
-                    newroot = ArrayImpl::create(fbr, gc::ref_cast<Value>(newroot), gc::ref_cast<Value>(expansion));
-                    newshift += 5;
-                }
+                auto [newroot, newshift] = push_tail(fbr, shift_, root_, tail_);
                 return gc::make_ref<VectorImpl>(
                     fbr.allocator(), cnt_ + 1, newshift, newroot, ArrayImpl::create(fbr, val));
             }
         }
 
+        /*
+         * The tree is a relaxed radix balanced tree (Bagwell/Rompf, L'orange). Nodes built by conj stay balanced and
+         * are indexed by radix alone, nodes made by concat and subvec may hold less than full children and then
+         * carry a size table.
+         */
+        static gc::ref<ArrayImpl> child(const ArrayImpl &node, size_t idx) {
+            return gc::ref_dynamic_cast<ArrayImpl>(node.get(idx));
+        }
+
+        //number of values below a node, leafs are at shift 0
+        static size_t count(const ArrayImpl &node, int shift) {
+            if (shift == 0 || node.size() == 0) {
+                return node.size();
+            }
+            if (auto sizes = node.sizes()) {
+                return sizes->get(node.size() - 1);
+            }
+            return ((node.size() - 1) << shift) + count(*child(node, node.size() - 1), shift - 5);
+        }
+
+        static void child_sizes(const ArrayImpl &node, int shift, size_t sizes[]) {
+            auto n = node.size();
+            if (auto node_sizes = node.sizes()) {
+                for (size_t i = 0; i < n; i++) {
+                    sizes[i] = node_sizes->get(i);
+                }
+                return;
+            }
+            for (size_t i = 0; i < n; i++) {
+                sizes[i] = (i + 1) << shift;
+            }
+            sizes[n - 1] = count(node, shift);
+        }
+
+        //a node is balanced when all its children are and all but the last are full
+        static gc::ref<ArrayImpl> make_node(Fiber &fbr, const gc::ref<Value> children[], size_t n, int shift) {
+            assert(n > 0 && n <= 32 && shift > 0);
+            auto node = ArrayImpl::create(fbr, children, n);
+            size_t sizes[32];
+            size_t total = 0;
+            bool balanced = true;
+            for (size_t i = 0; i < n; i++) {
+                auto &c = static_cast<const ArrayImpl &>(*children[i]);
+                auto c_count = count(c, shift - 5);
+                balanced = balanced && !c.sizes() && (i == n - 1 || c_count == (1UL << shift));
+                total += c_count;
+                sizes[i] = total;
+            }
+            if (!balanced) {
+                node.mutate()->set_sizes(SizeTable::create(fbr, sizes, n));
+            }
+            return node;
+        }
+
+        static gc::ref<ArrayImpl> new_path(Fiber &fbr, int shift, gc::ref<ArrayImpl> leaf) {
+            if (shift == 0) {
+                return leaf;
+            }
+            return ArrayImpl::create(fbr, new_path(fbr, shift - 5, leaf));
+        }
+
+        //appends leaf at the right edge below node, returns null when the subtree is out of room
+        static gc::ref<ArrayImpl> push_leaf(Fiber &fbr, const ArrayImpl &node, int shift, gc::ref<ArrayImpl> leaf) {
+            auto n = node.size();
+            size_t sizes[32];
+            if (shift > 5 && n > 0) {
+                if (auto pushed = push_leaf(fbr, *child(node, n - 1), shift - 5, leaf)) {
+                    auto ret = ArrayImpl::create(fbr, node);
+                    ret.mutate()->set(n - 1, pushed);
+                    if (node.sizes() || pushed->sizes()) {
+                        child_sizes(node, shift, sizes);
+                        sizes[n - 1] += leaf->size();
+                        ret.mutate()->set_sizes(SizeTable::create(fbr, sizes, n));
+                    }
+                    return ret;
+                }
+            }
+            if (n == 32) {
+                return nullptr;
+            }
+            auto ret = node.append(fbr, new_path(fbr, shift - 5, leaf));
+            if (node.sizes() || (n > 0 && count(*child(node, n - 1), shift - 5) != (1UL << shift))) {
+                //the child before the new one is not full, so radix indexing no longer holds
+                child_sizes(node, shift, sizes);
+                sizes[n] = sizes[n - 1] + leaf->size();
+                ret.mutate()->set_sizes(SizeTable::create(fbr, sizes, n + 1));
+            }
+            return ret;
+        }
+
+        static std::tuple<gc::ref<ArrayImpl>, int> push_tail(Fiber &fbr, int shift, gc::ref<ArrayImpl> root, gc::ref<ArrayImpl> tail) {
+            if (auto newroot = push_leaf(fbr, *root, shift, tail)) {
+                return {newroot, shift};
+            }
+            gc::ref<Value> children[] = {root, new_path(fbr, shift, tail)};
+            return {make_node(fbr, children, 2, shift + 5), shift + 5};
+        }
+
+        //joins the right edge of left with the left edge of right, the result is one level above the highest of both
+        static gc::ref<ArrayImpl> concat_sub_tree(Fiber &fbr, gc::ref<ArrayImpl> left, int lshift, gc::ref<ArrayImpl> right, int rshift) {
+            if (lshift > rshift) {
+                auto center = concat_sub_tree(fbr, child(*left, left->size() - 1), lshift - 5, right, rshift);
+                return rebalance(fbr, left, center, nullptr, lshift);
+            }
+            if (lshift < rshift) {
+                auto center = concat_sub_tree(fbr, left, lshift, child(*right, 0), rshift - 5);
+                return rebalance(fbr, nullptr, center, right, rshift);
+            }
+            if (lshift == 0) {
+                if (left->size() + right->size() <= 32) {
+                    gc::ref<Value> values[32];
+                    size_t n = 0;
+                    for (size_t i = 0; i < left->size(); i++) {
+                        values[n++] = left->get(i);
+                    }
+                    for (size_t i = 0; i < right->size(); i++) {
+                        values[n++] = right->get(i);
+                    }
+                    return ArrayImpl::create(fbr, ArrayImpl::create(fbr, values, n));
+                }
+                gc::ref<Value> leafs[] = {left, right};
+                return make_node(fbr, leafs, 2, 5);
+            }
+            auto center = concat_sub_tree(fbr, child(*left, left->size() - 1), lshift - 5, child(*right, 0), rshift - 5);
+            return rebalance(fbr, left, center, right, lshift);
+        }
+
+        /*
+         * Redistributes the children of left (without its last), center and right (without its first) so that
+         * there are at most 2 more nodes than optimal. Nodes that need no change are shared with the input.
+         */
+        static gc::ref<ArrayImpl> rebalance(Fiber &fbr, gc::ref<ArrayImpl> left, gc::ref<ArrayImpl> center, gc::ref<ArrayImpl> right, int shift) {
+            gc::ref<ArrayImpl> all[64];
+            size_t slots[64];
+            size_t n = 0;
+            if (left) {
+                for (size_t i = 0; i < left->size() - 1; i++) {
+                    all[n++] = child(*left, i);
+                }
+            }
+            for (size_t i = 0; i < center->size(); i++) {
+                all[n++] = child(*center, i);
+            }
+            if (right) {
+                for (size_t i = 1; i < right->size(); i++) {
+                    all[n++] = child(*right, i);
+                }
+            }
+
+            size_t total = 0;
+            for (size_t i = 0; i < n; i++) {
+                slots[i] = all[i]->size();
+                total += slots[i];
+            }
+
+            auto optimal = (total + 31) / 32;
+            auto m = n;
+            size_t i = 0;
+            while (optimal + 2 < m) {
+                //full nodes are left alone, the first one with room is spread over the ones after it
+                while (slots[i] > 31) {
+                    i++;
+                }
+                auto remaining = slots[i];
+                do {
+                    auto moved = std::min<size_t>(remaining + slots[i + 1], 32);
+                    slots[i] = moved;
+                    remaining = remaining + slots[i + 1] - moved;
+                    i++;
+                } while (remaining > 0);
+                for (auto j = i; j < m - 1; j++) {
+                    slots[j] = slots[j + 1];
+                }
+                m--;
+                i--;
+            }
+
+            gc::ref<Value> nodes[64];
+            size_t idx = 0;
+            size_t offset = 0;
+            for (size_t k = 0; k < m; k++) {
+                if (offset == 0 && all[idx]->size() == slots[k]) {
+                    nodes[k] = all[idx++];
+                    continue;
+                }
+                gc::ref<Value> values[32];
+                size_t filled = 0;
+                while (filled < slots[k]) {
+                    auto take = std::min(slots[k] - filled, all[idx]->size() - offset);
+                    for (size_t j = 0; j < take; j++) {
+                        values[filled++] = all[idx]->get(offset + j);
+                    }
+                    offset += take;
+                    if (offset == all[idx]->size()) {
+                        idx++;
+                        offset = 0;
+                    }
+                }
+                if (shift == 5) {
+                    nodes[k] = ArrayImpl::create(fbr, values, filled);
+                }
+                else {
+                    nodes[k] = make_node(fbr, values, filled, shift - 5);
+                }
+            }
+
+            if (m <= 32) {
+                gc::ref<Value> parent[] = {make_node(fbr, nodes, m, shift)};
+                return make_node(fbr, parent, 1, shift + 5);
+            }
+            gc::ref<Value> parent[] = {make_node(fbr, nodes, 32, shift), make_node(fbr, nodes + 32, m - 32, shift)};
+            return make_node(fbr, parent, 2, shift + 5);
+        }
+
+        //the values in [from, to) below node as a subtree of the same height
+        static gc::ref<ArrayImpl> slice_tree(Fiber &fbr, gc::ref<ArrayImpl> node, int shift, size_t from, size_t to) {
+            if (shift == 0) {
+                return node->slice(fbr, from, to);
+            }
+            size_t sizes[32];
+            child_sizes(*node, shift, sizes);
+            size_t first = 0;
+            while (sizes[first] <= from) {
+                first++;
+            }
+            auto last = first;
+            while (sizes[last] < to) {
+                last++;
+            }
+            gc::ref<Value> children[32];
+            for (auto i = first; i <= last; i++) {
+                auto begin = i > 0 ? sizes[i - 1] : 0;
+                auto lo = std::max(from, begin) - begin;
+                auto hi = std::min(to, sizes[i]) - begin;
+                if (lo == 0 && hi == sizes[i] - begin) {
+                    children[i - first] = child(*node, i);
+                }
+                else {
+                    children[i - first] = slice_tree(fbr, child(*node, i), shift - 5, lo, hi);
+                }
+            }
+            return make_node(fbr, children, last - first + 1, shift);
+        }
+
+        friend class TransientVectorImpl;
+
     public:
         VectorImpl(int cnt, int shift,
                    gc::ref<ArrayImpl> root,
@@ -395,10 +884,156 @@ private:
             runtime.register_method(FIRST, *TYPE, _first);
             runtime.register_method(NEXT, *TYPE, _next);
             runtime.register_method(ADD, *TYPE, *TYPE, _add);
+            runtime.register_method(TRANSIENT, *TYPE, _transient);
+            runtime.register_method(SUBVEC, *TYPE, _subvec);
+            runtime.register_method(SPLIT_AT, *TYPE, _split_at);
+            runtime.register_method(PARTITION, *TYPE, _partition);
+            runtime.register_method(CHUNKS, *TYPE, _chunks);
+            runtime.register_method(CHUNK_FIRST, *TYPE, _chunk_first);
+            runtime.register_method(CHUNK_NEXT, *TYPE, _chunk_next);
 
         }
     };
 
+    class TransientVectorImpl : public ValueImpl<TransientVector, TransientVectorImpl> {
+
+        bool editable_;
+        bool tail_owned_;
+        uint64_t barrier_epoch_;
+        int cnt_;
+        int shift_;
+
+        gc::ref<ArrayImpl> root_;
+        gc::ref<ArrayImpl> tail_;
+
+    public:
+        TransientVectorImpl(int cnt, int shift,
+                            gc::ref<ArrayImpl> root,
+                            gc::ref<ArrayImpl> tail)
+                : editable_(true), tail_owned_(false), barrier_epoch_(0), cnt_(cnt), shift_(shift), root_(root), tail_(tail) {}
+
+        static gc::ref<TransientVectorImpl> create(Fiber &fbr, gc::ref<VectorImpl> vector) {
+            return gc::make_ref<TransientVectorImpl>(fbr.allocator(), vector->cnt_, vector->shift_, vector->root_, vector->tail_);
+        }
+
+        void ensure_editable(Fiber &fbr) const {
+            if (!editable_ || gc::is_shared_ref(this)) {
+                throw Error::transient_not_editable(fbr, *this);
+            }
+        }
+
+        void conj(Fiber &fbr, gc::ref<Value> val) override {
+            ensure_editable(fbr);
+            //the collector may be walking our tail, push onto a copy instead
+            auto in_place = !gc::private_write(fbr.allocator(), this, barrier_epoch_);
+            auto tail = tail_;
+            if (tail->size() == 32) {
+                std::tie(root_, shift_) = VectorImpl::push_tail(fbr, shift_, root_, tail);
+                tail = ArrayImpl::create_tail(fbr, *ArrayImpl::EMPTY);
+            }
+            else if (!tail_owned_ || !in_place) {
+                //the tail we started with belongs to the persistent vector
+                tail = ArrayImpl::create_tail(fbr, *tail);
+            }
+            tail.mutate()->push(val);
+            tail_ = tail;
+            tail_owned_ = true;
+            cnt_ += 1;
+        }
+
+        gc::ref<Vector> persistent(Fiber &fbr) override {
+            ensure_editable(fbr);
+            editable_ = false;
+            if (cnt_ == 0) {
+                return VectorImpl::create();
+            }
+            //trim the tail back to its size
+            auto tail = tail_owned_ ? ArrayImpl::create(fbr, *tail_) : tail_;
+            return gc::make_ref<VectorImpl>(fbr.allocator(), cnt_, shift_, root_, tail);
+        }
+
+        void walk(const std::function<void(const gc::ref<gc::collectable> &ref)> &accept) override {  
+            accept(root_);
+            accept(tail_);
+        }
+
+        void repr(Fiber &fbr, std::ostream &out) const override {
+            out << "(transient vector)";
+        }
+
+        static int64_t _conj(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientVectorImpl> self;
+            gc::ref<Value> val;
+
+            return frame.check().
+               single_dispatch(*CONJ, *TYPE).
+               argument_count(2).
+               argument<TransientVectorImpl>(1, self).
+               argument<Value>(2, val).
+               result<Value>([&]() {
+                   self.mutate()->conj(fbr, val);
+                   return self;
+               });
+        }
+
+        static int64_t _get(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientVectorImpl> self;
+            int64_t idx;
+
+            return frame.check().
+                single_dispatch(*GET, *TYPE).
+                argument_count(2).
+                argument<TransientVectorImpl>(1, self).
+                argument<int64_t>(2, idx).
+                result<Value>([&]() {
+                    self->ensure_editable(fbr);
+                    return VectorImpl::nth(self->cnt_, self->shift_, self->root_, self->tail_, idx);
+                });
+        }
+
+        static int64_t _length(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientVectorImpl> self;
+
+            return frame.check().
+               single_dispatch(*LENGTH, *TYPE).
+               argument_count(1).
+               argument<TransientVectorImpl>(1, self).
+               result<int64_t>([&]() {
+                   self->ensure_editable(fbr);
+                   return self->cnt_;
+               });
+        }
+
+        static int64_t _persistent(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<TransientVectorImpl> self;
+
+            return frame.check().
+               single_dispatch(*PERSISTENT, *TYPE).
+               argument_count(1).
+               argument<TransientVectorImpl>(1, self).
+               result<Value>([&]() {
+                   return self.mutate()->persistent(fbr);
+               });
+        }
+
+        static void init(Runtime &runtime) {
+            TYPE = runtime.create_type("TransientVector");
+
+            runtime.register_method(CONJ, *TYPE, _conj);
+            runtime.register_method(GET, *TYPE, _get);
+            runtime.register_method(LENGTH, *TYPE, _length);
+            runtime.register_method(PERSISTENT, *TYPE, _persistent);
+        }
+    };
+
     class VectorIterator : public Value {
     };
 
@@ -429,6 +1064,9 @@ private:
 
             runtime.register_method(FIRST, *TYPE, _first);
             runtime.register_method(NEXT, *TYPE, _next);
+            runtime.register_method(CHUNKS, *TYPE, _chunks);
+            runtime.register_method(CHUNK_FIRST, *TYPE, _chunk_first);
+            runtime.register_method(CHUNK_NEXT, *TYPE, _chunk_next);
 
             /*
             BuiltinSingleDispatch::LENGTH->register_method(*type, _length);
@@ -443,6 +1081,10 @@ private:
             return v_->nth(start_ + i);
         }
 
+        gc::ref<VectorImpl> rest(Fiber &fbr) const {
+            return VectorImpl::subvec(fbr, v_, start_, v_->size());
+        }
+
         static int64_t _first(Fiber &fbr, const AST::Apply &apply) {
             Frame frame(fbr, apply);
 
@@ -471,6 +1113,50 @@ private:
                 });
         }
 
+
+        static int64_t _chunks(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorIteratorImpl> self;
+
+            return frame.check().
+                single_dispatch(*CHUNKS, *TYPE).
+                argument_count(1).
+                argument<VectorIteratorImpl>(1, self).
+                result<Value>([&]() {
+                    return self;
+                });
+        }
+
+        static int64_t _chunk_first(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorIteratorImpl> self;
+
+            return frame.check().
+                single_dispatch(*CHUNK_FIRST, *TYPE).
+                argument_count(1).
+                argument<VectorIteratorImpl>(1, self).
+                result<Value>([&]() {
+                    return VectorImpl::chunk(fbr, self->v_, self->start_);
+                });
+        }
+
+        static int64_t _chunk_next(Fiber &fbr, const AST::Apply &apply) {
+            Frame frame(fbr, apply);
+
+            gc::ref<VectorIteratorImpl> self;
+
+            return frame.check().
+                single_dispatch(*CHUNK_NEXT, *TYPE).
+                argument_count(1).
+                argument<VectorIteratorImpl>(1, self).
+                result<Value>([&]() {
+                    auto start = self->start_ + VectorImpl::chunk_size(self->v_, self->start_);
+                    return gc::make_ref<VectorIteratorImpl>(fbr.allocator(), self->v_, start);
+                });
+        }
+
     };
 
     gc::ref<VectorImpl> VectorImpl::EMPTY;
@@ -484,10 +1170,19 @@ private:
         FIRST = runtime.builtin("first");
         NEXT = runtime.builtin("next");
         ADD = runtime.builtin("add");
+        TRANSIENT = runtime.builtin("transient");
+        PERSISTENT = runtime.builtin("persistent");
+        SUBVEC = runtime.builtin("subvec");
+        SPLIT_AT = runtime.builtin("split_at");
+        PARTITION = runtime.builtin("partition");
+        CHUNKS = runtime.builtin("chunks");
+        CHUNK_FIRST = runtime.builtin("chunk_first");
+        CHUNK_NEXT = runtime.builtin("chunk_next");
 
         ArrayImpl::init(runtime);
         VectorImpl::init(runtime);
         VectorIteratorImpl::init(runtime);
+        TransientVectorImpl::init(runtime);
 
         runtime.register_method(ADD, *VectorImpl::TYPE, *VectorIteratorImpl::TYPE, VectorImpl::_add_vector_iterator);
 
@@ -497,6 +1192,14 @@ private:
         return VectorImpl::create();
     }
 
+    const Type &Vector::type() {
+        return *VectorImpl::TYPE;
+    }
+
+    gc::ref<TransientVector> TransientVector::create(Fiber &fbr, gc::ref<Vector> vector) {
+        return TransientVectorImpl::create(fbr, gc::ref_dynamic_cast<VectorImpl>(vector));
+    }
+
     int64_t VectorImpl::_next(Fiber &fbr, const AST::Apply &apply) {
         Frame frame(fbr, apply);
 
@@ -511,28 +1214,48 @@ private:
             });
     }
 
+    int64_t VectorImpl::_chunk_next(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
+
+        gc::ref<VectorImpl> self;
+
+        return frame.check().
+            single_dispatch(*CHUNK_NEXT, *TYPE).
+            argument_count(1).
+            argument<VectorImpl>(1, self).
+            result<Value>([&]() {
+                return gc::make_ref<VectorIteratorImpl>(fbr.allocator(), self, chunk_size(self, 0));
+            });
+    }
+
     int64_t VectorImpl::_add_vector_iterator(Fiber &fbr, const AST::Apply &apply) {
         Frame frame(fbr, apply);
 
         gc::ref<VectorImpl> self;
         gc::ref<VectorIteratorImpl> other;
 
-        //TODO this impl is silly and slow
         return frame.check().
             binary_dispatch(*ADD, *TYPE, *VectorIteratorImpl::TYPE).
             argument_count(2).
             argument<VectorImpl>(1, self). 
             argument<VectorIteratorImpl>(2, other). 
             result<Value>([&]() {
-                auto new_vector = self;
-                for (size_t i = 0; i < other->size(); i++) {
-                    new_vector = gc::ref_dynamic_cast<VectorImpl>(new_vector->conj(fbr, other->nth(i)));
-                }
-                return new_vector;
+                return concat(fbr, self, other->rest(fbr));
             });
     }
 
-}
+    int64_t VectorImpl::_transient(Fiber &fbr, const AST::Apply &apply) {
+        Frame frame(fbr, apply);
 
+        gc::ref<VectorImpl> self;
 
+        return frame.check().
+            single_dispatch(*TRANSIENT, *TYPE).
+            argument_count(1).
+            argument<VectorImpl>(1, self).
+            result<Value>([&]() {
+                return TransientVectorImpl::create(fbr, self);
+            });
+    }
 
+}
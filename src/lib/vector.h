@@ -35,8 +35,21 @@ namespace park {
 
        static gc::ref<Vector> create(Fiber &fbr);
 
+       static const Type &type();
+
        static void init(Runtime &runtime);
     };
 
+    //owner-only builder, conj appends to a private tail in place until persistent freezes it
+    class TransientVector : public Value {
+    public:
+
+       static gc::ref<TransientVector> create(Fiber &fbr, gc::ref<Vector> vector);
+
+       virtual void conj(Fiber &fbr, gc::ref<Value> val) = 0;
+
+       virtual gc::ref<Vector> persistent(Fiber &fbr) = 0;
+    };
+
 }
 #endif
@@ -23,10 +23,13 @@
 #include "value.h"
 #include "string.h"
 #include "integer.h"
+#include "float.h"
 #include "vector.h"
 #include "map.h"
+#include "set.h"
 #include "boolean.h"
 #include "atom.h"
+#include "cmap.h"
 
 namespace park {
 
@@ -34,16 +37,22 @@ namespace park {
     public:
         virtual const Value &visit(Fiber &fbr, const Map &v) = 0;
 
+        virtual const Value &visit(Fiber &fbr, const Set &v) = 0;
+
         virtual const Value &visit(Fiber &fbr, const Vector &v) = 0;
 
         virtual const Value &visit(Fiber &fbr, const Integer &v) = 0;
 
+        virtual const Value &visit(Fiber &fbr, const Float &v) = 0;
+
         virtual const Value &visit(Fiber &fbr, const String &v) = 0;
 
         virtual const Value &visit(Fiber &fbr, const Boolean &v) = 0;
 
         virtual const Value &visit(Fiber &fbr, const Atom &v) = 0;
 
+        virtual const Value &visit(Fiber &fbr, const CMap &v) = 0;
+
     };
 
 }